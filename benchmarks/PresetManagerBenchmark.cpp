@@ -0,0 +1,535 @@
+// Times the PresetManager operations that scale with the library size against synthetic
+// catalogs. Build with -DEXP_PRESETS_BUILD_BENCHMARKS=ON (no BakkesMod SDK needed) and run
+//
+//   ExpandedPresetsBenchmark [preset counts...]
+//
+// Defaults to 1000, 10000 and 100000 presets. Every number is the median of several runs. The
+// last rows repeat loading and saving in the sharded layout (see PresetShards).
+#include "PresetManager.h"
+#include "PresetQuery.h"
+#include "PresetWorkerPool.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr int runsPerMeasurement = 5;
+
+constexpr std::array<std::uint16_t, 6> bodyIds{23, 403, 1568, 4284, 22, 1416};
+constexpr std::array<std::string_view, 6> carNames{"Octane", "Dominus", "Octane ZSR", "Fennec", "Breakout", "Breakout Type-S"};
+constexpr std::array<std::string_view, 4> wheelNames{"OEM", "Zomba", "Draco", "Cristiano"};
+
+// Writes LSB-first bit fields, the inverse of the reader in LoadoutCode.cpp.
+class BitWriter
+{
+public:
+    void Write(std::uint32_t value, unsigned bits)
+    {
+        for (unsigned i = 0; i < bits; ++i, ++position)
+        {
+            if (position % 8 == 0)
+            {
+                bytes.push_back(0);
+            }
+            if ((value >> i) & 1u)
+            {
+                bytes.back() = static_cast<std::uint8_t>(bytes.back() | (1u << (position % 8)));
+            }
+        }
+    }
+
+    [[nodiscard]] const std::vector<std::uint8_t> &Bytes() const noexcept
+    {
+        return bytes;
+    }
+
+private:
+    std::vector<std::uint8_t> bytes;
+    std::size_t position{0};
+};
+
+std::string EncodeBase64(const std::vector<std::uint8_t> &bytes)
+{
+    constexpr std::string_view alphabet{"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+    std::string text;
+    for (std::size_t i = 0; i < bytes.size(); i += 3)
+    {
+        std::uint32_t group = static_cast<std::uint32_t>(bytes[i]) << 16;
+        if (i + 1 < bytes.size())
+        {
+            group |= static_cast<std::uint32_t>(bytes[i + 1]) << 8;
+        }
+        if (i + 2 < bytes.size())
+        {
+            group |= bytes[i + 2];
+        }
+        text += alphabet[(group >> 18) & 63u];
+        text += alphabet[(group >> 12) & 63u];
+        text += i + 1 < bytes.size() ? alphabet[(group >> 6) & 63u] : '=';
+        text += i + 2 < bytes.size() ? alphabet[group & 63u] : '=';
+    }
+    return text;
+}
+
+// A version 3 code with a body, decal and wheels on one team and random paint overrides.
+std::string MakeLoadoutCode(std::mt19937 &random, std::uint16_t bodyId)
+{
+    BitWriter writer;
+    writer.Write(3, 6);
+    writer.Write(0, 10);
+    writer.Write(0, 8);
+    writer.Write(1, 1);
+    writer.Write(3, 4);
+    const std::array<std::pair<std::uint32_t, std::uint32_t>, 3> items{{
+        {0, bodyId},
+        {1, 1000 + random() % 4000},
+        {2, 1000 + random() % 4000},
+    }};
+    for (const auto &[slot, product] : items)
+    {
+        writer.Write(slot, 5);
+        writer.Write(product, 13);
+        const bool painted = random() % 2 == 0;
+        writer.Write(painted, 1);
+        if (painted)
+        {
+            writer.Write(1 + random() % 18, 6);
+        }
+    }
+    writer.Write(1, 1);
+    for (int i = 0; i < 6; ++i)
+    {
+        writer.Write(random() % 256, 8);
+    }
+    return EncodeBase64(writer.Bytes());
+}
+
+// `count` presets in the expanded_presets.cfg format. Names start with `prefix`.
+std::string MakeCatalog(std::size_t count, std::string_view prefix, std::uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::string text;
+    text.reserve(count * 96);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const auto body = random() % bodyIds.size();
+        text += prefix;
+        text += std::to_string(i);
+        text += '|';
+        text += MakeLoadoutCode(random, bodyIds[body]);
+        text += '|' + std::to_string(random() % 256) + ',' + std::to_string(random() % 256) + ',' + std::to_string(random() % 256);
+        text += '|' + std::to_string(random() % 256) + ',' + std::to_string(random() % 256) + ',' + std::to_string(random() % 256);
+        text += '|';
+        text += carNames[body];
+        text += "|Decal " + std::to_string(random() % 50) + '|';
+        text += wheelNames[random() % wheelNames.size()];
+        text += random() % 4 == 0 ? "|1" : "|0";
+        text += random() % 4 == 0 ? "|1\n" : "|0\n";
+    }
+    return text;
+}
+
+// The same shape as presets.data: "Name LoadoutCode" per line.
+std::string MakeVanillaPresets(std::size_t count, std::uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::string text;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        text += "Vanilla_" + std::to_string(i) + ' ' + MakeLoadoutCode(random, bodyIds[random() % bodyIds.size()]) + '\n';
+    }
+    return text;
+}
+
+void WriteFile(const std::filesystem::path &path, const std::string &contents)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+}
+
+// Stands in for the game thread: tasks posted by the manager run when the benchmark pumps them.
+class TaskQueue
+{
+public:
+    void Post(PresetManagerHost::Task task)
+    {
+        std::lock_guard lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+
+    void RunPending()
+    {
+        std::vector<PresetManagerHost::Task> ready;
+        {
+            std::lock_guard lock(mutex);
+            ready.swap(tasks);
+        }
+        for (auto &task : ready)
+        {
+            task();
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<PresetManagerHost::Task> tasks;
+};
+
+// Median wall time of `runsPerMeasurement` calls to `run`, with `prepare` before each outside the
+// timed region.
+double MedianMilliseconds(const std::function<void()> &prepare, const std::function<void()> &run)
+{
+    std::vector<double> samples;
+    for (int i = 0; i < runsPerMeasurement; ++i)
+    {
+        prepare();
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+void Report(std::size_t size, std::string_view operation, double milliseconds, std::size_t items)
+{
+    std::printf("%8zu  %-26.*s %10.3f ms %12.1f ns/item\n", size, static_cast<int>(operation.size()), operation.data(),
+                milliseconds, milliseconds * 1e6 / static_cast<double>(std::max<std::size_t>(items, 1)));
+}
+
+void RunBenchmarks(std::size_t size, const std::filesystem::path &root)
+{
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "ExpandedPresets");
+
+    TaskQueue queue;
+    PresetWorkerPool workers;
+    workers.Start();
+    PresetManagerHost host;
+    host.dataFolder = root / "ExpandedPresets";
+    host.vanillaPresetsPath = root / "presets.data";
+    host.log = [](const std::string &) {};
+    host.post = [&queue](PresetManagerHost::Task task)
+    {
+        queue.Post(std::move(task));
+    };
+    host.workers = &workers;
+
+    const auto storagePath = host.dataFolder / "expanded_presets.cfg";
+    const auto cachePath = host.dataFolder / "expanded_presets.bin";
+    const auto journalPath = host.dataFolder / "expanded_presets.journal";
+    const auto storageText = MakeCatalog(size, "Preset ", 1);
+    WriteFile(storagePath, storageText);
+    WriteFile(host.dataFolder / "bakkesplugins_cars.cfg", MakeCatalog(size, "Catalog ", 2));
+    WriteFile(host.vanillaPresetsPath, MakeVanillaPresets(size, 3));
+
+    PresetManager manager(host);
+    // Keep the background writer out of the timings; writes happen only through FlushStorage.
+    manager.SetSaveDebounceWindow(std::chrono::hours(1));
+
+    const auto noPreparation = [] {};
+    // Imports save what they merged; put the original library back before the next run.
+    const auto reload = [&manager, &storagePath, &cachePath, &journalPath, &storageText]
+    {
+        manager.FlushStorage();
+        WriteFile(storagePath, storageText);
+        std::filesystem::remove(cachePath);
+        std::filesystem::remove(journalPath);
+        manager.LoadFromStorage();
+        manager.FlushStorage();
+    };
+
+    Report(size, "LoadFromStorage (text)", MedianMilliseconds([&cachePath]
+                                                              {
+                                                                  std::filesystem::remove(cachePath);
+                                                              },
+                                                              [&manager]
+                                                              {
+                                                                  manager.LoadFromStorage();
+                                                              }),
+           size);
+    manager.FlushStorage();
+    Report(size, "LoadFromStorage (cache)", MedianMilliseconds(noPreparation, [&manager]
+                                                               {
+                                                                   manager.LoadFromStorage();
+                                                               }),
+           size);
+
+    manager.SetLazyLoading(true);
+    Report(size, "LoadFromStorage (lazy)", MedianMilliseconds(noPreparation, [&manager]
+                                                              {
+                                                                  manager.LoadFromStorage();
+                                                              }),
+           size);
+    Report(size, "GetPreset (first use)", MedianMilliseconds([&manager]
+                                                            {
+                                                                manager.LoadFromStorage();
+                                                            },
+                                                            [&manager]
+                                                            {
+                                                                if (manager.GetPreset(manager.GetPresetCount() / 2).loadoutCode.empty())
+                                                                {
+                                                                    std::fprintf(stderr, "Lazy load left a preset without its loadout code\n");
+                                                                    std::exit(1);
+                                                                }
+                                                            }),
+           1);
+    manager.SetLazyLoading(false);
+    manager.LoadFromStorage();
+
+    Report(size, "SaveToStorage + flush", MedianMilliseconds(noPreparation, [&manager]
+                                                             {
+                                                                 manager.SaveToStorage();
+                                                                 manager.FlushStorage();
+                                                             }),
+           size);
+
+    Report(size, "GetSnapshot (one edit)", MedianMilliseconds([&manager, size]
+                                                              {
+                                                                  auto edited = manager.GetPreset(size / 2);
+                                                                  edited.customization.paintFinishMatte = !edited.customization.paintFinishMatte;
+                                                                  manager.AddOrUpdatePreset(edited);
+                                                              },
+                                                              [&manager, size]
+                                                              {
+                                                                  if (manager.GetSnapshot()->Size() != size)
+                                                                  {
+                                                                      std::fprintf(stderr, "Snapshot lost presets\n");
+                                                                      std::exit(1);
+                                                                  }
+                                                              }),
+           1);
+
+    CustomPreset removed;
+    Report(size, "RemovePreset (middle)", MedianMilliseconds([&manager, &removed, size]
+                                                             {
+                                                                 if (!removed.name.empty())
+                                                                 {
+                                                                     manager.AddOrUpdatePreset(removed);
+                                                                 }
+                                                                 removed = manager.GetPreset(size / 2);
+                                                             },
+                                                             [&manager, &removed]
+                                                             {
+                                                                 manager.RemovePreset(std::string(removed.name));
+                                                             }),
+           1);
+    manager.AddOrUpdatePreset(removed);
+
+    std::vector<std::string> names;
+    for (const auto &preset : manager.GetPresets())
+    {
+        names.emplace_back(preset.name);
+    }
+    std::shuffle(names.begin(), names.end(), std::mt19937(4));
+    std::size_t found = 0;
+    Report(size, "FindPresetIndex", MedianMilliseconds(noPreparation, [&manager, &names, &found]
+                                                       {
+                                                           for (const auto &name : names)
+                                                           {
+                                                               found += manager.FindPresetIndex(name) < names.size();
+                                                           }
+                                                       }),
+           names.size());
+
+    const std::array<std::string_view, 4> filters{"preset 1", "octane", "99", "no such preset"};
+    Report(size, "FilterPresets", MedianMilliseconds(noPreparation, [&manager, &filters, &found]
+                                                     {
+                                                         for (const auto filter : filters)
+                                                         {
+                                                             found += manager.FilterPresets(filter).size();
+                                                         }
+                                                     }),
+           size * filters.size());
+
+    const auto query = PresetQuery::Parse("car:octane wheels:zomba matte:0 primary~#f06c20/0.4");
+    Report(size, "QueryPresets", MedianMilliseconds(noPreparation, [&manager, &query, &found]
+                                                    {
+                                                        found += manager.QueryPresets(query).size();
+                                                    }),
+           size);
+
+    // A recolour from the editor while a filter is typed: the indices must absorb the edit in place.
+    auto edited = manager.ToEditable(manager.GetPreset(size / 2));
+    Report(size, "Edit + FilterPresets", MedianMilliseconds(noPreparation, [&manager, &edited, &found]
+                                                            {
+                                                                edited.customization.primaryColor.r = 1.0f - edited.customization.primaryColor.r;
+                                                                manager.AddOrUpdatePreset(edited);
+                                                                found += manager.FilterPresets("preset 1").size();
+                                                            }),
+           1);
+
+    // Likewise for a removal, which also moves the last preset into the freed slot.
+    removed = CustomPreset{};
+    Report(size, "Remove + FilterPresets", MedianMilliseconds([&manager, &removed, size]
+                                                              {
+                                                                  if (!removed.name.empty())
+                                                                  {
+                                                                      manager.AddOrUpdatePreset(removed);
+                                                                  }
+                                                                  removed = manager.GetPreset(size / 3);
+                                                              },
+                                                              [&manager, &removed, &found]
+                                                              {
+                                                                  manager.RemovePreset(std::string(removed.name));
+                                                                  found += manager.FilterPresets("preset 1").size();
+                                                              }),
+           1);
+    manager.AddOrUpdatePreset(removed);
+
+    // One lookup per preset the editor could have open, the way the similar-colours panel asks.
+    constexpr std::size_t colorQueries = 200;
+    Report(size, "FindSimilarColors (k=8)", MedianMilliseconds(noPreparation, [&manager, &found, size]
+                                                               {
+                                                                   for (std::size_t i = 0; i < colorQueries; ++i)
+                                                                   {
+                                                                       const auto index = i * size / colorQueries;
+                                                                       const auto &customization = manager.GetPresets()[index].customization;
+                                                                       found += manager.FindSimilarColors(customization.primaryColor, customization.accentColor, 8,
+                                                                                                          manager.GetPresetId(index))
+                                                                                    .size();
+                                                                   }
+                                                               }),
+           colorQueries);
+
+    Report(size, "MergeVanillaPresets", MedianMilliseconds(reload, [&manager]
+                                                           {
+                                                               manager.MergeVanillaPresets();
+                                                           }),
+           size);
+
+    Report(size, "StartCatalogImport (total)", MedianMilliseconds(reload, [&manager, &queue]
+                                                                  {
+                                                                      bool merged = false;
+                                                                      if (!manager.StartCatalogImport([&merged](const PresetManager::CatalogImportSummary &)
+                                                                                                      {
+                                                                                                          merged = true;
+                                                                                                      }))
+                                                                      {
+                                                                          std::fprintf(stderr, "Catalog import failed to start\n");
+                                                                          std::exit(1);
+                                                                      }
+                                                                      while (!merged)
+                                                                      {
+                                                                          queue.RunPending();
+                                                                          std::this_thread::yield();
+                                                                      }
+                                                                  }),
+           size);
+
+    reload();
+    const auto packPath = root / "library.pack";
+    Report(size, "StartPackExport (total)", MedianMilliseconds(noPreparation, [&manager, &queue, &packPath]
+                                                               {
+                                                                   bool written = false;
+                                                                   if (!manager.StartPackExport(packPath, [&written](const std::optional<PresetPack::WriteSummary> &summary)
+                                                                                                {
+                                                                                                    written = summary.has_value();
+                                                                                                }))
+                                                                   {
+                                                                       std::fprintf(stderr, "Pack export failed to start\n");
+                                                                       std::exit(1);
+                                                                   }
+                                                                   while (!written)
+                                                                   {
+                                                                       queue.RunPending();
+                                                                       std::this_thread::yield();
+                                                                   }
+                                                               }),
+           size);
+
+    // Into an empty library, the way a player installs a pack they were sent.
+    auto packHost = host;
+    packHost.dataFolder = root / "PackImport";
+    std::optional<PresetManager> packTarget;
+    Report(size, "ImportPack", MedianMilliseconds([&packTarget, &packHost]
+                                                  {
+                                                      std::filesystem::remove_all(packHost.dataFolder);
+                                                      packTarget.emplace(packHost);
+                                                  },
+                                                  [&packTarget, &packPath, size]
+                                                  {
+                                                      const auto summary = packTarget->ImportPack(packPath);
+                                                      if (!summary || !summary->complete || summary->added != size)
+                                                      {
+                                                          std::fprintf(stderr, "Pack import lost presets\n");
+                                                          std::exit(1);
+                                                      }
+                                                  }),
+           size);
+    packTarget.reset();
+
+    manager.SetShardedStorage(true);
+    manager.FlushStorage();
+    Report(size, "LoadFromStorage (shards)", MedianMilliseconds(noPreparation, [&manager]
+                                                                {
+                                                                    manager.LoadFromStorage();
+                                                                }),
+           size);
+    if (manager.GetPresets().size() != size)
+    {
+        std::fprintf(stderr, "Sharded load returned %zu presets instead of %zu\n", manager.GetPresets().size(), size);
+        std::exit(1);
+    }
+    Report(size, "SaveToStorage (one edit)", MedianMilliseconds([&manager]
+                                                                {
+                                                                    auto edited = manager.GetPreset(0);
+                                                                    edited.customization.paintFinishMatte = !edited.customization.paintFinishMatte;
+                                                                    manager.AddOrUpdatePreset(edited);
+                                                                },
+                                                                [&manager]
+                                                                {
+                                                                    manager.SaveToStorage();
+                                                                    manager.FlushStorage();
+                                                                }),
+           1);
+
+    // Keeps the lookups and filters from being optimised away.
+    if (found == 0)
+    {
+        std::printf("(no matches)\n");
+    }
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+    {
+        const auto size = std::strtoull(argv[i], nullptr, 10);
+        if (size == 0)
+        {
+            std::fprintf(stderr, "usage: %s [preset counts...]\n", argv[0]);
+            return 2;
+        }
+        sizes.push_back(static_cast<std::size_t>(size));
+    }
+    if (sizes.empty())
+    {
+        sizes = {1000, 10000, 100000};
+    }
+
+    const auto root = std::filesystem::temp_directory_path() / "ExpandedPresetsBenchmark";
+    std::printf("%8s  %-26s %13s %20s\n", "presets", "operation", "median", "per item");
+    for (const auto size : sizes)
+    {
+        RunBenchmarks(size, root);
+    }
+    std::filesystem::remove_all(root);
+    return 0;
+}
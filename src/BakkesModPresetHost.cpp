@@ -0,0 +1,60 @@
+#include "BakkesModPresetHost.h"
+
+#include "bakkesmod/wrappers/GameWrapper.h"
+
+namespace
+{
+std::filesystem::path ResolveBakkesModDataFolder(const std::shared_ptr<GameWrapper> &gameWrapper)
+{
+    std::filesystem::path dataFolder{"./bakkesmod/data"};
+
+    if (gameWrapper)
+    {
+        try
+        {
+            const auto folder = gameWrapper->GetDataFolder();
+            if (!folder.empty())
+            {
+                dataFolder = folder;
+            }
+        }
+        catch (...)
+        {
+            // If the BakkesMod SDK we are linked against does not provide GetDataFolder
+            // just keep the fallback path instead of crashing.
+        }
+    }
+
+    return dataFolder;
+}
+} // namespace
+
+PresetManagerHost MakeBakkesModPresetHost(std::shared_ptr<GameWrapper> gameWrapper,
+                                          std::shared_ptr<CVarManagerWrapper> cvarManager,
+                                          PresetWorkerPool &workers)
+{
+    const auto bakkesModData = ResolveBakkesModDataFolder(gameWrapper);
+
+    PresetManagerHost host;
+    host.dataFolder = bakkesModData / "ExpandedPresets";
+    host.vanillaPresetsPath = bakkesModData / "presets.data";
+    host.workers = &workers;
+    host.log = [cvarManager](const std::string &message)
+    {
+        if (cvarManager)
+        {
+            cvarManager->log(message);
+        }
+    };
+    if (gameWrapper)
+    {
+        host.post = [gameWrapper](PresetManagerHost::Task task)
+        {
+            gameWrapper->Execute([task = std::move(task)](GameWrapper *)
+                                 {
+                                     task();
+                                 });
+        };
+    }
+    return host;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "PresetManagerHost.h"
+
+#include "bakkesmod/plugin/bakkesmodplugin.h"
+
+#include <memory>
+
+// Host for PresetManager backed by the BakkesMod wrappers: paths under the BakkesMod data folder,
+// the console for logging, GameWrapper::Execute for posting to the game thread and the plugin's
+// worker pool for background work.
+[[nodiscard]] PresetManagerHost MakeBakkesModPresetHost(std::shared_ptr<GameWrapper> gameWrapper,
+                                                        std::shared_ptr<CVarManagerWrapper> cvarManager,
+                                                        PresetWorkerPool &workers);
@@ -1,5 +1,8 @@
 #include "ExpandedPresetsPlugin.h"
 
+#include "BakkesModPresetHost.h"
+#include "PresetProfiler.h"
+
 #include "imgui/imgui.h"
 
 #include "bakkesmod/wrappers/GameWrapper.h"
@@ -7,38 +10,63 @@
 #include "bakkesmod/wrappers/canvaswrapper.h"
 
 #include <algorithm>
-#include <cctype>
+#include <chrono>
+#include <cstdio>
 #include <functional>
+#include <iomanip>
 #include <sstream>
 
-using namespace std::string_literals;
-
 BAKKESMOD_PLUGIN(ExpandedPresetsPlugin, "Expanded preset management with live previews", "1.0.0", PLUGINTYPE_FREEPLAY)
 
 namespace
 {
-std::string ToLower(std::string value)
-{
-    std::transform(value.begin(), value.end(), value.begin(),
-                   [](unsigned char c)
-                   {
-                       return static_cast<char>(std::tolower(c));
-                   });
-    return value;
-}
+constexpr std::string_view overlayPrefix{"Previewing preset: "};
+constexpr float overlayX = 35.0f;
+constexpr float overlayY = 35.0f;
+constexpr float overlayScale = 2.0f;
+constexpr std::string_view defaultPackFileName{"expanded_presets.pack"};
+constexpr std::size_t similarPresetCount = 8;
 
 ImU32 ToImColor(const PresetPaintColor &color)
 {
     return ImGui::ColorConvertFloat4ToU32(ImVec4(color.r, color.g, color.b, 1.0f));
 }
+
+ImU32 ToImColor(std::uint32_t packedRgb)
+{
+    return static_cast<ImU32>(packedRgb) | 0xFF000000u;
+}
+
+double ToMilliseconds(std::chrono::nanoseconds duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+std::string FormatStringArenaStats(const PresetStringArena::Stats &stats)
+{
+    char line[160];
+    std::snprintf(line, sizeof(line), "Preset strings: %zu in %zu blocks, %.1f of %.1f KiB used, ~%.1f KiB saved",
+                  stats.allocations, stats.blocks, static_cast<double>(stats.bytesUsed) / 1024.0,
+                  static_cast<double>(stats.bytesReserved) / 1024.0,
+                  static_cast<double>(stats.EstimatedBytesSaved()) / 1024.0);
+    return line;
+}
 }
 
 ExpandedPresetsPlugin::ExpandedPresetsPlugin() = default;
 
 void ExpandedPresetsPlugin::onLoad()
 {
-    presetManager = std::make_unique<PresetManager>(gameWrapper, cvarManager);
+    workerPool.Start();
+    presetManager = std::make_unique<PresetManager>(MakeBakkesModPresetHost(gameWrapper, cvarManager, workerPool));
+    // Registered before the other cvars because it has to be read before the first load.
+    auto lazyLoadCvar = cvarManager->registerCvar("expandedpresets_lazy_load", "0",
+                                                  "Only index expanded_presets.cfg at startup and read each preset in full when it is first used; applies from the next load",
+                                                  true, true, 0.0f, true, 1.0f);
+    presetManager->SetLazyLoading(lazyLoadCvar.getBoolValue());
     presetManager->LoadFromStorage();
+    applyQueue = std::make_unique<PresetApplyQueue>(gameWrapper, cvarManager);
+    applyQueue->ProbeSupport();
 
     RegisterConsoleCommands();
     gameWrapper->RegisterDrawable(std::bind(&ExpandedPresetsPlugin::RenderCanvas, this, std::placeholders::_1));
@@ -67,8 +95,15 @@ void ExpandedPresetsPlugin::onUnload()
 {
     if (presetManager)
     {
+        presetManager->StopWatchingFiles();
         presetManager->SaveToStorage();
+        presetManager->FlushStorage();
+        // Cancels a running import before the pool it runs on is joined.
+        presetManager.reset();
     }
+    workerPool.Stop();
+    thumbnailAtlas.reset();
+    applyQueue.reset();
 
     guiManager->RemoveHotkey(GetMenuName());
     guiManager->RemovePluginWindow(GetMenuName());
@@ -77,6 +112,7 @@ void ExpandedPresetsPlugin::onUnload()
 
 void ExpandedPresetsPlugin::Render()
 {
+    EXP_PRESETS_PROFILE_SCOPE(Render);
     if (!windowOpen || !*windowOpen)
     {
         return;
@@ -102,6 +138,7 @@ void ExpandedPresetsPlugin::Render()
 
 void ExpandedPresetsPlugin::RenderCanvas(CanvasWrapper canvas)
 {
+    EXP_PRESETS_PROFILE_SCOPE(RenderCanvas);
     if (!windowOpen || !*windowOpen)
     {
         return;
@@ -112,17 +149,34 @@ void ExpandedPresetsPlugin::RenderCanvas(CanvasWrapper canvas)
         return;
     }
 
-    const auto &presets = presetManager->GetPresets();
-    if (selectedPresetIndex < 0 || selectedPresetIndex >= static_cast<int>(presets.size()))
+    // The text only changes with the selection or the collection; most frames reuse it as is.
+    if (selectedPresetId != overlayPresetId || presetManager->GetRevision() != overlayRevision)
+    {
+        const auto &hotColumns = presetManager->GetHotColumns();
+        overlayText.clear();
+        const auto index = presetManager->FindPresetIndexById(selectedPresetId);
+        if (index < hotColumns.Size())
+        {
+            overlayText.append(overlayPrefix).append(hotColumns.Name(index));
+        }
+        overlayPresetId = selectedPresetId;
+        overlayRevision = presetManager->GetRevision();
+    }
+    if (overlayText.empty())
     {
         return;
     }
 
-    const auto &preset = presets[static_cast<std::size_t>(selectedPresetIndex)];
+    if (overlayInMatches && !*overlayInMatches && gameWrapper && gameWrapper->IsInOnlineGame())
+    {
+        return;
+    }
 
     canvas.SetColor(255, 255, 255, 255);
-    canvas.SetPosition(35.0f, 35.0f);
-    canvas.DrawString("Previewing preset: " + preset.name, 2.0f, 2.0f);
+    canvas.SetPosition(overlayX, overlayY);
+    // DrawString takes the string by value, so one copy per frame is left; the canvas is cleared
+    // every frame, so the string itself has to be submitted again each time.
+    canvas.DrawString(overlayText, overlayScale, overlayScale);
 }
 
 bool ExpandedPresetsPlugin::ShouldBlockInput()
@@ -155,10 +209,7 @@ void ExpandedPresetsPlugin::OnOpen()
 
 void ExpandedPresetsPlugin::OnClose()
 {
-    if (presetManager)
-    {
-        presetManager->SaveToStorage();
-    }
+    // Edits are already journaled; the cfg itself is rewritten at unload.
     if (cvarManager)
     {
         cvarManager->log("ExpandedPresets: Window closed.");
@@ -171,10 +222,131 @@ void ExpandedPresetsPlugin::RenderSettings()
     ImGui::Separator();
     ImGui::TextWrapped("Use the \"Expanded Presets\" hotkey (default: unbound) or run 'expandedpresets_toggle' in the BakkesMod console to open the UI.");
     ImGui::TextWrapped("Presets are stored in the bakkesmod/data/ExpandedPresets/expanded_presets.cfg file. You can safely edit this file while Rocket League is closed.");
-    if (ImGui::Button("Import vanilla presets now"))
+    if (ImGui::Button("Sync vanilla presets now"))
+    {
+        MergeVanillaPresets();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Replace library with vanilla presets"))
     {
         ImportVanillaPresets();
     }
+    ImGui::TextWrapped("Catalogs downloaded with tools/download_bakkesplugins_cars.py are merged from bakkesplugins_cars.cfg in the same folder.");
+    if (ImGui::Button("Import catalog"))
+    {
+        ImportCatalog();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Collapse duplicate loadouts"))
+    {
+        CollapseDuplicates();
+    }
+
+    if (presetManager)
+    {
+        bool sharded = presetManager->IsShardedStorage();
+        if (ImGui::Checkbox("Split storage into shards", &sharded))
+        {
+            SetShardedStorage(sharded);
+        }
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("Keeps very large libraries in ExpandedPresets/shards so saves only rewrite the files that changed.");
+        }
+    }
+
+    if constexpr (PresetProfiler::IsEnabled())
+    {
+        ImGui::Checkbox("Show performance stats", &showProfilerStats);
+        if (showProfilerStats)
+        {
+            RenderProfilerStats();
+        }
+    }
+}
+
+void ExpandedPresetsPlugin::RenderProfilerStats() const
+{
+    const auto stats = PresetProfiler::Snapshot();
+
+    ImGui::Columns(6, "profiler_stats", true);
+    for (const auto *header : {"Zone", "Calls", "p50 ms", "p99 ms", "Max ms", "Allocs/call"})
+    {
+        ImGui::TextUnformatted(header);
+        ImGui::NextColumn();
+    }
+    ImGui::Separator();
+    for (std::size_t i = 0; i < PresetProfiler::zoneCount; ++i)
+    {
+        const auto &zone = stats.zones[i];
+        const auto name = PresetProfiler::ZoneName(static_cast<PresetProfiler::Zone>(i));
+        ImGui::TextUnformatted(name.data(), name.data() + name.size());
+        ImGui::NextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(zone.calls));
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", ToMilliseconds(zone.p50));
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", ToMilliseconds(zone.p99));
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", ToMilliseconds(zone.max));
+        ImGui::NextColumn();
+        ImGui::Text("%.1f", zone.allocationsPerCall);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    for (std::size_t i = 0; i < PresetProfiler::counterCount; ++i)
+    {
+        const auto name = PresetProfiler::CounterName(static_cast<PresetProfiler::Counter>(i));
+        ImGui::Text("%.*s: %llu", static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(stats.counters[i]));
+    }
+    if (presetManager)
+    {
+        ImGui::TextUnformatted(FormatStringArenaStats(presetManager->GetStringArenaStats()).c_str());
+    }
+    if (ImGui::Button("Reset stats"))
+    {
+        PresetProfiler::Reset();
+    }
+}
+
+void ExpandedPresetsPlugin::LogProfilerStats() const
+{
+    if (!cvarManager)
+    {
+        return;
+    }
+    // Arena usage is tracked regardless of EXP_PRESETS_PROFILING.
+    if (presetManager)
+    {
+        cvarManager->log("ExpandedPresets: " + FormatStringArenaStats(presetManager->GetStringArenaStats()));
+    }
+    if (!PresetProfiler::IsEnabled())
+    {
+        cvarManager->log("ExpandedPresets: This build was compiled without EXP_PRESETS_PROFILING.");
+        return;
+    }
+
+    const auto stats = PresetProfiler::Snapshot();
+    for (std::size_t i = 0; i < PresetProfiler::zoneCount; ++i)
+    {
+        const auto &zone = stats.zones[i];
+        if (zone.calls == 0)
+        {
+            continue;
+        }
+        const auto name = PresetProfiler::ZoneName(static_cast<PresetProfiler::Zone>(i));
+        char line[160];
+        std::snprintf(line, sizeof(line), "ExpandedPresets: %-18.*s calls %8llu  p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms  allocs/call %.1f",
+                      static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(zone.calls),
+                      ToMilliseconds(zone.p50), ToMilliseconds(zone.p99), ToMilliseconds(zone.max), zone.allocationsPerCall);
+        cvarManager->log(line);
+    }
+    for (std::size_t i = 0; i < PresetProfiler::counterCount; ++i)
+    {
+        const auto name = PresetProfiler::CounterName(static_cast<PresetProfiler::Counter>(i));
+        cvarManager->log("ExpandedPresets: " + std::string(name) + " " + std::to_string(stats.counters[i]));
+    }
 }
 
 std::string ExpandedPresetsPlugin::GetPluginName()
@@ -193,6 +365,37 @@ void ExpandedPresetsPlugin::RegisterConsoleCommands()
     auto windowCvar = cvarManager->registerCvar("expandedpresets_window_open", "0", "Whether the expanded presets UI is visible", true, true, 0.0f, true, 1.0f);
     windowCvar.bindTo(windowOpen);
 
+    overlayInMatches = std::make_shared<bool>(true);
+    auto overlayCvar = cvarManager->registerCvar("expandedpresets_overlay_in_matches", "1",
+                                                 "Show the 'Previewing preset' overlay while in an online match", true, true, 0.0f, true, 1.0f);
+    overlayCvar.bindTo(overlayInMatches);
+
+    cycleIntervalMs = std::make_shared<int>(1500);
+    auto cycleCvar = cvarManager->registerCvar("expandedpresets_cycle_interval_ms", "1500",
+                                               "Milliseconds each preset is shown while cycling previews", true, true, 250.0f, true, 60000.0f);
+    cycleCvar.bindTo(cycleIntervalMs);
+
+    auto saveDelayCvar = cvarManager->registerCvar("expandedpresets_save_delay_ms",
+                                                   std::to_string(PresetStorageWriter::defaultDebounceWindow.count()),
+                                                   "Milliseconds to coalesce preset saves before writing expanded_presets.cfg",
+                                                   true, true, 0.0f, true, 10000.0f);
+    saveDelayCvar.addOnValueChanged([this](const std::string &, CVarWrapper cvar)
+                                    {
+                                        if (presetManager)
+                                        {
+                                            presetManager->SetSaveDebounceWindow(std::chrono::milliseconds(cvar.getIntValue()));
+                                        }
+                                    });
+
+    auto watchCvar = cvarManager->registerCvar("expandedpresets_watch_files", "1",
+                                               "Pick up changes to presets.data and expanded_presets.cfg made while the game is running",
+                                               true, true, 0.0f, true, 1.0f);
+    watchCvar.addOnValueChanged([this](const std::string &, CVarWrapper cvar)
+                                {
+                                    SetFileWatching(cvar.getBoolValue());
+                                });
+    SetFileWatching(watchCvar.getBoolValue());
+
     cvarManager->registerNotifier("expandedpresets_toggle",
                                   [this](const std::vector<std::string> &)
                                   {
@@ -209,24 +412,206 @@ void ExpandedPresetsPlugin::RegisterConsoleCommands()
                                   "Toggle the expanded presets window", PERMISSION_ALL);
 
     cvarManager->registerNotifier("expandedpresets_import",
+                                  [this](const std::vector<std::string> &args)
+                                  {
+                                      if (args.size() > 1 && args[1] == "replace")
+                                      {
+                                          ImportVanillaPresets();
+                                      }
+                                      else
+                                      {
+                                          MergeVanillaPresets();
+                                      }
+                                  },
+                                  "Merge presets from presets.data into the expanded manager; 'expandedpresets_import replace' discards the library and re-imports it", PERMISSION_ALL);
+
+    cvarManager->registerNotifier("expandedpresets_import_bakkesplugins",
+                                  [this](const std::vector<std::string> &)
+                                  {
+                                      ImportCatalog();
+                                  },
+                                  "Merge bakkesplugins_cars.cfg from the ExpandedPresets data folder into the expanded manager", PERMISSION_ALL);
+
+    cvarManager->registerNotifier("expandedpresets_export",
+                                  [this](const std::vector<std::string> &args)
+                                  {
+                                      ExportPack(args.size() > 1 ? args[1] : std::string());
+                                  },
+                                  "Write the library to a compressed preset pack in the ExpandedPresets data folder, expanded_presets.pack unless a file name is given", PERMISSION_ALL);
+
+    cvarManager->registerNotifier("expandedpresets_import_pack",
+                                  [this](const std::vector<std::string> &args)
+                                  {
+                                      ImportPack(args.size() > 1 ? args[1] : std::string());
+                                  },
+                                  "Merge a preset pack from the ExpandedPresets data folder into the expanded manager, expanded_presets.pack unless a file name is given", PERMISSION_ALL);
+
+    cvarManager->registerNotifier("expandedpresets_cycle_previews",
+                                  [this](const std::vector<std::string> &)
+                                  {
+                                      ToggleCyclePreviews();
+                                  },
+                                  "Start or stop previewing the presets matching the current search one after another", PERMISSION_ALL);
+
+    cvarManager->registerNotifier("expandedpresets_collapse_duplicates",
                                   [this](const std::vector<std::string> &)
                                   {
-                                      ImportVanillaPresets();
+                                      CollapseDuplicates();
                                   },
-                                  "Import presets from presets.data into the expanded manager", PERMISSION_ALL);
+                                  "Remove presets whose loadout matches an earlier preset, keeping the first one", PERMISSION_ALL);
+
+    cvarManager->registerNotifier("expandedpresets_storage_layout",
+                                  [this](const std::vector<std::string> &args)
+                                  {
+                                      if (args.size() > 1 && (args[1] == "single" || args[1] == "sharded"))
+                                      {
+                                          SetShardedStorage(args[1] == "sharded");
+                                          return;
+                                      }
+                                      if (presetManager)
+                                      {
+                                          cvarManager->log(std::string("ExpandedPresets: Storage layout is ") +
+                                                           (presetManager->IsShardedStorage() ? "sharded" : "single") +
+                                                           "; pass 'single' or 'sharded' to switch.");
+                                      }
+                                  },
+                                  "Show or switch the storage layout: 'single' (expanded_presets.cfg) or 'sharded'", PERMISSION_ALL);
+
+    cvarManager->registerNotifier("expandedpresets_stats",
+                                  [this](const std::vector<std::string> &args)
+                                  {
+                                      if (args.size() > 1 && args[1] == "reset")
+                                      {
+                                          PresetProfiler::Reset();
+                                          cvarManager->log("ExpandedPresets: Performance stats reset.");
+                                          return;
+                                      }
+                                      LogProfilerStats();
+                                  },
+                                  "Print p50/p99 timings and allocation counts of the plugin's hot paths; pass 'reset' to start over", PERMISSION_ALL);
+
+    cvarManager->registerNotifier("expandedpresets_search",
+                                  [this](const std::vector<std::string> &args)
+                                  {
+                                      std::string queryText;
+                                      for (std::size_t i = 1; i < args.size(); ++i)
+                                      {
+                                          if (!queryText.empty())
+                                          {
+                                              queryText.push_back(' ');
+                                          }
+                                          queryText += args[i];
+                                      }
+                                      LogQueryResults(queryText);
+                                  },
+                                  "Search presets, e.g. expandedpresets_search car:fennec wheels:zomba matte:1 primary~#f06c20", PERMISSION_ALL);
+}
+
+void ExpandedPresetsPlugin::SetShardedStorage(bool enabled)
+{
+    if (!presetManager || !presetManager->SetShardedStorage(enabled))
+    {
+        return;
+    }
+    if (cvarManager)
+    {
+        cvarManager->log(enabled ? "ExpandedPresets: Presets will be stored in " + (presetManager->GetDataFolder() / "shards").string() + "."
+                                 : std::string("ExpandedPresets: Presets will be stored in expanded_presets.cfg again."));
+    }
+}
+
+void ExpandedPresetsPlugin::SetFileWatching(bool enabled)
+{
+    if (!presetManager)
+    {
+        return;
+    }
+
+    if (!enabled)
+    {
+        presetManager->StopWatchingFiles();
+        return;
+    }
+
+    presetManager->StartWatchingFiles([this](const std::filesystem::path &file, const PresetManager::ExternalChangeSummary &summary)
+                                      {
+                                          if (cvarManager)
+                                          {
+                                              std::stringstream stream;
+                                              stream << "ExpandedPresets: Picked up changes to " << file.filename().string() << ": "
+                                                     << summary.added << " added, " << summary.updated << " updated, "
+                                                     << summary.removed << " removed";
+                                              cvarManager->log(stream.str());
+                                          }
+                                      });
+}
+
+void ExpandedPresetsPlugin::LogQueryResults(const std::string &queryText) const
+{
+    if (!presetManager || !cvarManager)
+    {
+        return;
+    }
+
+    constexpr std::size_t maxLoggedResults = 25;
+
+    const auto query = PresetQuery::Parse(queryText);
+    for (const auto &error : query.errors)
+    {
+        cvarManager->log("ExpandedPresets: Query error: " + error);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto matches = presetManager->QueryPresets(query);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    const auto snapshot = presetManager->GetSnapshot();
+    for (std::size_t i = 0; i < matches.size() && i < maxLoggedResults; ++i)
+    {
+        const auto &preset = (*snapshot)[matches[i].index];
+        std::stringstream stream;
+        stream << "  " << std::fixed << std::setprecision(2) << matches[i].score << "  " << preset.name
+               << "  [" << presetManager->GetLabel(preset.customization.carLabel)
+               << " / " << presetManager->GetLabel(preset.customization.decalLabel)
+               << " / " << presetManager->GetLabel(preset.customization.wheelsLabel) << "]  " << preset.loadoutCode;
+        cvarManager->log(stream.str());
+    }
+
+    std::stringstream summary;
+    summary << "ExpandedPresets: " << matches.size() << " presets matched '" << queryText << "' in " << elapsed.count() << " us";
+    if (matches.size() > maxLoggedResults)
+    {
+        summary << " (showing the first " << maxLoggedResults << ")";
+    }
+    cvarManager->log(summary.str());
 }
 
 void ExpandedPresetsPlugin::RenderPresetList()
 {
-    auto &presets = presetManager->GetPresets();
+    EXP_PRESETS_PROFILE_SCOPE(RenderPresetList);
+    const auto &hotColumns = presetManager->GetHotColumns();
 
-    ImGui::Text("Presets (%zu)", presets.size());
+    ImGui::Text("Presets (%zu)", hotColumns.Size());
 
-    ImGui::InputTextWithHint("##preset_search", "Search by name or loadout code", &pendingFilter);
+    ImGui::InputTextWithHint("##preset_search", "Search, e.g. sunset car:fennec matte:1 primary~#f06c20", &pendingFilter);
+    if (!filterError.empty())
+    {
+        ImGui::TextDisabled("%s", filterError.c_str());
+    }
 
-    if (ImGui::Button("Import vanilla"))
+    if (ImGui::Button("Sync vanilla"))
     {
-        ImportVanillaPresets();
+        MergeVanillaPresets();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Import catalog"))
+    {
+        ImportCatalog();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Collapse duplicates"))
+    {
+        CollapseDuplicates();
     }
     ImGui::SameLine();
     if (ImGui::Button("Save all"))
@@ -234,45 +619,216 @@ void ExpandedPresetsPlugin::RenderPresetList()
         presetManager->SaveToStorage();
     }
 
+    ImGui::SameLine();
+    if (ImGui::Button(applyQueue && applyQueue->IsCycling() ? "Stop cycling" : "Cycle previews"))
+    {
+        ToggleCyclePreviews();
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Gallery", &galleryView);
+
+    if (const auto progress = presetManager->GetCatalogImportProgress())
+    {
+        ImGui::ProgressBar(*progress, ImVec2(-1.0f, 0.0f), "Importing catalog...");
+    }
+
     ImGui::Separator();
 
-    const auto filterLower = ToLower(pendingFilter);
+    RefreshPresetListCache();
+    if (galleryView)
+    {
+        RenderPresetGallery();
+        return;
+    }
 
     if (ImGui::BeginChild("preset_list_scroller", ImVec2(0.0f, 0.0f), false, ImGuiWindowFlags_HorizontalScrollbar))
     {
-        for (std::size_t i = 0; i < presets.size(); ++i)
+        // Only the rows inside the scroll region are submitted; the clipper fakes the rest. Rows
+        // read the hot columns and only touch the full preset when selected or hovered.
+        auto *drawList = ImGui::GetWindowDrawList();
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(filteredPresetIndices.size()));
+        while (clipper.Step())
         {
-            const auto &preset = presets[i];
-            if (!filterLower.empty())
+            EXP_PRESETS_PROFILE_COUNT(ListRowsDrawn, static_cast<std::uint64_t>(clipper.DisplayEnd - clipper.DisplayStart));
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
             {
-                const auto nameLower = ToLower(preset.name);
-                const auto codeLower = ToLower(preset.loadoutCode);
-                if (nameLower.find(filterLower) == std::string::npos && codeLower.find(filterLower) == std::string::npos)
+                const auto i = filteredPresetIndices[static_cast<std::size_t>(row)];
+
+                ImGui::PushID(static_cast<int>(i));
+                const bool selected = presetManager->GetPresetId(i) == selectedPresetId;
+                if (ImGui::Selectable(hotColumns.NameCString(i), selected))
                 {
-                    continue;
+                    selectedPresetId = presetManager->GetPresetId(i);
+                    editingPreset = presetManager->ToEditable(presetManager->GetPreset(i));
                 }
-            }
 
-            const bool selected = static_cast<int>(i) == selectedPresetIndex;
-            const std::string label = preset.name + "##preset_item_" + std::to_string(i);
-            if (ImGui::Selectable(label.c_str(), selected))
-            {
-                selectedPresetIndex = static_cast<int>(i);
-                editingPreset = preset;
+                const ImVec2 rowMin = ImGui::GetItemRectMin();
+                const ImVec2 rowMax = ImGui::GetItemRectMax();
+                const float swatchSize = rowMax.y - rowMin.y;
+                const ImVec2 accentMin(rowMax.x - swatchSize, rowMin.y);
+                const ImVec2 primaryMin(accentMin.x - swatchSize - 2.0f, rowMin.y);
+                drawList->AddRectFilled(primaryMin, primaryMin + ImVec2(swatchSize, swatchSize), ToImColor(hotColumns.PrimaryColor(i)));
+                drawList->AddRectFilled(accentMin, rowMax, ToImColor(hotColumns.AccentColor(i)));
+
+                const auto duplicates = presetManager->GetDuplicateCount(i);
+                char badge[24] = "";
+                if (duplicates > 1)
+                {
+                    std::snprintf(badge, sizeof(badge), "x%zu", duplicates);
+                    const ImVec2 badgeSize = ImGui::CalcTextSize(badge);
+                    drawList->AddText(ImVec2(primaryMin.x - badgeSize.x - 4.0f, rowMin.y), ImGui::GetColorU32(ImGuiCol_TextDisabled), badge);
+                }
+
+                if (ImGui::IsItemHovered())
+                {
+                    ImGui::BeginTooltip();
+                    ImGui::TextUnformatted("Loadout code:");
+                    ImGui::TextWrapped("%s", presetManager->GetPreset(i).loadoutCode.c_str());
+                    if (duplicates > 1)
+                    {
+                        ImGui::TextDisabled("Same loadout as %zu other presets", duplicates - 1);
+                    }
+                    ImGui::EndTooltip();
+                }
+                ImGui::PopID();
             }
+        }
+        clipper.End();
+    }
+    ImGui::EndChild();
+}
+
+void ExpandedPresetsPlugin::RenderPresetGallery()
+{
+    if (!thumbnailAtlas)
+    {
+        thumbnailAtlas = std::make_unique<PresetThumbnailAtlas>(presetManager->GetDataFolder() / "thumbnails",
+                                                                [gameWrapper = gameWrapper, cvar = cvarManager](const std::string &message)
+                                                                {
+                                                                    // Called on the atlas worker; the console belongs to the game thread.
+                                                                    gameWrapper->Execute([cvar, message](GameWrapper *)
+                                                                                         {
+                                                                                             cvar->log(message);
+                                                                                         });
+                                                                });
+    }
+    thumbnailAtlas->BeginFrame();
+
+    const auto &hotColumns = presetManager->GetHotColumns();
+    const ImVec2 thumbnailSize(static_cast<float>(PresetThumbnail::width) * 1.5f, static_cast<float>(PresetThumbnail::height) * 1.5f);
+    constexpr float spacing = 6.0f;
 
-            if (ImGui::IsItemHovered())
+    if (ImGui::BeginChild("preset_gallery_scroller", ImVec2(0.0f, 0.0f), false))
+    {
+        // Rows of thumbnails go through the clipper like list rows, so only visible presets ask the
+        // atlas for a thumbnail.
+        const auto columns = static_cast<std::size_t>(std::max(1.0f, (ImGui::GetContentRegionAvail().x + spacing) / (thumbnailSize.x + spacing)));
+        const auto rows = (filteredPresetIndices.size() + columns - 1) / columns;
+        auto *drawList = ImGui::GetWindowDrawList();
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(rows));
+        while (clipper.Step())
+        {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
             {
-                ImGui::BeginTooltip();
-                ImGui::TextUnformatted("Loadout code:");
-                ImGui::TextWrapped("%s", preset.loadoutCode.c_str());
-                ImGui::EndTooltip();
+                for (std::size_t column = 0; column < columns; ++column)
+                {
+                    const auto position = static_cast<std::size_t>(row) * columns + column;
+                    if (position >= filteredPresetIndices.size())
+                    {
+                        break;
+                    }
+                    const auto i = filteredPresetIndices[position];
+                    if (column > 0)
+                    {
+                        ImGui::SameLine(0.0f, spacing);
+                    }
+
+                    ImGui::PushID(static_cast<int>(i));
+                    if (ImGui::InvisibleButton("thumbnail", thumbnailSize))
+                    {
+                        selectedPresetId = presetManager->GetPresetId(i);
+                        editingPreset = presetManager->ToEditable(presetManager->GetPreset(i));
+                    }
+
+                    const ImVec2 cellMin = ImGui::GetItemRectMin();
+                    const ImVec2 cellMax = ImGui::GetItemRectMax();
+                    const auto key = PresetThumbnail::MakeKey(hotColumns.PrimaryColor(i), hotColumns.AccentColor(i), hotColumns.Flags(i));
+                    if (const auto region = thumbnailAtlas->Acquire(key))
+                    {
+                        drawList->AddImage(region->texture, cellMin, cellMax, ImVec2(region->u0, region->v0), ImVec2(region->u1, region->v1));
+                    }
+                    else
+                    {
+                        // Flat placeholder in the preset's colours until the thumbnail is ready.
+                        drawList->AddRectFilled(cellMin, cellMax, ToImColor(hotColumns.PrimaryColor(i)), 6.0f);
+                        const ImVec2 stripeMin(cellMin.x, cellMin.y + thumbnailSize.y * 0.5f);
+                        const ImVec2 stripeMax(cellMax.x, cellMin.y + thumbnailSize.y * 0.7f);
+                        drawList->AddRectFilled(stripeMin, stripeMax, ToImColor(hotColumns.AccentColor(i)));
+                    }
+
+                    if (presetManager->GetPresetId(i) == selectedPresetId)
+                    {
+                        drawList->AddRect(cellMin, cellMax, ImGui::GetColorU32(ImGuiCol_Text), 6.0f, 0, 2.0f);
+                    }
+                    if (ImGui::IsItemHovered())
+                    {
+                        ImGui::SetTooltip("%s", hotColumns.NameCString(i));
+                    }
+                    ImGui::PopID();
+                }
             }
         }
+        clipper.End();
     }
     ImGui::EndChild();
 }
 
+void ExpandedPresetsPlugin::RefreshPresetListCache()
+{
+    const bool collectionChanged = presetManager->GetRevision() != presetListRevision;
+    if (!collectionChanged && pendingFilter == appliedFilter)
+    {
+        return;
+    }
+
+    filterError.clear();
+    if (PresetQuery::IsStructured(pendingFilter))
+    {
+        const auto query = PresetQuery::Parse(pendingFilter);
+        if (!query.errors.empty())
+        {
+            filterError = query.errors.front();
+        }
+
+        // Structured queries come back ranked, so the list shows the best matches first.
+        filteredPresetIndices.clear();
+        for (const auto &match : presetManager->QueryPresets(query))
+        {
+            filteredPresetIndices.push_back(match.index);
+        }
+    }
+    else
+    {
+        // Typing another character only narrows the previous result, so refine it instead of
+        // searching the whole library again.
+        const bool filterNarrowed = !appliedFilter.empty() && !PresetQuery::IsStructured(appliedFilter) &&
+                                    PresetSearchIndex::ToLower(pendingFilter).find(PresetSearchIndex::ToLower(appliedFilter)) != std::string::npos;
+        if (!collectionChanged && filterNarrowed)
+        {
+            presetManager->RefineFilter(pendingFilter, filteredPresetIndices);
+        }
+        else
+        {
+            filteredPresetIndices = presetManager->FilterPresets(pendingFilter);
+        }
+    }
+
+    appliedFilter = pendingFilter;
+    presetListRevision = presetManager->GetRevision();
+}
+
 void ExpandedPresetsPlugin::RenderPresetEditor()
 {
     ImGui::TextUnformatted("Preset details");
@@ -281,6 +837,19 @@ void ExpandedPresetsPlugin::RenderPresetEditor()
     ImGui::InputText("Name", &editingPreset.name);
     ImGui::InputText("Loadout code", &editingPreset.loadoutCode);
     ImGui::InputText("Car", &editingPreset.customization.carLabel);
+    ImGui::SameLine();
+    if (ImGui::Button("Detect from code"))
+    {
+        const auto detected = PresetManager::DetectCarLabel(editingPreset.loadoutCode);
+        if (detected.empty())
+        {
+            cvarManager->log("ExpandedPresets: Could not detect a known car body in the loadout code.");
+        }
+        else
+        {
+            editingPreset.customization.carLabel.assign(detected);
+        }
+    }
     ImGui::InputText("Decal", &editingPreset.customization.decalLabel);
     ImGui::InputText("Wheels", &editingPreset.customization.wheelsLabel);
 
@@ -304,6 +873,7 @@ void ExpandedPresetsPlugin::RenderPresetEditor()
     }
 
     RenderPreviewPanel();
+    RenderSimilarPresets();
 
     if (ImGui::Button("Add / Update"))
     {
@@ -316,9 +886,8 @@ void ExpandedPresetsPlugin::RenderPresetEditor()
         }
         else
         {
-            presetManager->AddOrUpdatePreset(editingPreset);
-            presetManager->SaveToStorage();
-            selectedPresetIndex = static_cast<int>(presetManager->FindPresetIndex(editingPreset.name));
+            presetManager->EditPreset(editingPreset);
+            selectedPresetId = presetManager->GetPresetId(presetManager->FindPresetIndex(editingPreset.name));
         }
     }
     ImGui::SameLine();
@@ -326,18 +895,33 @@ void ExpandedPresetsPlugin::RenderPresetEditor()
     {
         ResetEditingPreset();
     }
+    if (presetManager->CanUndo())
+    {
+        ImGui::SameLine();
+        if (ImGui::Button("Undo"))
+        {
+            StepEditHistory(false);
+        }
+    }
+    if (presetManager->CanRedo())
+    {
+        ImGui::SameLine();
+        if (ImGui::Button("Redo"))
+        {
+            StepEditHistory(true);
+        }
+    }
 
-    if (selectedPresetIndex >= 0)
+    if (selectedPresetId != invalidPresetId)
     {
         ImGui::SameLine();
         if (ImGui::Button("Delete"))
         {
-            auto &presets = presetManager->GetPresets();
-            if (selectedPresetIndex < static_cast<int>(presets.size()))
+            const auto index = presetManager->FindPresetIndexById(selectedPresetId);
+            if (index < presetManager->GetPresetCount())
             {
-                presetManager->RemovePreset(presets[static_cast<std::size_t>(selectedPresetIndex)].name);
-                presetManager->SaveToStorage();
-                selectedPresetIndex = -1;
+                presetManager->DeletePreset(std::string(presetManager->GetPreset(index).name));
+                selectedPresetId = invalidPresetId;
                 ResetEditingPreset();
             }
         }
@@ -351,11 +935,24 @@ void ExpandedPresetsPlugin::RenderPresetEditor()
         {
             ApplyPresetToCar(editingPreset, false);
         }
+        ImGui::SameLine();
+        if (ImGui::Button("Copy code") && cvarManager)
+        {
+            try
+            {
+                cvarManager->setClipboardText(editingPreset.loadoutCode);
+            }
+            catch (...)
+            {
+                cvarManager->log("ExpandedPresets: Could not access the clipboard.");
+            }
+        }
     }
 }
 
 void ExpandedPresetsPlugin::RenderPreviewPanel()
 {
+    EXP_PRESETS_PROFILE_SCOPE(RenderPreviewPanel);
     ImGui::Separator();
     ImGui::TextUnformatted("Preset preview");
 
@@ -365,36 +962,125 @@ void ExpandedPresetsPlugin::RenderPreviewPanel()
     const ImVec2 canvasMin = ImGui::GetItemRectMin();
     const ImVec2 canvasMax = ImGui::GetItemRectMax();
 
+    // The silhouette only depends on the customization and canvas size, so most frames just
+    // copy last frame's vertices.
     auto *drawList = ImGui::GetWindowDrawList();
-    const ImU32 background = ImGui::ColorConvertFloat4ToU32(ImVec4(0.07f, 0.08f, 0.09f, 1.0f));
-    drawList->AddRectFilled(canvasMin, canvasMax, background, 12.0f);
+    const auto &customization = editingPreset.customization;
+    const bool replayed = previewCache.Replay(*drawList, canvasMin, canvasSize, customization);
+    if (replayed)
+    {
+        EXP_PRESETS_PROFILE_COUNT(PreviewReplays, 1);
+    }
+    else
+    {
+        EXP_PRESETS_PROFILE_COUNT(PreviewCaptures, 1);
+        previewCache.BeginCapture(*drawList);
+
+        const ImU32 background = ImGui::ColorConvertFloat4ToU32(ImVec4(0.07f, 0.08f, 0.09f, 1.0f));
+        drawList->AddRectFilled(canvasMin, canvasMax, background, 12.0f);
+
+        const ImVec2 padding(18.0f, 18.0f);
+        const ImVec2 bodyMin = canvasMin + padding;
+        const ImVec2 bodyMax = canvasMax - padding;
 
-    const ImVec2 padding(18.0f, 18.0f);
-    const ImVec2 bodyMin = canvasMin + padding;
-    const ImVec2 bodyMax = canvasMax - padding;
+        drawList->AddRectFilled(bodyMin, bodyMax, ToImColor(customization.primaryColor), 22.0f);
 
-    drawList->AddRectFilled(bodyMin, bodyMax, ToImColor(editingPreset.customization.primaryColor), 22.0f);
+        const ImVec2 stripeMin = bodyMin + ImVec2(0.0f, (bodyMax.y - bodyMin.y) * 0.45f);
+        const ImVec2 stripeMax = bodyMax - ImVec2(0.0f, (bodyMax.y - bodyMin.y) * 0.25f);
+        drawList->AddRectFilled(stripeMin, stripeMax, ToImColor(customization.accentColor), 18.0f);
 
-    const ImVec2 stripeMin = bodyMin + ImVec2(0.0f, (bodyMax.y - bodyMin.y) * 0.45f);
-    const ImVec2 stripeMax = bodyMax - ImVec2(0.0f, (bodyMax.y - bodyMin.y) * 0.25f);
-    drawList->AddRectFilled(stripeMin, stripeMax, ToImColor(editingPreset.customization.accentColor), 18.0f);
+        const ImVec2 wheelRadius(30.0f, 30.0f);
+        const ImVec2 leftWheelCenter(bodyMin.x + 60.0f, bodyMax.y - 25.0f);
+        const ImVec2 rightWheelCenter(bodyMax.x - 60.0f, bodyMax.y - 25.0f);
+        const ImU32 wheelColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.12f, 0.12f, 0.12f, 1.0f));
+        drawList->AddCircleFilled(leftWheelCenter, wheelRadius.x, wheelColor, 32);
+        drawList->AddCircleFilled(rightWheelCenter, wheelRadius.x, wheelColor, 32);
 
-    const ImVec2 wheelRadius(30.0f, 30.0f);
-    const ImVec2 leftWheelCenter(bodyMin.x + 60.0f, bodyMax.y - 25.0f);
-    const ImVec2 rightWheelCenter(bodyMax.x - 60.0f, bodyMax.y - 25.0f);
-    const ImU32 wheelColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.12f, 0.12f, 0.12f, 1.0f));
-    drawList->AddCircleFilled(leftWheelCenter, wheelRadius.x, wheelColor, 32);
-    drawList->AddCircleFilled(rightWheelCenter, wheelRadius.x, wheelColor, 32);
+        previewCache.EndCapture(*drawList, canvasMin, canvasSize, customization);
+    }
 
     ImGui::SetCursorScreenPos(canvasMin + ImVec2(12.0f, 12.0f));
-    ImGui::BeginGroup();
-    ImGui::Text("Car: %s", editingPreset.customization.carLabel.c_str());
-    ImGui::Text("Decal: %s", editingPreset.customization.decalLabel.c_str());
-    ImGui::Text("Wheels: %s", editingPreset.customization.wheelsLabel.c_str());
-    ImGui::Text("Finish: %s%s",
-                editingPreset.customization.paintFinishMatte ? "Matte" : "Gloss",
-                editingPreset.customization.paintFinishPearlescent ? ", Pearlescent" : "");
-    ImGui::EndGroup();
+    const auto &caption = previewCache.Caption();
+    ImGui::TextUnformatted(caption.data(), caption.data() + caption.size());
+}
+
+void ExpandedPresetsPlugin::RenderSimilarPresets()
+{
+    if (!presetManager)
+    {
+        return;
+    }
+
+    ImGui::Separator();
+    ImGui::TextUnformatted("Similar colours");
+
+    // Only a colour edit, another selection or a change to the collection moves the neighbours.
+    const auto &customization = editingPreset.customization;
+    const std::array<PresetPaintColor, 2> colors{customization.primaryColor, customization.accentColor};
+    if (similarPresetsRevision != presetManager->GetRevision() || similarPresetsExcluded != selectedPresetId ||
+        similarPresetsColors != colors)
+    {
+        similarPresets = presetManager->FindSimilarColors(colors[0], colors[1], similarPresetCount, selectedPresetId);
+        similarPresetsColors = colors;
+        similarPresetsExcluded = selectedPresetId;
+        similarPresetsRevision = presetManager->GetRevision();
+    }
+    if (similarPresets.empty())
+    {
+        ImGui::TextDisabled("No other presets yet.");
+        return;
+    }
+
+    const auto &hotColumns = presetManager->GetHotColumns();
+    auto *drawList = ImGui::GetWindowDrawList();
+    for (const auto &neighbor : similarPresets)
+    {
+        const auto i = neighbor.slot;
+        ImGui::PushID(static_cast<int>(i));
+        const bool clicked = ImGui::Selectable(hotColumns.NameCString(i));
+
+        const ImVec2 rowMin = ImGui::GetItemRectMin();
+        const ImVec2 rowMax = ImGui::GetItemRectMax();
+        const float swatchSize = rowMax.y - rowMin.y;
+        const ImVec2 accentMin(rowMax.x - swatchSize, rowMin.y);
+        const ImVec2 primaryMin(accentMin.x - swatchSize - 2.0f, rowMin.y);
+        drawList->AddRectFilled(primaryMin, primaryMin + ImVec2(swatchSize, swatchSize), ToImColor(hotColumns.PrimaryColor(i)));
+        drawList->AddRectFilled(accentMin, rowMax, ToImColor(hotColumns.AccentColor(i)));
+
+        char distance[16];
+        std::snprintf(distance, sizeof(distance), "%.2f", neighbor.distance);
+        const ImVec2 distanceSize = ImGui::CalcTextSize(distance);
+        drawList->AddText(ImVec2(primaryMin.x - distanceSize.x - 4.0f, rowMin.y), ImGui::GetColorU32(ImGuiCol_TextDisabled), distance);
+        ImGui::PopID();
+
+        if (clicked)
+        {
+            // Loading it changes the colours, so the list is recomputed next frame.
+            selectedPresetId = presetManager->GetPresetId(i);
+            editingPreset = presetManager->ToEditable(presetManager->GetPreset(i));
+            break;
+        }
+    }
+}
+
+void ExpandedPresetsPlugin::MergeVanillaPresets()
+{
+    if (!presetManager)
+    {
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto summary = presetManager->MergeVanillaPresets();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    if (cvarManager)
+    {
+        std::stringstream stream;
+        stream << "ExpandedPresets: Synced presets.data in " << elapsed.count() << " ms: " << summary.added << " added, "
+               << summary.updated << " updated, " << summary.unchanged << " unchanged, " << summary.skipped << " skipped";
+        cvarManager->log(stream.str());
+    }
 }
 
 void ExpandedPresetsPlugin::ImportVanillaPresets()
@@ -404,11 +1090,11 @@ void ExpandedPresetsPlugin::ImportVanillaPresets()
         return;
     }
 
-    const auto previousCount = presetManager->GetPresets().size();
+    const auto previousCount = presetManager->GetPresetCount();
     presetManager->RefreshFromVanillaPresets();
     presetManager->SaveToStorage();
-    const auto newCount = presetManager->GetPresets().size();
-    selectedPresetIndex = -1;
+    const auto newCount = presetManager->GetPresetCount();
+    selectedPresetId = invalidPresetId;
     ResetEditingPreset();
 
     if (cvarManager)
@@ -423,52 +1109,197 @@ void ExpandedPresetsPlugin::ImportVanillaPresets()
     }
 }
 
-void ExpandedPresetsPlugin::ApplyPresetToCar(const CustomPreset &preset, bool previewOnly) const
+void ExpandedPresetsPlugin::ImportCatalog()
+{
+    if (!presetManager)
+    {
+        return;
+    }
+
+    const bool started = presetManager->StartCatalogImport([this](const PresetManager::CatalogImportSummary &summary)
+                                                           {
+                                                               presetManager->SaveToStorage();
+                                                               if (!cvarManager)
+                                                               {
+                                                                   return;
+                                                               }
+
+                                                               std::stringstream stream;
+                                                               stream << "ExpandedPresets: Imported " << summary.added << " new and "
+                                                                      << summary.updated << " updated presets from the catalog (parsed in "
+                                                                      << summary.parseTime.count() << " ms, merged in "
+                                                                      << summary.mergeTime.count() << " ms)";
+                                                               if (summary.duplicates > 0)
+                                                               {
+                                                                   stream << ", " << summary.duplicates << " duplicate an existing loadout";
+                                                               }
+                                                               if (summary.rejectedLines > 0)
+                                                               {
+                                                                   stream << ", skipped " << summary.rejectedLines << " malformed lines";
+                                                               }
+                                                               cvarManager->log(stream.str());
+                                                           });
+    if (started && cvarManager)
+    {
+        cvarManager->log("ExpandedPresets: Importing " + presetManager->GetCatalogFilePath().string() + " in the background.");
+    }
+}
+
+void ExpandedPresetsPlugin::ExportPack(const std::string &fileName)
 {
+    if (!presetManager)
+    {
+        return;
+    }
+
+    const auto packPath = presetManager->GetDataFolder() / (fileName.empty() ? defaultPackFileName : fileName);
+    presetManager->StartPackExport(packPath, [this, packPath](const std::optional<PresetPack::WriteSummary> &summary)
+                                   {
+                                       if (!cvarManager)
+                                       {
+                                           return;
+                                       }
+                                       if (!summary)
+                                       {
+                                           cvarManager->log("ExpandedPresets: Could not write preset pack " + packPath.string());
+                                           return;
+                                       }
+
+                                       std::stringstream stream;
+                                       stream << "ExpandedPresets: Exported " << summary->presetCount << " presets to " << packPath.string()
+                                              << " (" << summary->packedBytes / 1024 << " KiB, "
+                                              << summary->rawBytes / 1024 << " KiB uncompressed)";
+                                       cvarManager->log(stream.str());
+                                   });
+}
+
+void ExpandedPresetsPlugin::ImportPack(const std::string &fileName)
+{
+    if (!presetManager)
+    {
+        return;
+    }
+
+    const auto packPath = presetManager->GetDataFolder() / (fileName.empty() ? defaultPackFileName : fileName);
+    const auto summary = presetManager->ImportPack(packPath);
+    if (!summary)
+    {
+        return;
+    }
+    if (summary->added + summary->updated > 0)
+    {
+        presetManager->SaveToStorage();
+    }
     if (!cvarManager)
     {
         return;
     }
 
-    try
+    std::stringstream stream;
+    stream << "ExpandedPresets: Imported " << summary->added << " new and " << summary->updated
+           << " updated presets from " << packPath.string() << " in " << summary->time.count() << " ms";
+    if (!summary->complete)
     {
-        const std::string command = previewOnly ? "cl_itemmod preview " : "cl_itemmod apply ";
-        cvarManager->executeCommand(command + preset.loadoutCode);
+        stream << "; the pack is damaged past that point";
     }
-    catch (...)
+    cvarManager->log(stream.str());
+}
+
+void ExpandedPresetsPlugin::CollapseDuplicates()
+{
+    if (!presetManager)
     {
-        cvarManager->log("ExpandedPresets: Your BakkesMod build does not support automated loadout previews. The preset code has been copied to your clipboard instead.");
+        return;
     }
 
-    try
+    const auto removed = presetManager->CollapseDuplicates();
+    if (removed > 0)
     {
-        cvarManager->setClipboardText(preset.loadoutCode);
+        presetManager->SaveToStorage();
+        if (presetManager->FindPresetIndexById(selectedPresetId) == presetManager->GetPresetCount())
+        {
+            selectedPresetId = invalidPresetId;
+            ResetEditingPreset();
+        }
     }
-    catch (...)
+
+    if (cvarManager)
     {
-        // Clipboard access is optional; ignore errors so we do not crash on unsupported platforms.
+        cvarManager->log("ExpandedPresets: Removed " + std::to_string(removed) + " presets with duplicate loadouts.");
     }
+}
 
-    if (previewOnly)
+void ExpandedPresetsPlugin::ApplyPresetToCar(const EditablePreset &preset, bool previewOnly) const
+{
+    if (applyQueue)
     {
-        cvarManager->log("ExpandedPresets: Preview command triggered for preset '" + preset.name + "'.");
+        applyQueue->Enqueue({preset.name, preset.loadoutCode, previewOnly ? PresetApplyQueue::Mode::Preview : PresetApplyQueue::Mode::Equip});
     }
-    else
+}
+
+void ExpandedPresetsPlugin::ToggleCyclePreviews()
+{
+    if (!applyQueue || !presetManager)
+    {
+        return;
+    }
+    if (applyQueue->IsCycling())
+    {
+        applyQueue->StopCycle();
+        return;
+    }
+
+    // Snapshot the names and codes so edits to the library during the cycle cannot invalidate it.
+    // The list may be a frame behind the collection, hence the bounds check.
+    const auto snapshot = presetManager->GetSnapshot();
+    const auto &presets = *snapshot;
+    std::vector<PresetApplyQueue::Request> requests;
+    requests.reserve(filteredPresetIndices.size());
+    for (const auto index : filteredPresetIndices)
+    {
+        if (index < presets.Size())
+        {
+            requests.push_back({std::string(presets[index].name), std::string(presets[index].loadoutCode), PresetApplyQueue::Mode::Preview});
+        }
+    }
+
+    const auto count = requests.size();
+    applyQueue->StartCycle(std::move(requests), std::chrono::milliseconds(cycleIntervalMs ? *cycleIntervalMs : 1500));
+    if (cvarManager)
     {
-        cvarManager->log("ExpandedPresets: Equipped preset '" + preset.name + "'.");
+        cvarManager->log("ExpandedPresets: Cycling through " + std::to_string(count) + " presets.");
+    }
+}
+
+void ExpandedPresetsPlugin::StepEditHistory(bool redo)
+{
+    const auto name = redo ? presetManager->Redo() : presetManager->Undo();
+    if (!name)
+    {
+        return;
+    }
+
+    const auto index = presetManager->FindPresetIndex(*name);
+    if (index == presetManager->GetPresetCount())
+    {
+        selectedPresetId = invalidPresetId;
+        ResetEditingPreset();
+        return;
     }
+    selectedPresetId = presetManager->GetPresetId(index);
+    editingPreset = presetManager->ToEditable(presetManager->GetPreset(index));
 }
 
 void ExpandedPresetsPlugin::ResetEditingPreset()
 {
-    editingPreset = CustomPreset{};
+    editingPreset = EditablePreset{};
     editingPreset.name.clear();
     editingPreset.loadoutCode.clear();
     editingPreset.customization.primaryColor = {0.18f, 0.18f, 0.18f};
     editingPreset.customization.accentColor = {0.9f, 0.35f, 0.15f};
-    editingPreset.customization.carLabel = "Octane";
-    editingPreset.customization.decalLabel = "None";
-    editingPreset.customization.wheelsLabel = "OEM";
+    editingPreset.customization.carLabel = defaultCarLabelText;
+    editingPreset.customization.decalLabel = defaultDecalLabelText;
+    editingPreset.customization.wheelsLabel = defaultWheelsLabelText;
     editingPreset.customization.paintFinishMatte = false;
     editingPreset.customization.paintFinishPearlescent = false;
 }
@@ -1,13 +1,21 @@
 #pragma once
 
+#include "PresetApplyQueue.h"
 #include "PresetManager.h"
+#include "PresetPreviewCache.h"
+#include "PresetThumbnailAtlas.h"
+#include "PresetWorkerPool.h"
 
 #include "bakkesmod/plugin/bakkesmodplugin.h"
 #include "bakkesmod/plugin/PluginSettingsWindow.h"
 #include "bakkesmod/plugin/PluginWindow.h"
 
+#include <array>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <string>
+#include <vector>
 
 class ExpandedPresetsPlugin final : public BakkesMod::Plugin::BakkesModPlugin,
                                     public BakkesMod::Plugin::PluginSettingsWindow,
@@ -35,19 +43,63 @@ public:
     std::string GetPluginName() override;
 
 private:
+    // Started in onLoad and joined in onUnload; declared first so it outlives the manager.
+    PresetWorkerPool workerPool;
     std::unique_ptr<PresetManager> presetManager;
+    std::unique_ptr<PresetApplyQueue> applyQueue;
+    std::shared_ptr<int> cycleIntervalMs;
     std::shared_ptr<bool> windowOpen;
+    std::shared_ptr<bool> overlayInMatches;
+    // RenderCanvas text for `overlayPresetId` at `overlayRevision`.
+    std::string overlayText;
+    PresetId overlayPresetId{invalidPresetId};
+    std::uint64_t overlayRevision{std::numeric_limits<std::uint64_t>::max()};
 
     std::string pendingFilter;
-    CustomPreset editingPreset{};
-    int selectedPresetIndex{-1};
+    // Rows shown by RenderPresetList, rebuilt only when the filter text or the collection changes.
+    std::vector<std::size_t> filteredPresetIndices;
+    std::string appliedFilter;
+    std::string filterError;
+    std::uint64_t presetListRevision{std::numeric_limits<std::uint64_t>::max()};
+    EditablePreset editingPreset{};
+    PresetPreviewCache previewCache;
+    bool galleryView{false};
+    bool showProfilerStats{false};
+    // Created the first time the gallery is shown so the list view never starts its worker.
+    std::unique_ptr<PresetThumbnailAtlas> thumbnailAtlas;
+    // Kept by id so removals and reloads, which move presets between slots, cannot retarget it.
+    PresetId selectedPresetId{invalidPresetId};
+    // Presets closest to the editor's primary and accent colours, computed for
+    // `similarPresetsColors` and `similarPresetsExcluded` at `similarPresetsRevision`.
+    std::vector<PresetColorIndex::Neighbor> similarPresets;
+    std::array<PresetPaintColor, 2> similarPresetsColors{};
+    PresetId similarPresetsExcluded{invalidPresetId};
+    std::uint64_t similarPresetsRevision{std::numeric_limits<std::uint64_t>::max()};
 
     void RegisterConsoleCommands();
+    void SetFileWatching(bool enabled);
+    void SetShardedStorage(bool enabled);
+    void LogQueryResults(const std::string &queryText) const;
+    void LogProfilerStats() const;
+    void RenderProfilerStats() const;
     void RenderPresetList();
+    void RenderPresetGallery();
+    void RefreshPresetListCache();
     void RenderPresetEditor();
     void RenderPreviewPanel();
+    void RenderSimilarPresets();
     void ImportVanillaPresets();
-    void ApplyPresetToCar(const CustomPreset &preset, bool previewOnly) const;
+    void MergeVanillaPresets();
+    void ImportCatalog();
+    // `fileName` is resolved against the data folder; empty means expanded_presets.pack.
+    void ExportPack(const std::string &fileName);
+    void ImportPack(const std::string &fileName);
+    void CollapseDuplicates();
+    void ApplyPresetToCar(const EditablePreset &preset, bool previewOnly) const;
+    // Starts cycling through the presets currently shown by the list, or stops a running cycle.
+    void ToggleCyclePreviews();
+    // Undoes (or redoes) the last editor edit and loads the preset it touched into the editor.
+    void StepEditHistory(bool redo);
     void ResetEditingPreset();
 };
 
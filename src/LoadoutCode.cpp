@@ -0,0 +1,380 @@
+#include "LoadoutCode.h"
+
+#include "PresetBinaryCache.h"
+
+#include <algorithm>
+
+namespace
+{
+constexpr std::int8_t invalidSextet = -1;
+constexpr std::int8_t paddingSextet = -2;
+constexpr std::string_view base64Alphabet{"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+
+constexpr std::array<std::int8_t, 256> BuildBase64Table()
+{
+    std::array<std::int8_t, 256> table{};
+    table.fill(invalidSextet);
+    for (std::size_t i = 0; i < base64Alphabet.size(); ++i)
+    {
+        table[static_cast<unsigned char>(base64Alphabet[i])] = static_cast<std::int8_t>(i);
+    }
+    // URL-safe variants map onto the same values.
+    table[static_cast<unsigned char>('-')] = 62;
+    table[static_cast<unsigned char>('_')] = 63;
+    table[static_cast<unsigned char>('=')] = paddingSextet;
+    return table;
+}
+
+constexpr auto base64Table = BuildBase64Table();
+
+// Reads little-endian bit fields: bit 0 of byte 0 comes first.
+class BitReader
+{
+public:
+    explicit BitReader(std::span<const std::uint8_t> bytes) noexcept
+        : bytes(bytes)
+    {
+    }
+
+    // `bits` must be at most 24 so the field always fits in the four bytes loaded below.
+    std::uint32_t Read(unsigned bits) noexcept
+    {
+        if (position + bits > bytes.size() * 8)
+        {
+            overrun = true;
+            position = bytes.size() * 8;
+            return 0;
+        }
+
+        const auto byteIndex = position / 8;
+        std::uint32_t window = 0;
+        for (std::size_t i = 0; i < 4 && byteIndex + i < bytes.size(); ++i)
+        {
+            window |= static_cast<std::uint32_t>(bytes[byteIndex + i]) << (8 * i);
+        }
+
+        const auto value = (window >> (position % 8)) & ((1u << bits) - 1u);
+        position += bits;
+        return value;
+    }
+
+    bool ReadFlag() noexcept
+    {
+        return Read(1) != 0;
+    }
+
+    [[nodiscard]] bool Overrun() const noexcept
+    {
+        return overrun;
+    }
+
+private:
+    std::span<const std::uint8_t> bytes;
+    std::size_t position{0};
+    bool overrun{false};
+};
+
+void ReadColor(BitReader &reader, std::array<std::uint8_t, 3> &color) noexcept
+{
+    for (auto &component : color)
+    {
+        component = static_cast<std::uint8_t>(reader.Read(8));
+    }
+}
+
+// Returns false once an item no longer looks like one; the rest of the stream is then unreadable
+// and the team keeps only the items before it.
+bool ReadTeam(BitReader &reader, LoadoutCode::Team &team, std::uint8_t version) noexcept
+{
+    const auto count = static_cast<std::uint8_t>(reader.Read(4));
+    // Version 4 added per-item data after the paint field whose layout is not known yet. The first
+    // item (always the body) ends before it, so that much can still be read.
+    const auto readable = version > 3 ? std::min<std::uint8_t>(count, 1) : count;
+    std::uint32_t seenSlots = 0;
+    for (team.itemCount = 0; team.itemCount < readable; ++team.itemCount)
+    {
+        auto &item = team.items[team.itemCount];
+        item.slot = static_cast<std::uint8_t>(reader.Read(5));
+        item.productId = static_cast<std::uint16_t>(reader.Read(13));
+        item.paintIndex = reader.ReadFlag() ? static_cast<std::uint8_t>(reader.Read(6)) : 0;
+
+        const auto slotBit = 1u << item.slot;
+        if (item.slot > LoadoutCode::maxSlot || (seenSlots & slotBit) != 0 || reader.Overrun())
+        {
+            item = {};
+            return false;
+        }
+        seenSlots |= slotBit;
+    }
+    if (readable < count)
+    {
+        return false;
+    }
+
+    team.overrideColors = reader.ReadFlag();
+    if (team.overrideColors)
+    {
+        ReadColor(reader, team.primaryColor);
+        ReadColor(reader, team.accentColor);
+    }
+    return !reader.Overrun();
+}
+
+struct BodyName
+{
+    std::uint16_t productId;
+    std::string_view name;
+};
+
+// Sorted by product id for binary search.
+constexpr std::array<BodyName, 23> builtInBodies{{
+    {21, "Backfire"},
+    {22, "Breakout"},
+    {23, "Octane"},
+    {24, "Paladin"},
+    {25, "Road Hog"},
+    {26, "Gizmo"},
+    {27, "Sweet Tooth"},
+    {30, "Merc"},
+    {31, "Venom"},
+    {402, "Takumi"},
+    {403, "Dominus"},
+    {404, "Scarab"},
+    {523, "Zippy"},
+    {597, "DeLorean Time Machine"},
+    {600, "Ripper"},
+    {607, "Grog"},
+    {625, "Armadillo"},
+    {723, "Hogsticker"},
+    {803, "'16 Batmobile"},
+    {1018, "Dominus GT"},
+    {1416, "Breakout Type-S"},
+    {1568, "Octane ZSR"},
+    {4284, "Fennec"},
+}};
+} // namespace
+
+namespace LoadoutCode
+{
+const Item *Team::Find(Slot slot) const noexcept
+{
+    const auto begin = items.begin();
+    const auto end = begin + itemCount;
+    const auto it = std::find_if(begin, end, [slot](const Item &item)
+                                 {
+                                     return item.slot == static_cast<std::uint8_t>(slot);
+                                 });
+    return it == end ? nullptr : &*it;
+}
+
+bool Loadout::Contains(std::uint16_t productId) const noexcept
+{
+    const auto contains = [productId](const Team &team)
+    {
+        return std::any_of(team.items.begin(), team.items.begin() + team.itemCount, [productId](const Item &item)
+                           {
+                               return item.productId == productId;
+                           });
+    };
+    return contains(blue) || (!blueIsOrange && contains(orange));
+}
+
+Loadout Decode(std::string_view code) noexcept
+{
+    std::array<std::uint8_t, maxCodeBytes> buffer{};
+    const auto byteCount = DecodeBase64(code, buffer);
+    if (!byteCount)
+    {
+        return {};
+    }
+    return DecodeBytes({buffer.data(), *byteCount});
+}
+
+Loadout DecodeBytes(std::span<const std::uint8_t> bytes) noexcept
+{
+    if (bytes.size() < 3)
+    {
+        return {};
+    }
+
+    BitReader reader(bytes);
+    Loadout loadout;
+    loadout.version = static_cast<std::uint8_t>(reader.Read(6));
+    reader.Read(10); // Size in bytes; the base64 length already bounds the stream.
+    reader.Read(8);  // CRC over the body.
+
+    // Versions 1 and 2 stored colours in a different layout that nothing exports any more.
+    if (loadout.version < 3)
+    {
+        return {};
+    }
+
+    loadout.blueIsOrange = reader.ReadFlag();
+    loadout.complete = ReadTeam(reader, loadout.blue, loadout.version);
+    if (!loadout.blueIsOrange && loadout.complete)
+    {
+        loadout.complete = ReadTeam(reader, loadout.orange, loadout.version);
+    }
+    else if (!loadout.blueIsOrange)
+    {
+        // Nothing after a broken blue team can be located, so the orange side stays empty.
+        loadout.blueIsOrange = true;
+    }
+    if (loadout.blueIsOrange)
+    {
+        loadout.orange = loadout.blue;
+    }
+
+    // The body is the first item of every code, so a truncated decode is still worth keeping.
+    loadout.valid = loadout.blue.itemCount > 0;
+    return loadout.valid ? loadout : Loadout{};
+}
+
+std::optional<std::size_t> DecodeBase64(std::string_view text, std::span<std::uint8_t> output) noexcept
+{
+    std::size_t written = 0;
+    std::uint32_t accumulator = 0;
+    std::size_t sextets = 0;
+    bool padded = false;
+
+    for (const char c : text)
+    {
+        const auto value = base64Table[static_cast<unsigned char>(c)];
+        if (value == paddingSextet)
+        {
+            padded = true;
+            continue;
+        }
+        if (value == invalidSextet || padded)
+        {
+            return std::nullopt;
+        }
+
+        accumulator = accumulator << 6 | static_cast<std::uint32_t>(value);
+        if (++sextets == 4)
+        {
+            if (written + 3 > output.size())
+            {
+                return std::nullopt;
+            }
+            output[written++] = static_cast<std::uint8_t>(accumulator >> 16);
+            output[written++] = static_cast<std::uint8_t>(accumulator >> 8);
+            output[written++] = static_cast<std::uint8_t>(accumulator);
+            accumulator = 0;
+            sextets = 0;
+        }
+    }
+
+    // A trailing group of two or three sextets carries one or two bytes; a single one is invalid.
+    if (sextets == 1)
+    {
+        return std::nullopt;
+    }
+    if (sextets > 1)
+    {
+        const auto tailBytes = sextets - 1;
+        if (written + tailBytes > output.size())
+        {
+            return std::nullopt;
+        }
+        accumulator <<= 6 * (4 - sextets);
+        output[written++] = static_cast<std::uint8_t>(accumulator >> 16);
+        if (tailBytes == 2)
+        {
+            output[written++] = static_cast<std::uint8_t>(accumulator >> 8);
+        }
+    }
+    return written;
+}
+
+void EncodeBase64(std::span<const std::uint8_t> bytes, bool padded, std::string &output)
+{
+    output.clear();
+    output.reserve((bytes.size() + 2) / 3 * 4);
+    std::size_t i = 0;
+    for (; i + 3 <= bytes.size(); i += 3)
+    {
+        const auto group = static_cast<std::uint32_t>(bytes[i]) << 16 | static_cast<std::uint32_t>(bytes[i + 1]) << 8 | bytes[i + 2];
+        output.push_back(base64Alphabet[group >> 18]);
+        output.push_back(base64Alphabet[(group >> 12) & 0x3Fu]);
+        output.push_back(base64Alphabet[(group >> 6) & 0x3Fu]);
+        output.push_back(base64Alphabet[group & 0x3Fu]);
+    }
+
+    const auto tailBytes = bytes.size() - i;
+    if (tailBytes == 0)
+    {
+        return;
+    }
+    auto group = static_cast<std::uint32_t>(bytes[i]) << 16;
+    if (tailBytes == 2)
+    {
+        group |= static_cast<std::uint32_t>(bytes[i + 1]) << 8;
+    }
+    output.push_back(base64Alphabet[group >> 18]);
+    output.push_back(base64Alphabet[(group >> 12) & 0x3Fu]);
+    if (tailBytes == 2)
+    {
+        output.push_back(base64Alphabet[(group >> 6) & 0x3Fu]);
+    }
+    if (padded)
+    {
+        output.append(3 - tailBytes, '=');
+    }
+}
+
+std::uint64_t ContentHash(const Loadout &loadout, std::string_view code) noexcept
+{
+    if (!loadout.valid || !loadout.complete)
+    {
+        return PresetBinaryCache::HashContents(code);
+    }
+
+    constexpr std::size_t teamBytes = maxItemsPerTeam * 4 + 7;
+    std::array<char, 2 * teamBytes> buffer{};
+    std::size_t size = 0;
+    const auto put = [&buffer, &size](unsigned value)
+    {
+        buffer[size++] = static_cast<char>(value);
+    };
+    for (const auto *team : {&loadout.blue, &loadout.orange})
+    {
+        auto items = team->items;
+        std::sort(items.begin(), items.begin() + team->itemCount, [](const Item &lhs, const Item &rhs)
+                  {
+                      return lhs.slot < rhs.slot;
+                  });
+        put(team->itemCount);
+        for (std::size_t i = 0; i < team->itemCount; ++i)
+        {
+            put(items[i].slot);
+            put(items[i].productId & 0xFFu);
+            put(items[i].productId >> 8);
+            put(items[i].paintIndex);
+        }
+        put(team->overrideColors);
+        if (team->overrideColors)
+        {
+            for (const auto component : team->primaryColor)
+            {
+                put(component);
+            }
+            for (const auto component : team->accentColor)
+            {
+                put(component);
+            }
+        }
+    }
+    return PresetBinaryCache::HashContents({buffer.data(), size});
+}
+
+std::string_view BuiltInBodyName(std::uint16_t productId) noexcept
+{
+    const auto it = std::lower_bound(builtInBodies.begin(), builtInBodies.end(), productId,
+                                     [](const BodyName &entry, std::uint16_t id)
+                                     {
+                                         return entry.productId < id;
+                                     });
+    return it != builtInBodies.end() && it->productId == productId ? it->name : std::string_view{};
+}
+} // namespace LoadoutCode
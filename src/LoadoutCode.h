@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+// Decoder for BakkesMod loadout codes: base64 around a bit-packed, LSB-first stream.
+//
+//   header  version:6 size:10 crc:8
+//   team    count:4, then per item slot:5 product:13 paintable:1 [paint:6]
+//           overrideColors:1 [primary r,g,b:8 each] [accent r,g,b:8 each]
+//   body    blueIsOrange:1 blueTeam [orangeTeam unless blueIsOrange]
+//
+// Version 4 appends per-item data whose layout is unknown, so only the body of those is decoded.
+// Decoding never allocates; a decoded loadout is a fixed-size value that callers can cache.
+namespace LoadoutCode
+{
+enum class Slot : std::uint8_t
+{
+    Body = 0,
+    Decal = 1,
+    Wheels = 2,
+    RocketBoost = 3,
+    Antenna = 4,
+    Topper = 5,
+    PaintFinish = 7,
+    AccentFinish = 12,
+    EngineAudio = 13,
+    Trail = 14,
+    GoalExplosion = 15,
+};
+
+// Highest slot index any known item uses; anything above it means the stream is misaligned.
+inline constexpr std::uint8_t maxSlot = 23;
+// The item count is a 4-bit field.
+inline constexpr std::size_t maxItemsPerTeam = 15;
+// The size field is 10 bits, so no valid code decodes to more bytes than this.
+inline constexpr std::size_t maxCodeBytes = 1024;
+
+struct Item
+{
+    std::uint16_t productId{0};
+    std::uint8_t slot{0};
+    // 0 when the item is unpainted.
+    std::uint8_t paintIndex{0};
+};
+
+struct Team
+{
+    std::array<Item, maxItemsPerTeam> items{};
+    std::uint8_t itemCount{0};
+    bool overrideColors{false};
+    std::array<std::uint8_t, 3> primaryColor{};
+    std::array<std::uint8_t, 3> accentColor{};
+
+    // The item equipped in `slot`, or nullptr.
+    [[nodiscard]] const Item *Find(Slot slot) const noexcept;
+};
+
+struct Loadout
+{
+    bool valid{false};
+    // False when decoding stopped early at an item it could not read (version 4 codes stop after
+    // the body); the items before that point are still correct.
+    bool complete{false};
+    std::uint8_t version{0};
+    bool blueIsOrange{true};
+    Team blue;
+    // Same as `blue` when `blueIsOrange` is set.
+    Team orange;
+
+    // True if either team equips `productId` in any slot.
+    [[nodiscard]] bool Contains(std::uint16_t productId) const noexcept;
+};
+
+// Returns a loadout with `valid` unset for anything that is not a well-formed code.
+[[nodiscard]] Loadout Decode(std::string_view code) noexcept;
+// Decode for a code whose base64 has already been stripped.
+[[nodiscard]] Loadout DecodeBytes(std::span<const std::uint8_t> bytes) noexcept;
+
+// Decodes standard or URL-safe base64 with optional padding into `output`. Returns the number of
+// bytes written, or nullopt for malformed input or when `output` is too small.
+[[nodiscard]] std::optional<std::size_t> DecodeBase64(std::string_view text, std::span<std::uint8_t> output) noexcept;
+// Standard base64 of `bytes` into `output`, with '=' padding when `padded`.
+void EncodeBase64(std::span<const std::uint8_t> bytes, bool padded, std::string &output);
+
+// Two codes that decode to the same items and colours hash alike even when their bytes differ
+// (item order, unused padding bits, the CRC). Codes that could not be decoded completely fall
+// back to hashing the text of `code`.
+[[nodiscard]] std::uint64_t ContentHash(const Loadout &loadout, std::string_view code) noexcept;
+
+// Names of the stock car bodies, or an empty view for product ids not in the built-in table.
+[[nodiscard]] std::string_view BuiltInBodyName(std::uint16_t productId) noexcept;
+} // namespace LoadoutCode
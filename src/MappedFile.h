@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+// Read-only memory mapping of a whole file. The view stays valid until the object is destroyed
+// or moved from. Empty files open successfully and expose an empty view.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path &path);
+    ~MappedFile();
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    [[nodiscard]] bool IsOpen() const noexcept { return open; }
+    [[nodiscard]] std::string_view View() const noexcept { return {data, size}; }
+    [[nodiscard]] std::size_t Size() const noexcept { return size; }
+
+    void Close() noexcept;
+
+private:
+    const char *data{nullptr};
+    std::size_t size{0};
+    bool open{false};
+#ifdef _WIN32
+    void *fileHandle{nullptr};
+    void *mappingHandle{nullptr};
+#endif
+};
@@ -0,0 +1,111 @@
+#include "PngEncoder.h"
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+namespace
+{
+constexpr std::array<std::uint32_t, 256> BuildCrcTable()
+{
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < table.size(); ++i)
+    {
+        std::uint32_t value = i;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            value = (value & 1u) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+constexpr auto crcTable = BuildCrcTable();
+
+std::uint32_t Crc32(std::string_view bytes, std::uint32_t crc = 0xFFFFFFFFu) noexcept
+{
+    for (const char c : bytes)
+    {
+        crc = crcTable[(crc ^ static_cast<unsigned char>(c)) & 0xFFu] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+void PutBigEndian(std::string &out, std::uint32_t value)
+{
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+void PutChunk(std::string &out, std::string_view type, std::string_view data)
+{
+    PutBigEndian(out, static_cast<std::uint32_t>(data.size()));
+    const auto typeStart = out.size();
+    out.append(type);
+    out.append(data);
+    // The CRC covers the chunk type and data, not the length.
+    const auto crc = Crc32(std::string_view(out).substr(typeStart)) ^ 0xFFFFFFFFu;
+    PutBigEndian(out, crc);
+}
+} // namespace
+
+namespace PngEncoder
+{
+std::string EncodeRgba(const std::uint32_t *pixels, std::size_t width, std::size_t height)
+{
+    // Each scanline is a filter-type byte (0, none) followed by the row.
+    const auto rowBytes = width * 4;
+    std::string raw;
+    raw.reserve((rowBytes + 1) * height);
+    const auto *bytes = reinterpret_cast<const char *>(pixels);
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        raw.push_back('\0');
+        raw.append(bytes + y * rowBytes, rowBytes);
+    }
+
+    // zlib stream: header, stored deflate blocks of at most 65535 bytes, Adler-32 of the raw data.
+    constexpr std::size_t maxStoredBlock = 65535;
+    std::string zlib;
+    zlib.reserve(raw.size() + raw.size() / maxStoredBlock * 5 + 16);
+    zlib.push_back('\x78');
+    zlib.push_back('\x01');
+    std::size_t offset = 0;
+    do
+    {
+        const auto length = std::min(maxStoredBlock, raw.size() - offset);
+        const bool last = offset + length == raw.size();
+        zlib.push_back(last ? '\x01' : '\x00');
+        zlib.push_back(static_cast<char>(length & 0xFFu));
+        zlib.push_back(static_cast<char>(length >> 8));
+        zlib.push_back(static_cast<char>(~length & 0xFFu));
+        zlib.push_back(static_cast<char>((~length >> 8) & 0xFFu));
+        zlib.append(raw, offset, length);
+        offset += length;
+    } while (offset < raw.size());
+
+    std::uint32_t adlerLow = 1;
+    std::uint32_t adlerHigh = 0;
+    for (const char c : raw)
+    {
+        adlerLow = (adlerLow + static_cast<unsigned char>(c)) % 65521u;
+        adlerHigh = (adlerHigh + adlerLow) % 65521u;
+    }
+    PutBigEndian(zlib, adlerHigh << 16 | adlerLow);
+
+    std::string header;
+    PutBigEndian(header, static_cast<std::uint32_t>(width));
+    PutBigEndian(header, static_cast<std::uint32_t>(height));
+    header.append({'\x08', '\x06', '\x00', '\x00', '\x00'}); // 8-bit RGBA, deflate, no filter, no interlace
+
+    std::string png("\x89PNG\r\n\x1a\n", 8);
+    png.reserve(zlib.size() + 64);
+    PutChunk(png, "IHDR", header);
+    PutChunk(png, "IDAT", zlib);
+    PutChunk(png, "IEND", {});
+    return png;
+}
+} // namespace PngEncoder
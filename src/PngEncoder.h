@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Minimal PNG writer for thumbnails the plugin generates itself: 8-bit RGBA, no filtering, and
+// stored (uncompressed) deflate blocks. Files come out roughly as large as the raw pixels, which
+// is fine for a cache and keeps the encoder free of a zlib dependency.
+namespace PngEncoder
+{
+// `pixels` holds `width * height` pixels, row-major, each with red in the low byte (IM_COL32
+// order), so the bytes in memory are already R, G, B, A.
+[[nodiscard]] std::string EncodeRgba(const std::uint32_t *pixels, std::size_t width, std::size_t height);
+} // namespace PngEncoder
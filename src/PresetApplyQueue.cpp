@@ -0,0 +1,226 @@
+#include "PresetApplyQueue.h"
+
+#include "bakkesmod/wrappers/GameWrapper.h"
+
+#include <algorithm>
+
+namespace
+{
+// Registered by BakkesMod's item mod, which provides the cl_itemmod command.
+constexpr const char *itemModCvarName = "cl_itemmod_enabled";
+} // namespace
+
+PresetApplyQueue::PresetApplyQueue(std::shared_ptr<GameWrapper> gameWrapper, std::shared_ptr<CVarManagerWrapper> cvarManager)
+    : gameWrapper(std::move(gameWrapper)),
+      cvarManager(std::move(cvarManager))
+{
+}
+
+void PresetApplyQueue::ProbeSupport()
+{
+    if (!gameWrapper || !cvarManager)
+    {
+        return;
+    }
+
+    gameWrapper->Execute([this, alive = std::weak_ptr<const bool>(aliveToken)](GameWrapper *)
+                         {
+                             if (alive.expired())
+                             {
+                                 return;
+                             }
+
+                             bool supported = false;
+                             try
+                             {
+                                 supported = !cvarManager->getCvar(itemModCvarName).IsNull();
+                             }
+                             catch (...)
+                             {
+                                 // Older SDKs throw for unknown cvars; that also means no item mod.
+                             }
+                             support = supported ? 1 : 0;
+                             if (!supported)
+                             {
+                                 cvarManager->log("ExpandedPresets: The item mod is not available; previewing or equipping a preset copies its code to the clipboard instead.");
+                             }
+                         });
+}
+
+std::optional<bool> PresetApplyQueue::IsSupported() const noexcept
+{
+    const int value = support;
+    return value < 0 ? std::nullopt : std::optional<bool>(value == 1);
+}
+
+void PresetApplyQueue::Enqueue(Request request)
+{
+    {
+        std::lock_guard lock(mutex);
+        pending = std::move(request);
+        if (flushScheduled)
+        {
+            return;
+        }
+        flushScheduled = true;
+    }
+    ScheduleFlush();
+}
+
+void PresetApplyQueue::StartCycle(std::vector<Request> requests, std::chrono::milliseconds interval)
+{
+    std::uint64_t generation = 0;
+    {
+        std::lock_guard lock(mutex);
+        cycle = std::move(requests);
+        cyclePosition = 0;
+        cycleInterval = std::max(interval, std::chrono::milliseconds(1));
+        generation = ++cycleGeneration;
+        if (cycle.empty())
+        {
+            return;
+        }
+    }
+    ScheduleCycleStep(generation, std::chrono::milliseconds::zero());
+}
+
+void PresetApplyQueue::StopCycle()
+{
+    std::lock_guard lock(mutex);
+    cycle.clear();
+    ++cycleGeneration;
+}
+
+bool PresetApplyQueue::IsCycling() const
+{
+    std::lock_guard lock(mutex);
+    return !cycle.empty();
+}
+
+void PresetApplyQueue::ScheduleFlush()
+{
+    if (!gameWrapper)
+    {
+        return;
+    }
+
+    gameWrapper->Execute([this, alive = std::weak_ptr<const bool>(aliveToken)](GameWrapper *)
+                         {
+                             if (!alive.expired())
+                             {
+                                 Flush();
+                             }
+                         });
+}
+
+void PresetApplyQueue::Flush()
+{
+    std::optional<Request> request;
+    {
+        std::lock_guard lock(mutex);
+        request.swap(pending);
+        flushScheduled = false;
+    }
+    if (request)
+    {
+        Send(*request, true);
+    }
+}
+
+void PresetApplyQueue::ScheduleCycleStep(std::uint64_t generation, std::chrono::milliseconds delay)
+{
+    if (!gameWrapper)
+    {
+        return;
+    }
+
+    const auto callback = [this, generation, alive = std::weak_ptr<const bool>(aliveToken)](GameWrapper *)
+    {
+        if (!alive.expired())
+        {
+            CycleStep(generation);
+        }
+    };
+    if (delay.count() == 0)
+    {
+        gameWrapper->Execute(callback);
+    }
+    else
+    {
+        gameWrapper->SetTimeout(callback, std::chrono::duration<float>(delay).count());
+    }
+}
+
+void PresetApplyQueue::CycleStep(std::uint64_t generation)
+{
+    Request request;
+    std::chrono::milliseconds interval{0};
+    {
+        std::lock_guard lock(mutex);
+        if (generation != cycleGeneration || cycle.empty())
+        {
+            return;
+        }
+        request = cycle[cyclePosition];
+        cyclePosition = (cyclePosition + 1) % cycle.size();
+        interval = cycleInterval;
+        // A click during the cycle would be overwritten on the next step anyway.
+        pending.reset();
+    }
+
+    request.mode = Mode::Preview;
+    Send(request, false);
+    ScheduleCycleStep(generation, interval);
+}
+
+void PresetApplyQueue::Send(const Request &request, bool announce)
+{
+    if (!cvarManager)
+    {
+        return;
+    }
+
+    if (support != 0)
+    {
+        try
+        {
+            const std::string command = request.mode == Mode::Preview ? "cl_itemmod preview " : "cl_itemmod apply ";
+            cvarManager->executeCommand(command + request.loadoutCode, false);
+        }
+        catch (...)
+        {
+            // Remember it so later requests go straight to the clipboard.
+            support = 0;
+        }
+    }
+
+    if (support == 0)
+    {
+        try
+        {
+            cvarManager->setClipboardText(request.loadoutCode);
+        }
+        catch (...)
+        {
+            // Clipboard access is optional; ignore errors so we do not crash on unsupported platforms.
+        }
+        if (announce)
+        {
+            cvarManager->log("ExpandedPresets: Copied the loadout code of '" + request.name + "' to the clipboard.");
+        }
+        return;
+    }
+
+    if (!announce)
+    {
+        return;
+    }
+    if (request.mode == Mode::Preview)
+    {
+        cvarManager->log("ExpandedPresets: Preview command triggered for preset '" + request.name + "'.");
+    }
+    else
+    {
+        cvarManager->log("ExpandedPresets: Equipped preset '" + request.name + "'.");
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "bakkesmod/plugin/bakkesmodplugin.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Sends loadout codes to the item mod (`cl_itemmod preview|apply`) from the game thread. Requests
+// made from the UI are coalesced: whatever is queued when the next game tick runs is sent, and
+// everything queued before it in the same tick is dropped, so clicking through presets never
+// backs up. Support for the command is probed once; without it the code goes to the clipboard.
+//
+// Enqueue/StartCycle/StopCycle may be called from any thread. The queue must be destroyed on the
+// game thread, which is where every callback it posts runs.
+class PresetApplyQueue
+{
+public:
+    enum class Mode
+    {
+        Preview,
+        Equip,
+    };
+
+    struct Request
+    {
+        std::string name;
+        std::string loadoutCode;
+        Mode mode{Mode::Preview};
+    };
+
+    PresetApplyQueue(std::shared_ptr<GameWrapper> gameWrapper, std::shared_ptr<CVarManagerWrapper> cvarManager);
+
+    PresetApplyQueue(const PresetApplyQueue &) = delete;
+    PresetApplyQueue &operator=(const PresetApplyQueue &) = delete;
+
+    // Checks for the item mod on the next game tick, once every plugin has loaded.
+    void ProbeSupport();
+    // nullopt until the probe has run.
+    [[nodiscard]] std::optional<bool> IsSupported() const noexcept;
+
+    // Replaces any request that has not been sent yet.
+    void Enqueue(Request request);
+
+    // Previews `requests` one after another, one every `interval`, looping until stopped.
+    void StartCycle(std::vector<Request> requests, std::chrono::milliseconds interval);
+    void StopCycle();
+    [[nodiscard]] bool IsCycling() const;
+
+private:
+    std::shared_ptr<GameWrapper> gameWrapper;
+    std::shared_ptr<CVarManagerWrapper> cvarManager;
+
+    // -1 unknown, 0 unsupported, 1 supported.
+    std::atomic<int> support{-1};
+
+    mutable std::mutex mutex;
+    std::optional<Request> pending;
+    bool flushScheduled{false};
+    std::vector<Request> cycle;
+    std::size_t cyclePosition{0};
+    std::chrono::milliseconds cycleInterval{0};
+    // Bumped by StartCycle/StopCycle so timers from an earlier cycle do nothing.
+    std::uint64_t cycleGeneration{0};
+
+    // Callbacks posted to the game thread hold a weak reference and do nothing once it expired.
+    std::shared_ptr<const bool> aliveToken{std::make_shared<const bool>(true)};
+
+    void ScheduleFlush();
+    void Flush();
+    void ScheduleCycleStep(std::uint64_t generation, std::chrono::milliseconds delay);
+    void CycleStep(std::uint64_t generation);
+    // `announce` logs the result; cycling stays quiet so the console is not flooded.
+    void Send(const Request &request, bool announce);
+};
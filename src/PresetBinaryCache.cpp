@@ -0,0 +1,288 @@
+#include "PresetBinaryCache.h"
+
+#include "MappedFile.h"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace PresetBinaryCache
+{
+namespace
+{
+static_assert(std::endian::native == std::endian::little, "The preset cache format is little endian");
+
+constexpr std::array<char, 4> cacheMagic{'E', 'P', 'B', 'C'};
+constexpr std::uint32_t cacheFormatVersion = 2;
+
+constexpr std::uint32_t flagMatte = 1u << 0;
+constexpr std::uint32_t flagPearlescent = 1u << 1;
+
+struct Header
+{
+    std::array<char, 4> magic;
+    std::uint32_t formatVersion;
+    std::uint64_t sourceSize;
+    std::int64_t sourceModifiedTime;
+    std::uint64_t sourceHash;
+    std::uint32_t recordCount;
+    std::uint32_t stringTableSize;
+    // sizeof(LoadoutCode::Loadout) when written; another build's layout cannot be read back.
+    std::uint32_t loadoutSize;
+    std::uint32_t reserved;
+};
+
+struct StringRef
+{
+    std::uint32_t offset;
+    std::uint32_t length;
+};
+
+struct Record
+{
+    StringRef name;
+    StringRef loadoutCode;
+    StringRef carLabel;
+    StringRef decalLabel;
+    StringRef wheelsLabel;
+    std::array<float, 3> primaryColor;
+    std::array<float, 3> accentColor;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+    // LoadoutCode::ContentHash of the decoded loadout.
+    std::uint64_t loadoutHash;
+};
+
+static_assert(sizeof(Header) == 48 && std::is_trivially_copyable_v<Header>);
+static_assert(sizeof(Record) == 80 && std::is_trivially_copyable_v<Record>);
+static_assert(std::is_trivially_copyable_v<LoadoutCode::Loadout>);
+
+struct StringViewHash
+{
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view text) const noexcept
+    {
+        return std::hash<std::string_view>{}(text);
+    }
+};
+
+class StringTableBuilder
+{
+public:
+    StringRef Add(std::string_view text)
+    {
+        auto it = offsets.find(text);
+        if (it == offsets.end())
+        {
+            it = offsets.emplace(std::string(text), static_cast<std::uint32_t>(table.size())).first;
+            table.append(text);
+        }
+        return {it->second, static_cast<std::uint32_t>(text.size())};
+    }
+
+    [[nodiscard]] const std::string &Table() const noexcept { return table; }
+
+private:
+    std::string table;
+    std::unordered_map<std::string, std::uint32_t, StringViewHash, std::equal_to<>> offsets;
+};
+
+std::string_view Resolve(std::string_view table, const StringRef &ref, bool &valid) noexcept
+{
+    if (ref.offset > table.size() || ref.length > table.size() - ref.offset)
+    {
+        valid = false;
+        return {};
+    }
+    return table.substr(ref.offset, ref.length);
+}
+} // namespace
+
+std::uint64_t HashContents(std::string_view contents) noexcept
+{
+    // FNV-1a; good enough to detect edits to a file whose size and mtime already matched.
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const char c : contents)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::optional<SourceStamp> StatSource(const std::filesystem::path &sourcePath)
+{
+    std::error_code error;
+    const auto size = std::filesystem::file_size(sourcePath, error);
+    if (error)
+    {
+        return std::nullopt;
+    }
+    const auto modified = std::filesystem::last_write_time(sourcePath, error);
+    if (error)
+    {
+        return std::nullopt;
+    }
+
+    SourceStamp stamp;
+    stamp.size = static_cast<std::uint64_t>(size);
+    stamp.modifiedTime = static_cast<std::int64_t>(modified.time_since_epoch().count());
+    return stamp;
+}
+
+std::filesystem::path CachePathFor(const std::filesystem::path &storageFilePath)
+{
+    auto cachePath = storageFilePath;
+    cachePath.replace_extension(".bin");
+    return cachePath;
+}
+
+bool Write(const std::filesystem::path &cachePath,
+           const PresetSnapshot &presets,
+           const PresetLabelPool &labels,
+           const SourceStamp &source)
+{
+    StringTableBuilder strings;
+    std::vector<Record> records;
+    std::vector<LoadoutCode::Loadout> loadouts;
+    records.reserve(presets.Size());
+    loadouts.reserve(presets.Size());
+    presets.ForEach([&strings, &records, &loadouts, &labels](const CustomPreset &preset)
+                    {
+                        const auto &customization = preset.customization;
+                        Record record{};
+                        record.name = strings.Add(preset.name);
+                        record.loadoutCode = strings.Add(preset.loadoutCode);
+                        record.carLabel = strings.Add(labels.Resolve(customization.carLabel));
+                        record.decalLabel = strings.Add(labels.Resolve(customization.decalLabel));
+                        record.wheelsLabel = strings.Add(labels.Resolve(customization.wheelsLabel));
+                        record.primaryColor = {customization.primaryColor.r, customization.primaryColor.g, customization.primaryColor.b};
+                        record.accentColor = {customization.accentColor.r, customization.accentColor.g, customization.accentColor.b};
+                        record.flags = (customization.paintFinishMatte ? flagMatte : 0u) |
+                                       (customization.paintFinishPearlescent ? flagPearlescent : 0u);
+                        // Decoded and hashed here on the writer thread so that loading does not have to.
+                        const auto &loadout = loadouts.emplace_back(LoadoutCode::Decode(preset.loadoutCode));
+                        record.loadoutHash = LoadoutCode::ContentHash(loadout, preset.loadoutCode);
+                        records.push_back(record);
+                    });
+
+    Header header{};
+    header.magic = cacheMagic;
+    header.formatVersion = cacheFormatVersion;
+    header.sourceSize = source.size;
+    header.sourceModifiedTime = source.modifiedTime;
+    header.sourceHash = source.contentHash;
+    header.recordCount = static_cast<std::uint32_t>(records.size());
+    header.stringTableSize = static_cast<std::uint32_t>(strings.Table().size());
+    header.loadoutSize = sizeof(LoadoutCode::Loadout);
+
+    auto temporaryPath = cachePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record)));
+        file.write(reinterpret_cast<const char *>(loadouts.data()),
+                   static_cast<std::streamsize>(loadouts.size() * sizeof(LoadoutCode::Loadout)));
+        file.write(strings.Table().data(), static_cast<std::streamsize>(strings.Table().size()));
+        if (!file.flush())
+        {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    if (error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+std::optional<CachedPresets> Load(const std::filesystem::path &cachePath,
+                                  const SourceStamp &source,
+                                  const std::function<std::uint64_t()> &hashSource,
+                                  PresetLabelPool &labels,
+                                  std::pmr::memory_resource *strings)
+{
+    const MappedFile file(cachePath);
+    const auto contents = file.View();
+    if (contents.size() < sizeof(Header))
+    {
+        return std::nullopt;
+    }
+
+    Header header{};
+    std::memcpy(&header, contents.data(), sizeof(header));
+    if (header.magic != cacheMagic || header.formatVersion != cacheFormatVersion ||
+        header.loadoutSize != sizeof(LoadoutCode::Loadout) || header.sourceSize != source.size)
+    {
+        return std::nullopt;
+    }
+
+    const auto recordBytes = static_cast<std::uint64_t>(header.recordCount) * sizeof(Record);
+    const auto loadoutBytes = static_cast<std::uint64_t>(header.recordCount) * sizeof(LoadoutCode::Loadout);
+    if (contents.size() != sizeof(Header) + recordBytes + loadoutBytes + header.stringTableSize)
+    {
+        return std::nullopt;
+    }
+
+    // Same size and time is taken as unchanged; hashing the cfg would cost as much as a good part
+    // of the load. A cfg that was only touched or copied still matches its hash.
+    if (header.sourceModifiedTime != source.modifiedTime && header.sourceHash != hashSource())
+    {
+        return std::nullopt;
+    }
+
+    const auto *recordData = contents.data() + sizeof(Header);
+    const auto *loadoutData = recordData + recordBytes;
+    const auto table = contents.substr(sizeof(Header) + recordBytes + loadoutBytes);
+
+    CachedPresets cached;
+    cached.loadouts.resize(header.recordCount);
+    std::memcpy(cached.loadouts.data(), loadoutData, loadoutBytes);
+    cached.loadoutHashes.reserve(header.recordCount);
+
+    // A damaged cache falls back to the text path instead of producing a partial library.
+    bool valid = true;
+    auto &presets = cached.presets;
+    presets.reserve(header.recordCount);
+    for (std::uint32_t i = 0; i < header.recordCount; ++i)
+    {
+        Record record{};
+        std::memcpy(&record, recordData + i * sizeof(Record), sizeof(Record));
+
+        CustomPreset preset{PresetString(Resolve(table, record.name, valid), strings),
+                            PresetString(Resolve(table, record.loadoutCode, valid), strings)};
+        auto &customization = preset.customization;
+        customization.carLabel = labels.Intern(Resolve(table, record.carLabel, valid), defaultCarLabelId);
+        customization.decalLabel = labels.Intern(Resolve(table, record.decalLabel, valid), defaultDecalLabelId);
+        customization.wheelsLabel = labels.Intern(Resolve(table, record.wheelsLabel, valid), defaultWheelsLabelId);
+        customization.primaryColor = {record.primaryColor[0], record.primaryColor[1], record.primaryColor[2]};
+        customization.accentColor = {record.accentColor[0], record.accentColor[1], record.accentColor[2]};
+        customization.paintFinishMatte = (record.flags & flagMatte) != 0;
+        customization.paintFinishPearlescent = (record.flags & flagPearlescent) != 0;
+        if (!valid)
+        {
+            return std::nullopt;
+        }
+        presets.push_back(std::move(preset));
+        cached.loadoutHashes.push_back(record.loadoutHash);
+    }
+    return cached;
+}
+} // namespace PresetBinaryCache
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "LoadoutCode.h"
+#include "PresetLabelPool.h"
+#include "PresetSnapshot.h"
+#include "PresetTypes.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Binary snapshot of expanded_presets.cfg used to skip text parsing and loadout decoding at
+// startup. The cfg stays the source of truth: a cache is only used while the cfg still has the
+// size and modification time it was written for or, when only the time differs, the same
+// content hash.
+//
+// Layout (little endian):
+//   Header                              magic, format version, source stamp, section sizes
+//   Record[recordCount]                 fixed-size records referencing the string table
+//   LoadoutCode::Loadout[recordCount]   each record's decoded loadout code, as laid out in memory
+//   char[stringTableSize]               deduplicated, unterminated strings
+namespace PresetBinaryCache
+{
+struct SourceStamp
+{
+    std::uint64_t size{0};
+    std::int64_t modifiedTime{0};
+    std::uint64_t contentHash{0};
+
+    [[nodiscard]] bool operator==(const SourceStamp &other) const noexcept = default;
+};
+
+[[nodiscard]] std::uint64_t HashContents(std::string_view contents) noexcept;
+
+// Reads the size and modification time of `sourcePath`; the content hash is left at zero.
+[[nodiscard]] std::optional<SourceStamp> StatSource(const std::filesystem::path &sourcePath);
+
+[[nodiscard]] std::filesystem::path CachePathFor(const std::filesystem::path &storageFilePath);
+
+bool Write(const std::filesystem::path &cachePath,
+           const PresetSnapshot &presets,
+           const PresetLabelPool &labels,
+           const SourceStamp &source);
+
+struct CachedPresets
+{
+    CustomPresetCollection presets;
+    // Parallel to `presets`: each decoded loadout code and its LoadoutCode::ContentHash.
+    std::vector<LoadoutCode::Loadout> loadouts;
+    std::vector<std::uint64_t> loadoutHashes;
+};
+
+// Returns the cached records when the cache exists, is well formed and was written for `source`.
+// `hashSource` is only invoked when the sizes match but the modification times do not. Labels
+// are interned into `labels`, which is why this must run on the thread that owns the pool. Names
+// and loadout codes are allocated from `strings`.
+[[nodiscard]] std::optional<CachedPresets> Load(const std::filesystem::path &cachePath,
+                                                const SourceStamp &source,
+                                                const std::function<std::uint64_t()> &hashSource,
+                                                PresetLabelPool &labels,
+                                                std::pmr::memory_resource *strings);
+} // namespace PresetBinaryCache
@@ -0,0 +1,218 @@
+#include "PresetCatalogImporter.h"
+
+#include "PresetSerialization.h"
+
+#include <algorithm>
+#include <numeric>
+
+PresetCatalogImporter::PresetCatalogImporter(std::filesystem::path catalogPath)
+    : paths{std::move(catalogPath)}
+{
+}
+
+PresetCatalogImporter::PresetCatalogImporter(std::vector<std::filesystem::path> paths)
+    : paths(std::move(paths))
+{
+}
+
+PresetCatalogImporter::~PresetCatalogImporter()
+{
+    cancelled.store(true);
+    Wait();
+}
+
+bool PresetCatalogImporter::Start(PresetWorkerPool *pool, CompletionCallback onComplete)
+{
+    files.reserve(paths.size());
+    for (const auto &path : paths)
+    {
+        auto &file = files.emplace_back(path);
+        if (!file.IsOpen())
+        {
+            files.clear();
+            return false;
+        }
+        totalBytes += file.Size();
+    }
+
+    this->onComplete = std::move(onComplete);
+    startTime = std::chrono::steady_clock::now();
+
+    const auto poolThreads = pool ? pool->GetThreadCount() : 0;
+    const auto workerBudget = std::clamp<std::size_t>(poolThreads, 1, maxWorkers);
+    SplitIntoChunks(workerBudget);
+
+    chunks.resize(chunkViews.size());
+    rejectedLines.assign(chunkViews.size(), 0);
+    chunkArenas.clear();
+    for (const auto view : chunkViews)
+    {
+        // The strings of a chunk never need more than its text, so this is a single block.
+        chunkArenas.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>(view.size() + 64));
+    }
+
+    const auto workerCount = std::min(workerBudget, std::max<std::size_t>(chunkViews.size(), 1));
+    runningWorkers.store(workerCount);
+    {
+        std::lock_guard lock(doneMutex);
+        unfinishedWorkers = workerCount;
+    }
+    for (std::size_t i = 0; i < workerCount; ++i)
+    {
+        if (pool)
+        {
+            pool->Submit([this]
+                         {
+                             RunWorker();
+                         });
+        }
+        else
+        {
+            RunWorker();
+        }
+    }
+    return true;
+}
+
+void PresetCatalogImporter::Wait()
+{
+    std::unique_lock lock(doneMutex);
+    workersDone.wait(lock, [this]
+                     {
+                         return unfinishedWorkers == 0;
+                     });
+}
+
+float PresetCatalogImporter::Progress() const noexcept
+{
+    if (finished.load(std::memory_order_acquire))
+    {
+        return 1.0f;
+    }
+    if (totalBytes == 0)
+    {
+        return 0.0f;
+    }
+
+    return static_cast<float>(parsedBytes.load(std::memory_order_relaxed)) / static_cast<float>(totalBytes);
+}
+
+bool PresetCatalogImporter::IsFinished() const noexcept
+{
+    return finished.load(std::memory_order_acquire);
+}
+
+std::vector<std::vector<PresetCatalogImporter::Entry>> &PresetCatalogImporter::Chunks() noexcept
+{
+    return chunks;
+}
+
+std::size_t PresetCatalogImporter::EntryCount() const noexcept
+{
+    return std::accumulate(chunks.begin(), chunks.end(), std::size_t{0},
+                           [](std::size_t total, const std::vector<Entry> &chunk)
+                           {
+                               return total + chunk.size();
+                           });
+}
+
+std::size_t PresetCatalogImporter::RejectedLineCount() const noexcept
+{
+    return std::accumulate(rejectedLines.begin(), rejectedLines.end(), std::size_t{0});
+}
+
+std::chrono::milliseconds PresetCatalogImporter::ParseDuration() const noexcept
+{
+    return parseDuration;
+}
+
+const std::filesystem::path &PresetCatalogImporter::GetPath() const noexcept
+{
+    return paths.front();
+}
+
+std::string_view PresetCatalogImporter::Contents() const noexcept
+{
+    return files.empty() ? std::string_view{} : files.front().View();
+}
+
+void PresetCatalogImporter::SplitIntoChunks(std::size_t workerCount)
+{
+    // A few chunks per worker keeps them all busy when some chunks parse slower than others.
+    // Chunks never span files, so small files simply become one chunk each.
+    const auto targetChunkBytes = std::max(minChunkBytes, totalBytes / (workerCount * 4) + 1);
+
+    for (const auto &file : files)
+    {
+        auto remaining = file.View();
+        while (!remaining.empty())
+        {
+            auto end = std::min(targetChunkBytes, remaining.size());
+            if (end < remaining.size())
+            {
+                const auto newline = remaining.find('\n', end);
+                end = newline == std::string_view::npos ? remaining.size() : newline + 1;
+            }
+            chunkViews.push_back(remaining.substr(0, end));
+            remaining.remove_prefix(end);
+        }
+    }
+}
+
+void PresetCatalogImporter::RunWorker()
+{
+    for (auto chunkIndex = nextChunk.fetch_add(1); chunkIndex < chunkViews.size() && !cancelled.load();
+         chunkIndex = nextChunk.fetch_add(1))
+    {
+        ParseChunk(chunkIndex);
+    }
+
+    if (runningWorkers.fetch_sub(1) == 1 && !cancelled.load())
+    {
+        parseDuration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+        finished.store(true, std::memory_order_release);
+        if (onComplete)
+        {
+            onComplete();
+        }
+    }
+
+    // Notified under the lock: once Wait() can return, this task no longer touches the importer.
+    std::lock_guard lock(doneMutex);
+    if (--unfinishedWorkers == 0)
+    {
+        workersDone.notify_all();
+    }
+}
+
+void PresetCatalogImporter::ParseChunk(std::size_t chunkIndex)
+{
+    const auto view = chunkViews[chunkIndex];
+    auto &entries = chunks[chunkIndex];
+    auto *arena = chunkArenas[chunkIndex].get();
+    // Catalog lines are roughly 100-150 bytes; over-reserving a little beats regrowing.
+    entries.reserve(view.size() / 96 + 1);
+
+    PresetSerialization::PresetLineFields fields;
+    PresetSerialization::ForEachLine(view, [this, chunkIndex, arena, &entries, &fields](std::string_view line)
+                                     {
+                                         if (!PresetSerialization::ParsePresetLine(line, fields) ||
+                                             fields.name.empty() || fields.loadoutCode.empty())
+                                         {
+                                             ++rejectedLines[chunkIndex];
+                                             return;
+                                         }
+
+                                         auto &entry = entries.emplace_back(Entry{CustomPreset{PresetString(fields.name, arena),
+                                                                                               PresetString(fields.loadoutCode, arena)},
+                                                                                  fields.carLabel, fields.decalLabel,
+                                                                                  fields.wheelsLabel});
+                                         auto &customization = entry.preset.customization;
+                                         customization.primaryColor = fields.primaryColor;
+                                         customization.accentColor = fields.accentColor;
+                                         customization.paintFinishMatte = fields.paintFinishMatte;
+                                         customization.paintFinishPearlescent = fields.paintFinishPearlescent;
+                                     });
+
+    parsedBytes.fetch_add(view.size(), std::memory_order_relaxed);
+}
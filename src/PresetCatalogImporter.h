@@ -0,0 +1,104 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "PresetTypes.h"
+#include "PresetWorkerPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Parses a file in the expanded_presets.cfg line format on the PresetWorkerPool: preset catalogs
+// such as bakkesplugins_cars.cfg, expanded_presets.cfg itself after an external edit, and the
+// storage shards (see PresetShards) at load. Each file is mapped and split into newline-aligned
+// chunks, and each worker task pulls chunks until none are left. Workers build complete
+// CustomPresets except for the labels: the label pool only accepts one writer, so labels stay as
+// views into the mapped file and are interned when the caller merges the entries on its own
+// thread. Each chunk allocates its strings from its own monotonic arena, freed with the importer.
+class PresetCatalogImporter
+{
+public:
+    struct Entry
+    {
+        // Labels are left at their defaults; the views below hold the parsed text.
+        CustomPreset preset;
+        std::string_view carLabel;
+        std::string_view decalLabel;
+        std::string_view wheelsLabel;
+    };
+
+    // Invoked once by the last worker task to finish, unless the import was cancelled.
+    using CompletionCallback = std::function<void()>;
+
+    explicit PresetCatalogImporter(std::filesystem::path catalogPath);
+    // Parses several files as one import; entries keep the order of `paths`.
+    explicit PresetCatalogImporter(std::vector<std::filesystem::path> paths);
+    // Cancels outstanding chunks and waits for the worker tasks.
+    ~PresetCatalogImporter();
+
+    PresetCatalogImporter(const PresetCatalogImporter &) = delete;
+    PresetCatalogImporter &operator=(const PresetCatalogImporter &) = delete;
+
+    // Maps the files and queues one worker task per pool thread (at most maxWorkers). Without a
+    // running pool the whole file is parsed on the calling thread before Start returns. Returns
+    // false if any file could not be opened.
+    bool Start(PresetWorkerPool *pool, CompletionCallback onComplete);
+    // Blocks until every worker task has finished, for callers that parse synchronously. Must not
+    // be called from a task of the same pool.
+    void Wait();
+
+    // Fraction of the file parsed so far, 0-1.
+    [[nodiscard]] float Progress() const noexcept;
+    [[nodiscard]] bool IsFinished() const noexcept;
+
+    // Parsed entries in file order, grouped by chunk. Only valid once IsFinished() returns true;
+    // callers may move the presets out, but their strings, like the label views, only stay valid
+    // for the lifetime of the importer (PresetManager copies them into its own arena).
+    [[nodiscard]] std::vector<std::vector<Entry>> &Chunks() noexcept;
+    [[nodiscard]] std::size_t EntryCount() const noexcept;
+    [[nodiscard]] std::size_t RejectedLineCount() const noexcept;
+    [[nodiscard]] std::chrono::milliseconds ParseDuration() const noexcept;
+    // The first (usually only) file.
+    [[nodiscard]] const std::filesystem::path &GetPath() const noexcept;
+    // The mapped contents of the first file.
+    [[nodiscard]] std::string_view Contents() const noexcept;
+
+private:
+    // Chunks smaller than this are not worth a hand-off between threads.
+    static constexpr std::size_t minChunkBytes = 256 * 1024;
+    static constexpr std::size_t maxWorkers = 8;
+
+    std::vector<std::filesystem::path> paths;
+    std::vector<MappedFile> files;
+    std::size_t totalBytes{0};
+    std::vector<std::string_view> chunkViews;
+    // Declared before `chunks` so the entries are destroyed before the memory behind their strings.
+    std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>> chunkArenas;
+    std::vector<std::vector<Entry>> chunks;
+    std::vector<std::size_t> rejectedLines;
+    CompletionCallback onComplete;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::milliseconds parseDuration{0};
+
+    std::atomic<std::size_t> nextChunk{0};
+    std::atomic<std::size_t> parsedBytes{0};
+    std::atomic<std::size_t> runningWorkers{0};
+    std::atomic<bool> finished{false};
+    std::atomic<bool> cancelled{false};
+
+    std::mutex doneMutex;
+    std::condition_variable workersDone;
+    std::size_t unfinishedWorkers{0};
+
+    void SplitIntoChunks(std::size_t workerCount);
+    void RunWorker();
+    void ParseChunk(std::size_t chunkIndex);
+};
@@ -0,0 +1,272 @@
+#include "PresetColorIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+bool CloserFirst(const PresetColorIndex::Neighbor &lhs, const PresetColorIndex::Neighbor &rhs) noexcept
+{
+    return lhs.distance < rhs.distance;
+}
+} // namespace
+
+void PresetColorIndex::Clear()
+{
+    points.clear();
+    cellOfSlot.clear();
+    bucketPositions.clear();
+    for (auto &bucket : cells)
+    {
+        bucket.clear();
+    }
+}
+
+void PresetColorIndex::Reserve(std::size_t count)
+{
+    points.reserve(count);
+    cellOfSlot.reserve(count);
+    bucketPositions.reserve(count);
+}
+
+void PresetColorIndex::Assign(std::size_t slot, const CustomPreset &preset)
+{
+    if (cells.empty())
+    {
+        cells.resize(cellCount);
+    }
+
+    const auto point = ToPoint(preset.customization.primaryColor, preset.customization.accentColor);
+    const auto cell = CellIndex(CellOf(point));
+    if (slot >= points.size())
+    {
+        points.push_back(point);
+        cellOfSlot.push_back(cell);
+        bucketPositions.push_back(0);
+        AddToCell(slot, cell);
+        return;
+    }
+
+    points[slot] = point;
+    if (cellOfSlot[slot] != cell)
+    {
+        RemoveFromCell(slot);
+        AddToCell(slot, cell);
+    }
+}
+
+void PresetColorIndex::SwapRemove(std::size_t slot)
+{
+    if (slot >= points.size())
+    {
+        return;
+    }
+
+    RemoveFromCell(slot);
+    const auto last = points.size() - 1;
+    if (slot != last)
+    {
+        // The last slot keeps its cell and bucket position; only the slot number it goes by changes.
+        points[slot] = points[last];
+        cellOfSlot[slot] = cellOfSlot[last];
+        bucketPositions[slot] = bucketPositions[last];
+        cells[cellOfSlot[slot]][bucketPositions[slot]] = static_cast<std::uint32_t>(slot);
+    }
+    points.pop_back();
+    cellOfSlot.pop_back();
+    bucketPositions.pop_back();
+}
+
+std::vector<PresetColorIndex::Neighbor> PresetColorIndex::FindNearest(const PresetPaintColor &primary, const PresetPaintColor &accent,
+                                                                      std::size_t count, std::size_t excludedSlot) const
+{
+    std::vector<Neighbor> nearest;
+    if (count == 0 || points.empty())
+    {
+        return nearest;
+    }
+    nearest.reserve(count + 1);
+
+    const auto query = ToPoint(primary, accent);
+    const auto center = CellOf(query);
+    constexpr float cellWidth = 1.0f / cellsPerAxis;
+
+    // `nearest` is a max-heap on squared distance until the end.
+    const auto consider = [this, &nearest, &query, count, excludedSlot](std::size_t slot)
+    {
+        if (slot == excludedSlot)
+        {
+            return;
+        }
+        const auto &point = points[slot];
+        float distance = 0.0f;
+        for (std::size_t axis = 0; axis < dimensions; ++axis)
+        {
+            const auto delta = point[axis] - query[axis];
+            distance += delta * delta;
+        }
+        if (nearest.size() == count && distance >= nearest.front().distance)
+        {
+            return;
+        }
+        nearest.push_back({slot, distance});
+        std::push_heap(nearest.begin(), nearest.end(), CloserFirst);
+        if (nearest.size() > count)
+        {
+            std::pop_heap(nearest.begin(), nearest.end(), CloserFirst);
+            nearest.pop_back();
+        }
+    };
+
+    // Walking the grid costs more than checking every point until there are more points than cells.
+    const bool scanAll = points.size() <= cellCount;
+    if (scanAll)
+    {
+        for (std::size_t slot = 0; slot < points.size(); ++slot)
+        {
+            consider(slot);
+        }
+    }
+
+    for (int radius = 0; !scanAll && radius < cellsPerAxis; ++radius)
+    {
+        // Walk the box of cells within `radius` of the centre, clipped to the grid, and visit
+        // the shell of cells exactly `radius` away (the inner ones were visited before) unless
+        // the whole cell is further away than the worst match so far.
+        CellCoordinates low{};
+        CellCoordinates high{};
+        for (std::size_t axis = 0; axis < dimensions; ++axis)
+        {
+            low[axis] = std::max(center[axis] - radius, 0);
+            high[axis] = std::min(center[axis] + radius, cellsPerAxis - 1);
+        }
+        auto coordinates = low;
+        while (true)
+        {
+            int shell = 0;
+            for (std::size_t axis = 0; axis < dimensions; ++axis)
+            {
+                shell = std::max(shell, std::abs(coordinates[axis] - center[axis]));
+            }
+            if (shell == radius)
+            {
+                const auto cell = CellIndex(coordinates);
+                if (!cells[cell].empty() && (nearest.size() < count || CellDistance(coordinates, query) < nearest.front().distance))
+                {
+                    for (const auto slot : cells[cell])
+                    {
+                        consider(slot);
+                    }
+                }
+            }
+
+            std::size_t axis = 0;
+            while (axis < dimensions && coordinates[axis] == high[axis])
+            {
+                coordinates[axis] = low[axis];
+                ++axis;
+            }
+            if (axis == dimensions)
+            {
+                break;
+            }
+            ++coordinates[axis];
+        }
+
+        if (nearest.size() < count)
+        {
+            continue;
+        }
+        // Anything outside the box is at least as far as the nearest face that is not the edge
+        // of the grid; once that beats the worst match so far, no later shell can improve on it.
+        auto bound = std::numeric_limits<float>::max();
+        for (std::size_t axis = 0; axis < dimensions; ++axis)
+        {
+            if (low[axis] > 0)
+            {
+                bound = std::min(bound, query[axis] - static_cast<float>(low[axis]) * cellWidth);
+            }
+            if (high[axis] < cellsPerAxis - 1)
+            {
+                bound = std::min(bound, static_cast<float>(high[axis] + 1) * cellWidth - query[axis]);
+            }
+        }
+        if (bound == std::numeric_limits<float>::max() || bound * bound >= nearest.front().distance)
+        {
+            break;
+        }
+    }
+
+    std::sort_heap(nearest.begin(), nearest.end(), CloserFirst);
+    for (auto &neighbor : nearest)
+    {
+        neighbor.distance = std::sqrt(neighbor.distance);
+    }
+    return nearest;
+}
+
+float PresetColorIndex::CellDistance(const CellCoordinates &coordinates, const Point &point) noexcept
+{
+    constexpr float cellWidth = 1.0f / cellsPerAxis;
+    float distance = 0.0f;
+    for (std::size_t axis = 0; axis < dimensions; ++axis)
+    {
+        // Edge cells also hold the out-of-range components, so they are open towards the outside.
+        float delta = 0.0f;
+        if (const auto low = static_cast<float>(coordinates[axis]) * cellWidth; coordinates[axis] > 0 && point[axis] < low)
+        {
+            delta = low - point[axis];
+        }
+        else if (const auto high = static_cast<float>(coordinates[axis] + 1) * cellWidth; coordinates[axis] < cellsPerAxis - 1 && point[axis] > high)
+        {
+            delta = point[axis] - high;
+        }
+        distance += delta * delta;
+    }
+    return distance;
+}
+
+PresetColorIndex::Point PresetColorIndex::ToPoint(const PresetPaintColor &primary, const PresetPaintColor &accent) noexcept
+{
+    return {primary.r, primary.g, primary.b, accent.r, accent.g, accent.b};
+}
+
+PresetColorIndex::CellCoordinates PresetColorIndex::CellOf(const Point &point) noexcept
+{
+    CellCoordinates coordinates{};
+    for (std::size_t axis = 0; axis < dimensions; ++axis)
+    {
+        // Out-of-range components land in the edge cells, which the search bound accounts for.
+        const auto scaled = std::clamp(point[axis], 0.0f, 1.0f) * cellsPerAxis;
+        coordinates[axis] = std::min(static_cast<int>(scaled), cellsPerAxis - 1);
+    }
+    return coordinates;
+}
+
+std::uint32_t PresetColorIndex::CellIndex(const CellCoordinates &coordinates) noexcept
+{
+    std::uint32_t index = 0;
+    for (auto axis = dimensions; axis-- > 0;)
+    {
+        index = index * cellsPerAxis + static_cast<std::uint32_t>(coordinates[axis]);
+    }
+    return index;
+}
+
+void PresetColorIndex::AddToCell(std::size_t slot, std::uint32_t cell)
+{
+    auto &bucket = cells[cell];
+    cellOfSlot[slot] = cell;
+    bucketPositions[slot] = static_cast<std::uint32_t>(bucket.size());
+    bucket.push_back(static_cast<std::uint32_t>(slot));
+}
+
+void PresetColorIndex::RemoveFromCell(std::size_t slot)
+{
+    auto &bucket = cells[cellOfSlot[slot]];
+    const auto position = bucketPositions[slot];
+    const auto moved = bucket.back();
+    bucket[position] = moved;
+    bucketPositions[moved] = position;
+    bucket.pop_back();
+}
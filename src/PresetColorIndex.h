@@ -0,0 +1,67 @@
+#pragma once
+
+#include "PresetTypes.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Nearest-neighbour search over paint colours: each slot is a point in the 6-D space of its
+// primary and accent RGB, bucketed into a uniform grid, and distances are Euclidean over both
+// colours. A lookup scans the cells in growing shells around the query and stops once no
+// unvisited cell can hold anything closer than what it already has, so its cost follows how
+// crowded that region of colour space is rather than the size of the library. Slots mirror the
+// positions in PresetManager's collection and are updated in place on every edit.
+class PresetColorIndex
+{
+public:
+    struct Neighbor
+    {
+        std::size_t slot;
+        float distance;
+    };
+
+    static constexpr std::size_t noSlot = std::numeric_limits<std::size_t>::max();
+
+    void Clear();
+    void Reserve(std::size_t count);
+
+    // Keeps `slot` in sync with `preset`'s colours; `slot` may be one past the end to append.
+    void Assign(std::size_t slot, const CustomPreset &preset);
+    // Moves the last slot into `slot` and drops the last one, matching PresetManager's removals.
+    void SwapRemove(std::size_t slot);
+
+    [[nodiscard]] std::size_t Size() const noexcept
+    {
+        return points.size();
+    }
+
+    // Up to `count` slots closest to the given colours, nearest first, skipping `excludedSlot`.
+    [[nodiscard]] std::vector<Neighbor> FindNearest(const PresetPaintColor &primary, const PresetPaintColor &accent,
+                                                    std::size_t count, std::size_t excludedSlot = noSlot) const;
+
+private:
+    static constexpr std::size_t dimensions = 6;
+    static constexpr int cellsPerAxis = 4;
+    static constexpr std::size_t cellCount = 4096; // cellsPerAxis ^ dimensions
+
+    using Point = std::array<float, dimensions>;
+    using CellCoordinates = std::array<int, dimensions>;
+
+    std::vector<Point> points;
+    // Cell of each slot and its position in that cell's bucket, for constant-time moves.
+    std::vector<std::uint32_t> cellOfSlot;
+    std::vector<std::uint32_t> bucketPositions;
+    // Sized to cellCount on the first Assign.
+    std::vector<std::vector<std::uint32_t>> cells;
+
+    [[nodiscard]] static Point ToPoint(const PresetPaintColor &primary, const PresetPaintColor &accent) noexcept;
+    [[nodiscard]] static CellCoordinates CellOf(const Point &point) noexcept;
+    [[nodiscard]] static std::uint32_t CellIndex(const CellCoordinates &coordinates) noexcept;
+    // Squared distance from `point` to the nearest point of the cell.
+    [[nodiscard]] static float CellDistance(const CellCoordinates &coordinates, const Point &point) noexcept;
+    void AddToCell(std::size_t slot, std::uint32_t cell);
+    void RemoveFromCell(std::size_t slot);
+};
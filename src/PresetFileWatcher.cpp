@@ -0,0 +1,375 @@
+#include "PresetFileWatcher.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <map>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+#include <cwchar>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+bool SameFileName(const std::filesystem::path &lhs, const std::filesystem::path &rhs)
+{
+#ifdef _WIN32
+    // NTFS names are case-insensitive, and notifications report whatever casing the writer used.
+    return _wcsicmp(lhs.c_str(), rhs.c_str()) == 0;
+#else
+    return lhs == rhs;
+#endif
+}
+} // namespace
+
+struct PresetFileWatcher::WatchedDirectory
+{
+    std::filesystem::path path;
+    // Names (without directory) of the watched files inside `path`.
+    std::vector<std::filesystem::path> fileNames;
+#ifdef _WIN32
+    HANDLE handle{INVALID_HANDLE_VALUE};
+    OVERLAPPED overlapped{};
+    // ReadDirectoryChangesW needs DWORD alignment.
+    alignas(DWORD) std::array<char, 16 * 1024> buffer{};
+#else
+    int watchDescriptor{-1};
+#endif
+};
+
+PresetFileWatcher::PresetFileWatcher(std::vector<std::filesystem::path> files, ChangeCallback onChange)
+    : files(std::move(files)),
+      onChange(std::move(onChange))
+{
+    OpenDirectories();
+    if (IsWatching())
+    {
+        worker = std::thread(&PresetFileWatcher::Run, this);
+    }
+}
+
+PresetFileWatcher::~PresetFileWatcher()
+{
+#ifdef _WIN32
+    if (stopEvent)
+    {
+        SetEvent(stopEvent);
+    }
+#else
+    if (stopPipe[1] >= 0)
+    {
+        const char stop = 1;
+        [[maybe_unused]] const auto written = ::write(stopPipe[1], &stop, 1);
+    }
+#endif
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+    CloseDirectories();
+}
+
+bool PresetFileWatcher::IsWatching() const noexcept
+{
+    return !directories.empty();
+}
+
+void PresetFileWatcher::Run()
+{
+    std::vector<std::filesystem::path> pending;
+    std::vector<std::filesystem::path> changed;
+    while (true)
+    {
+        changed.clear();
+        const auto timeout = pending.empty() ? std::chrono::milliseconds(-1) : settleDelay;
+        const auto result = WaitForChanges(timeout, changed);
+        if (result == WaitResult::Stopping)
+        {
+            return;
+        }
+
+        if (result == WaitResult::TimedOut)
+        {
+            // Quiet for a whole settle delay: whoever was writing is done.
+            for (const auto &file : pending)
+            {
+                onChange(file);
+            }
+            pending.clear();
+            continue;
+        }
+
+        for (auto &file : changed)
+        {
+            if (std::find(pending.begin(), pending.end(), file) == pending.end())
+            {
+                pending.push_back(std::move(file));
+            }
+        }
+    }
+}
+
+void PresetFileWatcher::MatchChangedName(const WatchedDirectory &directory, const std::filesystem::path &name,
+                                         std::vector<std::filesystem::path> &changed) const
+{
+    for (const auto &fileName : directory.fileNames)
+    {
+        if (SameFileName(fileName, name))
+        {
+            changed.push_back(directory.path / fileName);
+        }
+    }
+}
+
+#ifdef _WIN32
+namespace
+{
+bool ArmDirectory(HANDLE handle, OVERLAPPED &overlapped, void *buffer, DWORD bufferSize)
+{
+    ResetEvent(overlapped.hEvent);
+    return ReadDirectoryChangesW(handle, buffer, bufferSize, FALSE,
+                                 FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+                                 nullptr, &overlapped, nullptr) != FALSE;
+}
+} // namespace
+
+void PresetFileWatcher::OpenDirectories()
+{
+    std::map<std::filesystem::path, std::vector<std::filesystem::path>> namesByDirectory;
+    for (const auto &file : files)
+    {
+        namesByDirectory[file.parent_path()].push_back(file.filename());
+    }
+
+    // Pending reads point at the OVERLAPPED and buffer inside each entry, so the vector must never
+    // reallocate once the first read is armed.
+    directories.reserve(namesByDirectory.size());
+    for (auto &[path, names] : namesByDirectory)
+    {
+        const HANDLE handle = CreateFileW(path.c_str(), FILE_LIST_DIRECTORY,
+                                          FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                          FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            continue;
+        }
+
+        auto &directory = directories.emplace_back();
+        directory.path = path;
+        directory.fileNames = std::move(names);
+        directory.handle = handle;
+        directory.overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!directory.overlapped.hEvent ||
+            !ArmDirectory(handle, directory.overlapped, directory.buffer.data(), static_cast<DWORD>(directory.buffer.size())))
+        {
+            if (directory.overlapped.hEvent)
+            {
+                CloseHandle(directory.overlapped.hEvent);
+            }
+            CloseHandle(handle);
+            directories.pop_back();
+        }
+    }
+
+    if (!directories.empty())
+    {
+        stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!stopEvent)
+        {
+            CloseDirectories();
+        }
+    }
+}
+
+void PresetFileWatcher::CloseDirectories() noexcept
+{
+    for (auto &directory : directories)
+    {
+        CancelIoEx(directory.handle, &directory.overlapped);
+        DWORD ignored = 0;
+        GetOverlappedResult(directory.handle, &directory.overlapped, &ignored, TRUE);
+        CloseHandle(directory.overlapped.hEvent);
+        CloseHandle(directory.handle);
+    }
+    directories.clear();
+
+    if (stopEvent)
+    {
+        CloseHandle(stopEvent);
+        stopEvent = nullptr;
+    }
+}
+
+PresetFileWatcher::WaitResult PresetFileWatcher::WaitForChanges(std::chrono::milliseconds timeout, std::vector<std::filesystem::path> &changed)
+{
+    // One stop event plus at most a few directories, far below MAXIMUM_WAIT_OBJECTS.
+    std::vector<HANDLE> handles{stopEvent};
+    for (const auto &directory : directories)
+    {
+        handles.push_back(directory.overlapped.hEvent);
+    }
+
+    const DWORD waitMilliseconds = timeout.count() < 0 ? INFINITE : static_cast<DWORD>(timeout.count());
+    const DWORD result = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, waitMilliseconds);
+    if (result == WAIT_TIMEOUT)
+    {
+        return WaitResult::TimedOut;
+    }
+    if (result == WAIT_OBJECT_0 || result == WAIT_FAILED)
+    {
+        return WaitResult::Stopping;
+    }
+
+    auto &directory = directories[result - WAIT_OBJECT_0 - 1];
+    DWORD bytes = 0;
+    if (GetOverlappedResult(directory.handle, &directory.overlapped, &bytes, FALSE))
+    {
+        if (bytes == 0)
+        {
+            // The notification buffer overflowed; assume every watched file changed.
+            for (const auto &fileName : directory.fileNames)
+            {
+                changed.push_back(directory.path / fileName);
+            }
+        }
+
+        for (std::size_t offset = 0; bytes != 0;)
+        {
+            const auto *info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(directory.buffer.data() + offset);
+            MatchChangedName(directory, std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)), changed);
+            if (info->NextEntryOffset == 0)
+            {
+                break;
+            }
+            offset += info->NextEntryOffset;
+        }
+    }
+
+    // If re-arming fails the directory just goes quiet; its event stays reset and is never signalled.
+    ArmDirectory(directory.handle, directory.overlapped, directory.buffer.data(), static_cast<DWORD>(directory.buffer.size()));
+    return WaitResult::Notified;
+}
+#else
+void PresetFileWatcher::OpenDirectories()
+{
+    notifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notifyDescriptor < 0)
+    {
+        return;
+    }
+    if (::pipe2(stopPipe, O_CLOEXEC) != 0)
+    {
+        stopPipe[0] = stopPipe[1] = -1;
+        CloseDirectories();
+        return;
+    }
+
+    std::map<std::filesystem::path, std::vector<std::filesystem::path>> namesByDirectory;
+    for (const auto &file : files)
+    {
+        namesByDirectory[file.parent_path()].push_back(file.filename());
+    }
+
+    for (auto &[path, names] : namesByDirectory)
+    {
+        const int watch = inotify_add_watch(notifyDescriptor, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+        if (watch < 0)
+        {
+            continue;
+        }
+
+        auto &directory = directories.emplace_back();
+        directory.path = path;
+        directory.fileNames = std::move(names);
+        directory.watchDescriptor = watch;
+    }
+
+    if (directories.empty())
+    {
+        CloseDirectories();
+    }
+}
+
+void PresetFileWatcher::CloseDirectories() noexcept
+{
+    directories.clear();
+    for (int *descriptor : {&notifyDescriptor, &stopPipe[0], &stopPipe[1]})
+    {
+        if (*descriptor >= 0)
+        {
+            ::close(*descriptor);
+            *descriptor = -1;
+        }
+    }
+}
+
+PresetFileWatcher::WaitResult PresetFileWatcher::WaitForChanges(std::chrono::milliseconds timeout, std::vector<std::filesystem::path> &changed)
+{
+    std::array<pollfd, 2> descriptors{{{stopPipe[0], POLLIN, 0}, {notifyDescriptor, POLLIN, 0}}};
+    const int ready = ::poll(descriptors.data(), descriptors.size(), static_cast<int>(timeout.count()));
+    if (ready == 0)
+    {
+        return WaitResult::TimedOut;
+    }
+    if (ready < 0)
+    {
+        // Interrupted by a signal; report it like an event so the caller simply waits again.
+        return errno == EINTR ? WaitResult::Notified : WaitResult::Stopping;
+    }
+    if (descriptors[0].revents != 0)
+    {
+        return WaitResult::Stopping;
+    }
+
+    alignas(inotify_event) std::array<char, 16 * 1024> buffer{};
+    while (true)
+    {
+        const auto length = ::read(notifyDescriptor, buffer.data(), buffer.size());
+        if (length <= 0)
+        {
+            break;
+        }
+
+        for (std::size_t offset = 0; offset < static_cast<std::size_t>(length);)
+        {
+            const auto *event = reinterpret_cast<const inotify_event *>(buffer.data() + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                for (const auto &directory : directories)
+                {
+                    for (const auto &fileName : directory.fileNames)
+                    {
+                        changed.push_back(directory.path / fileName);
+                    }
+                }
+                continue;
+            }
+
+            const auto directory = std::find_if(directories.begin(), directories.end(), [event](const WatchedDirectory &candidate)
+                                                {
+                                                    return candidate.watchDescriptor == event->wd;
+                                                });
+            if (directory != directories.end() && event->len > 0)
+            {
+                MatchChangedName(*directory, event->name, changed);
+            }
+        }
+    }
+    return WaitResult::Notified;
+}
+#endif
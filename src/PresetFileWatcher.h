@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Watches a handful of files through OS change notifications (ReadDirectoryChangesW on Windows,
+// inotify elsewhere) on a background thread. The parent directories are watched rather than the
+// files themselves, so atomic replace-by-rename and delete/recreate cycles are still seen.
+// Notifications for the same file are coalesced until it has been quiet for the settle delay,
+// then `onChange` runs once per file on the watcher thread.
+class PresetFileWatcher
+{
+public:
+    using ChangeCallback = std::function<void(const std::filesystem::path &)>;
+
+    static constexpr std::chrono::milliseconds settleDelay{250};
+
+    PresetFileWatcher(std::vector<std::filesystem::path> files, ChangeCallback onChange);
+    ~PresetFileWatcher();
+
+    PresetFileWatcher(const PresetFileWatcher &) = delete;
+    PresetFileWatcher &operator=(const PresetFileWatcher &) = delete;
+
+    // False when no directory could be watched, e.g. because none of them exist.
+    [[nodiscard]] bool IsWatching() const noexcept;
+
+private:
+    struct WatchedDirectory;
+
+    enum class WaitResult
+    {
+        Notified,
+        TimedOut,
+        Stopping,
+    };
+
+    std::vector<std::filesystem::path> files;
+    ChangeCallback onChange;
+    std::vector<WatchedDirectory> directories;
+    std::thread worker;
+#ifdef _WIN32
+    void *stopEvent{nullptr};
+#else
+    int notifyDescriptor{-1};
+    int stopPipe[2]{-1, -1};
+#endif
+
+    void Run();
+    void OpenDirectories();
+    void CloseDirectories() noexcept;
+    // Blocks for at most `timeout` (negative waits indefinitely) and appends the watched files
+    // that changed. Notified may leave `changed` untouched when only unrelated files changed.
+    WaitResult WaitForChanges(std::chrono::milliseconds timeout, std::vector<std::filesystem::path> &changed);
+    void MatchChangedName(const WatchedDirectory &directory, const std::filesystem::path &name,
+                          std::vector<std::filesystem::path> &changed) const;
+};
@@ -0,0 +1,131 @@
+#include "PresetHotColumns.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+std::uint32_t PackChannel(float value) noexcept
+{
+    return static_cast<std::uint32_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+std::uint8_t PackFlags(const PresetCustomization &customization) noexcept
+{
+    std::uint8_t packed = 0;
+    if (customization.paintFinishMatte)
+    {
+        packed |= PresetHotColumns::Matte;
+    }
+    if (customization.paintFinishPearlescent)
+    {
+        packed |= PresetHotColumns::Pearlescent;
+    }
+    return packed;
+}
+} // namespace
+
+void PresetHotColumns::Clear()
+{
+    nameArena.clear();
+    nameRefs.clear();
+    primaryColors.clear();
+    accentColors.clear();
+    flags.clear();
+    wastedBytes = 0;
+}
+
+void PresetHotColumns::Reserve(std::size_t count, std::size_t nameBytes)
+{
+    nameArena.reserve(nameBytes + count);
+    nameRefs.reserve(count);
+    primaryColors.reserve(count);
+    accentColors.reserve(count);
+    flags.reserve(count);
+}
+
+void PresetHotColumns::Assign(std::size_t slot, const CustomPreset &preset)
+{
+    const auto &customization = preset.customization;
+    if (slot == nameRefs.size())
+    {
+        nameRefs.push_back(AppendName(preset.name));
+        primaryColors.push_back(PackColor(customization.primaryColor));
+        accentColors.push_back(PackColor(customization.accentColor));
+        flags.push_back(PackFlags(customization));
+        return;
+    }
+
+    primaryColors[slot] = PackColor(customization.primaryColor);
+    accentColors[slot] = PackColor(customization.accentColor);
+    flags[slot] = PackFlags(customization);
+
+    auto &ref = nameRefs[slot];
+    if (preset.name.size() <= ref.length)
+    {
+        // Shorter or equal names overwrite their old bytes; only the tail becomes waste.
+        std::copy(preset.name.begin(), preset.name.end(), nameArena.begin() + ref.offset);
+        nameArena[ref.offset + preset.name.size()] = '\0';
+        wastedBytes += ref.length - preset.name.size();
+        ref.length = static_cast<std::uint32_t>(preset.name.size());
+        return;
+    }
+
+    wastedBytes += ref.length + 1;
+    ref = AppendName(preset.name);
+    CompactIfWasteful();
+}
+
+void PresetHotColumns::SwapRemove(std::size_t slot)
+{
+    if (slot >= nameRefs.size())
+    {
+        return;
+    }
+
+    // The moved name keeps its bytes in the arena; only the removed one becomes waste.
+    wastedBytes += nameRefs[slot].length + 1;
+    const auto last = nameRefs.size() - 1;
+    nameRefs[slot] = nameRefs[last];
+    primaryColors[slot] = primaryColors[last];
+    accentColors[slot] = accentColors[last];
+    flags[slot] = flags[last];
+    nameRefs.pop_back();
+    primaryColors.pop_back();
+    accentColors.pop_back();
+    flags.pop_back();
+    CompactIfWasteful();
+}
+
+std::uint32_t PresetHotColumns::PackColor(const PresetPaintColor &color) noexcept
+{
+    return PackChannel(color.r) | PackChannel(color.g) << 8 | PackChannel(color.b) << 16;
+}
+
+PresetHotColumns::NameRef PresetHotColumns::AppendName(std::string_view name)
+{
+    NameRef ref{static_cast<std::uint32_t>(nameArena.size()), static_cast<std::uint32_t>(name.size())};
+    nameArena.insert(nameArena.end(), name.begin(), name.end());
+    nameArena.push_back('\0');
+    return ref;
+}
+
+void PresetHotColumns::CompactIfWasteful()
+{
+    if (wastedBytes < minCompactionWaste || wastedBytes * 2 < nameArena.size())
+    {
+        return;
+    }
+
+    std::vector<char> compacted;
+    compacted.reserve(nameArena.size() - wastedBytes);
+    for (auto &ref : nameRefs)
+    {
+        const auto begin = nameArena.begin() + ref.offset;
+        const auto newOffset = static_cast<std::uint32_t>(compacted.size());
+        compacted.insert(compacted.end(), begin, begin + ref.length + 1);
+        ref.offset = newOffset;
+    }
+    nameArena = std::move(compacted);
+    wastedBytes = 0;
+}
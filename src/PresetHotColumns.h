@@ -0,0 +1,87 @@
+#pragma once
+
+#include "PresetTypes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Structure-of-arrays copy of the preset fields the list touches every frame: the name, both
+// paint colors and the finish flags. `CustomPreset` keeps the full record; this layout only
+// exists so per-frame scans walk a few contiguous arrays instead of striding over fat structs.
+// Slots mirror the positions in PresetManager's collection.
+class PresetHotColumns
+{
+public:
+    enum Flag : std::uint8_t
+    {
+        Matte = 1 << 0,
+        Pearlescent = 1 << 1,
+    };
+
+    void Clear();
+    void Reserve(std::size_t count, std::size_t nameBytes);
+
+    // Keeps `slot` in sync with `preset`; `slot` may be one past the end to append.
+    void Assign(std::size_t slot, const CustomPreset &preset);
+    // Moves the last slot into `slot` and drops the last one, matching PresetManager's removals.
+    void SwapRemove(std::size_t slot);
+
+    [[nodiscard]] std::size_t Size() const noexcept
+    {
+        return nameRefs.size();
+    }
+
+    // Names live NUL-terminated in one arena. The pointer and view stay valid until the next
+    // Assign/SwapRemove/Clear.
+    [[nodiscard]] std::string_view Name(std::size_t slot) const noexcept
+    {
+        return {nameArena.data() + nameRefs[slot].offset, nameRefs[slot].length};
+    }
+
+    [[nodiscard]] const char *NameCString(std::size_t slot) const noexcept
+    {
+        return nameArena.data() + nameRefs[slot].offset;
+    }
+
+    // RGB8 with red in the low byte, so OR-ing in an alpha byte yields an ImU32 (IM_COL32 order).
+    [[nodiscard]] std::uint32_t PrimaryColor(std::size_t slot) const noexcept
+    {
+        return primaryColors[slot];
+    }
+
+    [[nodiscard]] std::uint32_t AccentColor(std::size_t slot) const noexcept
+    {
+        return accentColors[slot];
+    }
+
+    [[nodiscard]] std::uint8_t Flags(std::size_t slot) const noexcept
+    {
+        return flags[slot];
+    }
+
+    [[nodiscard]] static std::uint32_t PackColor(const PresetPaintColor &color) noexcept;
+
+private:
+    // Rewriting the arena costs one pass over all names, so only do it once at least this many
+    // bytes and half of the arena are unreferenced.
+    static constexpr std::size_t minCompactionWaste = 4096;
+
+    struct NameRef
+    {
+        std::uint32_t offset{0};
+        std::uint32_t length{0};
+    };
+
+    std::vector<char> nameArena;
+    std::vector<NameRef> nameRefs;
+    std::vector<std::uint32_t> primaryColors;
+    std::vector<std::uint32_t> accentColors;
+    std::vector<std::uint8_t> flags;
+    // Arena bytes no longer referenced by any slot after renames and removals.
+    std::size_t wastedBytes{0};
+
+    NameRef AppendName(std::string_view name);
+    void CompactIfWasteful();
+};
@@ -0,0 +1,113 @@
+#include "PresetJournal.h"
+
+#include "PresetBinaryCache.h"
+
+#include <array>
+#include <cstdint>
+#include <sstream>
+
+namespace
+{
+constexpr std::size_t checksumDigits = 8;
+
+std::uint32_t Checksum(std::string_view payload) noexcept
+{
+    return static_cast<std::uint32_t>(PresetBinaryCache::HashContents(payload));
+}
+
+void AppendRecord(std::string &records, char marker, std::string_view payload)
+{
+    constexpr std::string_view hexDigits{"0123456789abcdef"};
+    const auto checksum = Checksum(payload);
+    std::array<char, checksumDigits> digits{};
+    for (std::size_t i = 0; i < checksumDigits; ++i)
+    {
+        digits[i] = hexDigits[(checksum >> (4 * (checksumDigits - 1 - i))) & 0xFu];
+    }
+
+    records += marker;
+    records.append(digits.data(), digits.size());
+    records += ' ';
+    records += payload;
+    records += '\n';
+}
+
+bool ParseChecksum(std::string_view text, std::uint32_t &checksum) noexcept
+{
+    checksum = 0;
+    for (const char c : text)
+    {
+        std::uint32_t digit = 0;
+        if (c >= '0' && c <= '9')
+        {
+            digit = static_cast<std::uint32_t>(c - '0');
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            digit = static_cast<std::uint32_t>(c - 'a' + 10);
+        }
+        else
+        {
+            return false;
+        }
+        checksum = checksum << 4 | digit;
+    }
+    return true;
+}
+} // namespace
+
+namespace PresetJournal
+{
+std::filesystem::path PathFor(const std::filesystem::path &storageFilePath)
+{
+    auto path = storageFilePath;
+    path.replace_extension(".journal");
+    return path;
+}
+
+void AppendUpsert(std::string &records, const CustomPreset &preset, const PresetLabelPool &labels)
+{
+    std::ostringstream line;
+    PresetSerialization::WritePresetLine(line, preset, labels);
+    auto payload = line.str();
+    payload.pop_back();
+    AppendRecord(records, '+', payload);
+}
+
+void AppendRemoval(std::string &records, std::string_view name)
+{
+    std::string payload{name};
+    payload += '|';
+    AppendRecord(records, '-', payload);
+}
+
+bool ParseRecord(std::string_view line, Record &record) noexcept
+{
+    if (line.size() < checksumDigits + 3 || (line.front() != '+' && line.front() != '-') || line[checksumDigits + 1] != ' ')
+    {
+        return false;
+    }
+
+    std::uint32_t checksum = 0;
+    const auto payload = line.substr(checksumDigits + 2);
+    if (!ParseChecksum(line.substr(1, checksumDigits), checksum) || checksum != Checksum(payload))
+    {
+        return false;
+    }
+
+    record.removal = line.front() == '-';
+    if (record.removal)
+    {
+        // The terminator keeps the checksummed text intact when the line is trimmed; the name
+        // itself is trimmed like cfg names are.
+        record.name = PresetSerialization::TrimWhitespace(payload.substr(0, payload.size() - 1));
+        return payload.back() == '|';
+    }
+    if (!PresetSerialization::ParsePresetLine(payload, record.fields))
+    {
+        return false;
+    }
+    record.name = record.fields.name;
+    return true;
+}
+} // namespace PresetJournal
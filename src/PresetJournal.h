@@ -0,0 +1,64 @@
+#pragma once
+
+#include "PresetLabelPool.h"
+#include "PresetSerialization.h"
+#include "PresetTypes.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// Append-only log of the edits made since expanded_presets.cfg was last rewritten, kept next to
+// it as expanded_presets.journal. One line per edit:
+//
+//   +<checksum> <storage line>   preset added or replaced
+//   -<checksum> <name>|          preset removed
+//
+// The checksum is the low 32 bits of PresetBinaryCache::HashContents over the text after the
+// space, in hex. A line that fails it was cut short by a crash mid-append, so replay stops there.
+// Applying a record twice has the same effect as applying it once, which keeps replay over a cfg
+// that already contains some of the records safe.
+namespace PresetJournal
+{
+struct Record
+{
+    bool removal{false};
+    std::string_view name;
+    // Only filled in for additions.
+    PresetSerialization::PresetLineFields fields;
+};
+
+[[nodiscard]] std::filesystem::path PathFor(const std::filesystem::path &storageFilePath);
+
+void AppendUpsert(std::string &records, const CustomPreset &preset, const PresetLabelPool &labels);
+void AppendRemoval(std::string &records, std::string_view name);
+
+// Parses one trimmed journal line. Returns false for anything that is not an intact record.
+bool ParseRecord(std::string_view line, Record &record) noexcept;
+
+// Calls `callback(record)` for every record of `buffer` in order, stopping at the first damaged
+// one. Returns the number of records read; `torn` is set when replay stopped early.
+template <typename Callback>
+std::size_t ForEachRecord(std::string_view buffer, bool &torn, Callback &&callback)
+{
+    torn = false;
+    std::size_t count = 0;
+    Record record;
+    PresetSerialization::ForEachLine(buffer, [&torn, &count, &record, &callback](std::string_view line)
+                                     {
+                                         if (torn)
+                                         {
+                                             return;
+                                         }
+                                         if (!ParseRecord(line, record))
+                                         {
+                                             torn = true;
+                                             return;
+                                         }
+                                         callback(record);
+                                         ++count;
+                                     });
+    return count;
+}
+} // namespace PresetJournal
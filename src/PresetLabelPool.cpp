@@ -0,0 +1,71 @@
+#include "PresetLabelPool.h"
+
+#include <utility>
+
+PresetLabelPool::PresetLabelPool(LogCallback log)
+    : log(std::move(log))
+{
+    // The default customization refers to these ids before anything has been loaded.
+    Intern(defaultCarLabelText, defaultCarLabelId);
+    Intern(defaultDecalLabelText, defaultDecalLabelId);
+    Intern(defaultWheelsLabelText, defaultWheelsLabelId);
+}
+
+PresetLabelId PresetLabelPool::Intern(std::string_view label, PresetLabelId fallback)
+{
+    if (const auto it = idsByLabel.find(label); it != idsByLabel.end())
+    {
+        return it->second;
+    }
+
+    const auto id = count.load(std::memory_order_relaxed);
+    const auto chunkIndex = id / chunkSize;
+    if (chunkIndex >= maxChunks)
+    {
+        // 16M distinct labels is far beyond any real catalog; degrade to the field's default
+        // label rather than failing the whole import.
+        if (!overflowLogged && log)
+        {
+            overflowLogged = true;
+            log("ExpandedPresets: Label pool is full; new labels fall back to the default label");
+        }
+        return fallback;
+    }
+
+    if (!chunks[chunkIndex])
+    {
+        chunks[chunkIndex] = std::make_unique<std::string[]>(chunkSize);
+    }
+
+    auto &stored = chunks[chunkIndex][id % chunkSize];
+    stored.assign(label.data(), label.size());
+    idsByLabel.emplace(stored, static_cast<PresetLabelId>(id));
+    count.store(id + 1, std::memory_order_release);
+    return static_cast<PresetLabelId>(id);
+}
+
+std::optional<PresetLabelId> PresetLabelPool::Find(std::string_view label) const
+{
+    const auto it = idsByLabel.find(label);
+    if (it == idsByLabel.end())
+    {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+const std::string &PresetLabelPool::Resolve(PresetLabelId id) const noexcept
+{
+    static const std::string unknownLabel;
+    if (id >= count.load(std::memory_order_acquire))
+    {
+        return unknownLabel;
+    }
+
+    return chunks[id / chunkSize][id % chunkSize];
+}
+
+std::size_t PresetLabelPool::Size() const noexcept
+{
+    return count.load(std::memory_order_acquire);
+}
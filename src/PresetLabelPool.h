@@ -0,0 +1,58 @@
+#pragma once
+
+#include "PresetTypes.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Append-only intern pool for car, decal and wheels labels. Each distinct label is stored once
+// and presets refer to it through a PresetLabelId, so comparing labels is an integer compare.
+//
+// Threading: Intern() must only be called from one thread at a time (the game thread in the
+// plugin). Resolve() may be called from any thread for ids that have already been handed out;
+// label storage never moves once written.
+class PresetLabelPool
+{
+public:
+    using LogCallback = std::function<void(const std::string &)>;
+
+    explicit PresetLabelPool(LogCallback log = {});
+
+    PresetLabelPool(const PresetLabelPool &) = delete;
+    PresetLabelPool &operator=(const PresetLabelPool &) = delete;
+
+    // Returns `fallback` (the default label of the field being filled) once the pool is full.
+    PresetLabelId Intern(std::string_view label, PresetLabelId fallback);
+    [[nodiscard]] std::optional<PresetLabelId> Find(std::string_view label) const;
+    [[nodiscard]] const std::string &Resolve(PresetLabelId id) const noexcept;
+    [[nodiscard]] std::size_t Size() const noexcept;
+
+private:
+    static constexpr std::size_t chunkSize = 4096;
+    static constexpr std::size_t maxChunks = 4096;
+
+    struct StringViewHash
+    {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view text) const noexcept
+        {
+            return std::hash<std::string_view>{}(text);
+        }
+    };
+
+    // Fixed-size chunks that never move. A chunk and its strings are written before `count` is
+    // published with release ordering, so a reader that sees an id also sees its label.
+    std::array<std::unique_ptr<std::string[]>, maxChunks> chunks;
+    std::atomic<std::size_t> count{0};
+    std::unordered_map<std::string_view, PresetLabelId, StringViewHash, std::equal_to<>> idsByLabel;
+    LogCallback log;
+    bool overflowLogged = false;
+};
@@ -1,345 +1,1580 @@
 #include "PresetManager.h"
 
-#include <algorithm>
-#include <fstream>
-#include <iomanip>
-#include <sstream>
+#include "MappedFile.h"
+#include "PresetJournal.h"
+#include "PresetProfiler.h"
+#include "PresetSerialization.h"
+#include "PresetWorkerPool.h"
 
-#include "bakkesmod/wrappers/GameWrapper.h"
+#include <algorithm>
+#include <array>
 
 namespace
 {
-std::string TrimWhitespace(const std::string &text)
+// Whether reloading `stored` from the cfg changes `current`. Colours only count when they differ
+// at the precision the cfg keeps, so presets recoloured in full precision do not look edited.
+bool StoredPresetDiffers(const CustomPreset &current, const CustomPreset &stored) noexcept
 {
-    const auto first = text.find_first_not_of(" \t\r\n");
-    if (first == std::string::npos)
-    {
-        return {};
-    }
-    const auto last = text.find_last_not_of(" \t\r\n");
-    return text.substr(first, last - first + 1);
+    const auto &lhs = current.customization;
+    const auto &rhs = stored.customization;
+    return current.name != stored.name || current.loadoutCode != stored.loadoutCode || lhs.carLabel != rhs.carLabel ||
+           lhs.decalLabel != rhs.decalLabel || lhs.wheelsLabel != rhs.wheelsLabel || lhs.paintFinishMatte != rhs.paintFinishMatte ||
+           lhs.paintFinishPearlescent != rhs.paintFinishPearlescent ||
+           !PresetSerialization::SameColorToken(lhs.primaryColor, rhs.primaryColor) ||
+           !PresetSerialization::SameColorToken(lhs.accentColor, rhs.accentColor);
+}
+
+// Shard snapshots handed to the storage writer. They are copied off the arena, which the next
+// reload may release while the writer still holds them.
+CustomPreset HeapCopyOf(const CustomPreset &preset)
+{
+    return CustomPreset{PresetString(preset.name, PresetStringArena::Heap()),
+                        PresetString(preset.loadoutCode, PresetStringArena::Heap()),
+                        preset.customization};
 }
 } // namespace
 
-PresetManager::PresetManager(std::shared_ptr<GameWrapper> gameWrapper,
-                             std::shared_ptr<CVarManagerWrapper> cvarManager)
-    : gameWrapper(std::move(gameWrapper)),
-      cvarManager(std::move(cvarManager))
+PresetManager::PresetManager(PresetManagerHost host)
+    : host(std::move(host)),
+      labelPool(std::make_shared<PresetLabelPool>([this](const std::string &message) { LogFromAnyThread(message); })),
+      searchIndex(*labelPool, decodedLoadouts)
 {
-    const auto dataFolder = ResolveDataFolder(this->gameWrapper);
-    storageFilePath = dataFolder / storageFileName;
-    vanillaPresetsPath = ResolveVanillaPresetPath(this->gameWrapper);
+    storageFilePath = this->host.dataFolder / storageFileName;
+    catalogFilePath = this->host.dataFolder / catalogFileName;
+    shardDirectory = PresetShards::DirectoryFor(storageFilePath);
+    vanillaPresetsPath = this->host.vanillaPresetsPath;
+    gameThreadId = std::this_thread::get_id();
     EnsureStorageDirectory();
+
+    storageWriter = std::make_unique<PresetStorageWriter>(storageFilePath, labelPool,
+                                                          [this](const std::string &message)
+                                                          {
+                                                              LogFromAnyThread(message);
+                                                          });
 }
 
 void PresetManager::RefreshFromVanillaPresets()
 {
-    presets.clear();
+    EXP_PRESETS_PROFILE_SCOPE(VanillaImport);
+    ClearPresets();
+
+    if (vanillaPresetsPath.empty() || !std::filesystem::exists(vanillaPresetsPath))
+    {
+        host.log("ExpandedPresets: Could not find vanilla presets.data file to import presets.");
+        return;
+    }
+
+    const MappedFile file(vanillaPresetsPath);
+    if (!file.IsOpen())
+    {
+        host.log("ExpandedPresets: Failed to open vanilla presets file: " + vanillaPresetsPath.string());
+        return;
+    }
+
+    auto preset = NewArenaPreset();
+    PresetSerialization::ForEachLine(file.View(), [this, &preset](std::string_view line)
+                                     {
+                                         std::string_view name;
+                                         std::string_view loadoutCode;
+                                         if (PresetSerialization::ParseVanillaLine(line, name, loadoutCode))
+                                         {
+                                             preset.name.assign(name);
+                                             preset.loadoutCode.assign(loadoutCode);
+                                             preset.customization = PresetCustomization{};
+                                             const auto loadout = LoadoutCode::Decode(preset.loadoutCode);
+                                             preset.customization.carLabel = DetectedCarLabel(loadout, defaultCarLabelId);
+                                             StorePreset(std::move(preset), loadout);
+                                         }
+                                     });
+}
 
+PresetManager::VanillaMergeSummary PresetManager::MergeVanillaPresets()
+{
+    EXP_PRESETS_PROFILE_SCOPE(VanillaImport);
+    VanillaMergeSummary summary;
     if (vanillaPresetsPath.empty() || !std::filesystem::exists(vanillaPresetsPath))
     {
-        cvarManager->log("ExpandedPresets: Could not find vanilla presets.data file to import presets.");
+        host.log("ExpandedPresets: Could not find vanilla presets.data file to import presets.");
+        return summary;
+    }
+
+    const MappedFile file(vanillaPresetsPath);
+    if (!file.IsOpen())
+    {
+        host.log("ExpandedPresets: Failed to open vanilla presets file: " + vanillaPresetsPath.string());
+        return summary;
+    }
+
+    std::string records;
+    std::string name;
+    PresetSerialization::ForEachLine(file.View(), [this, &summary, &records, &name](std::string_view line)
+                                     {
+                                         std::string_view parsedName;
+                                         std::string_view loadoutCode;
+                                         if (!PresetSerialization::ParseVanillaLine(line, parsedName, loadoutCode))
+                                         {
+                                             ++summary.skipped;
+                                             return;
+                                         }
+
+                                         name.assign(parsedName);
+                                         const auto it = presetIndexByName.find(name);
+                                         if (it == presetIndexByName.end())
+                                         {
+                                             auto preset = NewArenaPreset();
+                                             preset.name.assign(name);
+                                             preset.loadoutCode.assign(loadoutCode);
+                                             const auto loadout = LoadoutCode::Decode(preset.loadoutCode);
+                                             preset.customization.carLabel = DetectedCarLabel(loadout, defaultCarLabelId);
+                                             JournalUpsert(records, preset);
+                                             StorePreset(std::move(preset), loadout);
+                                             ++summary.added;
+                                             return;
+                                         }
+
+                                         const auto &existing = GetPreset(it->second);
+                                         if (existing.loadoutCode == loadoutCode)
+                                         {
+                                             ++summary.unchanged;
+                                             return;
+                                         }
+
+                                         auto updated = existing;
+                                         updated.loadoutCode.assign(loadoutCode);
+                                         const auto loadout = LoadoutCode::Decode(updated.loadoutCode);
+                                         if (updated.customization.carLabel == defaultCarLabelId)
+                                         {
+                                             updated.customization.carLabel = DetectedCarLabel(loadout, defaultCarLabelId);
+                                         }
+                                         JournalUpsert(records, updated);
+                                         StorePreset(std::move(updated), loadout);
+                                         ++summary.updated;
+                                     });
+
+    if (!records.empty())
+    {
+        SaveJournal(std::move(records), summary.added + summary.updated);
+    }
+    return summary;
+}
+
+void PresetManager::LoadFromStorage()
+{
+    EXP_PRESETS_PROFILE_SCOPE(LoadFromStorage);
+    ClearPresets();
+    unsavedNames.clear();
+    savingNames.clear();
+
+    // Everything read back from the cfg or the shards is already on disk; the journal replayed
+    // over it is not part of the cfg and is tracked again.
+    trackUnsavedNames = false;
+    shardedStorage = PresetShards::IsActive(shardDirectory);
+    if (shardedStorage)
+    {
+        LoadFromShards();
+        dirtyShards = 0;
+        trackUnsavedNames = true;
+        ReplayJournal();
         return;
     }
 
-    std::ifstream file(vanillaPresetsPath);
-    if (!file)
+    MappedFile file(storageFilePath);
+    if (!file.IsOpen())
     {
-        cvarManager->log("ExpandedPresets: Failed to open vanilla presets file: " + vanillaPresetsPath.string());
+        host.log("ExpandedPresets: No stored presets were found, importing from presets.data instead.");
+        trackUnsavedNames = true;
+        RefreshFromVanillaPresets();
+        SaveToStorage();
         return;
     }
 
-    std::string line;
-    while (std::getline(file, line))
+    if (lazyLoading)
     {
-        line = TrimWhitespace(line);
-        if (line.empty() || line.front() == '#')
+        // The views kept for later hydration point into the mapping, so it stays open.
+        lazyStorageFile = std::move(file);
+        const auto view = lazyStorageFile.View();
+        const auto lineCount = static_cast<std::size_t>(std::count(view.begin(), view.end(), '\n')) + 1;
+        presets.reserve(lineCount);
+        presetIndexByName.reserve(lineCount);
+        unparsedLines.reserve(lineCount);
+        decodedLoadouts.reserve(lineCount);
+        loadoutHashes.reserve(lineCount);
+        searchIndex.Reserve(lineCount);
+        auto preset = NewArenaPreset();
+        PresetSerialization::PresetLineFields fields;
+        PresetSerialization::ForEachLine(view, [this, &preset, &fields](std::string_view line)
+                                         {
+                                             if (PresetSerialization::ParsePresetLine(line, fields))
+                                             {
+                                                 IndexPresetLine(fields, line, preset);
+                                             }
+                                         });
+        if (unparsedCount == 0)
         {
-            continue;
+            HydrateAll();
         }
+    }
+    else if (!LoadFromBinaryCache(file.View()))
+    {
+        auto preset = NewArenaPreset();
+        PresetSerialization::PresetLineFields fields;
+        PresetSerialization::ForEachLine(file.View(), [this, &preset, &fields](std::string_view line)
+                                         {
+                                             if (PresetSerialization::ParsePresetLine(line, fields))
+                                             {
+                                                 PresetSerialization::AssignPreset(fields, *labelPool, preset);
+                                                 AddOrUpdatePreset(std::move(preset));
+                                             }
+                                         });
+
+        if (auto source = PresetBinaryCache::StatSource(storageFilePath))
+        {
+            source->contentHash = PresetBinaryCache::HashContents(file.View());
+            storageWriter->ScheduleCacheRefresh(GetSnapshot(), *source);
+        }
+    }
+
+    trackUnsavedNames = true;
+    ReplayJournal();
+}
+
+void PresetManager::IndexPresetLine(const PresetSerialization::PresetLineFields &fields, std::string_view line, CustomPreset &scratch)
+{
+    scratch.name.assign(fields.name);
+    scratch.loadoutCode.clear();
+    scratch.customization = PresetCustomization{};
+    scratch.customization.primaryColor = fields.primaryColor;
+    scratch.customization.accentColor = fields.accentColor;
+    scratch.customization.paintFinishMatte = fields.paintFinishMatte;
+    scratch.customization.paintFinishPearlescent = fields.paintFinishPearlescent;
+
+    // A later line with the same name wins, as it does when the cfg is loaded in full.
+    const auto [it, inserted] = presetIndexByName.try_emplace(std::string(fields.name), presets.size());
+    const auto index = it->second;
+    if (inserted)
+    {
+        presets.push_back(MoveIntoArena(std::move(scratch)));
+        AssignNewPresetId(index);
+        unparsedLines.push_back(line);
+        ++unparsedCount;
+        // Unparsed presets have no decoded loadout and are left out of the duplicate counts.
+        decodedLoadouts.emplace_back();
+        loadoutHashes.push_back(0);
+    }
+    else
+    {
+        presets[index] = std::move(scratch);
+        unparsedLines[index] = line;
+    }
+    searchIndex.Assign(index, presets[index]);
+    hotColumns.Assign(index, presets[index]);
+    colorIndex.Assign(index, presets[index]);
+}
+
+void PresetManager::HydratePreset(std::size_t index)
+{
+    const auto line = index < unparsedLines.size() ? unparsedLines[index] : std::string_view{};
+    if (!ForgetUnparsedLine(index))
+    {
+        return;
+    }
+    auto &preset = presets[index];
+
+    PresetSerialization::PresetLineFields fields;
+    if (!PresetSerialization::ParsePresetLine(line, fields) || fields.name != preset.name)
+    {
+        // Only possible if the mapped file was rewritten in place; keep what the index read.
+        host.log("ExpandedPresets: " + storageFilePath.string() + " changed before '" + std::string(preset.name) + "' was read; keeping its indexed fields.");
+        return;
+    }
+
+    // Not a change to the collection, so the revision stays and nothing is marked for saving.
+    EXP_PRESETS_PROFILE_COUNT(PresetsHydrated, 1);
+    PresetSerialization::AssignPreset(fields, *labelPool, preset);
+    decodedLoadouts[index] = LoadoutCode::Decode(preset.loadoutCode);
+    loadoutHashes[index] = LoadoutCode::ContentHash(decodedLoadouts[index], preset.loadoutCode);
+    ++presetCountByLoadoutHash[loadoutHashes[index]];
+    // The hot columns already hold everything the index read.
+    searchIndex.Assign(index, preset);
+}
+
+void PresetManager::HydrateAll()
+{
+    for (std::size_t i = 0; i < presets.size() && unparsedCount != 0; ++i)
+    {
+        HydratePreset(i);
+    }
+    unparsedLines.clear();
+    unparsedLines.shrink_to_fit();
+    // Nothing points into the mapping any more, and a full save has to be able to replace the file.
+    lazyStorageFile.Close();
+}
+
+bool PresetManager::ForgetUnparsedLine(std::size_t index) noexcept
+{
+    if (index >= unparsedLines.size() || unparsedLines[index].empty())
+    {
+        return false;
+    }
+    unparsedLines[index] = {};
+    --unparsedCount;
+    return true;
+}
+
+void PresetManager::SetLazyLoading(bool enabled) noexcept
+{
+    lazyLoading = enabled;
+}
+
+bool PresetManager::IsLazyLoading() const noexcept
+{
+    return lazyLoading;
+}
 
-        const auto delimiterPos = line.find_last_of("\t ");
-        if (delimiterPos == std::string::npos)
+std::size_t PresetManager::GetUnparsedCount() const noexcept
+{
+    return unparsedCount;
+}
+
+void PresetManager::LoadFromShards()
+{
+    std::vector<std::filesystem::path> shardPaths;
+    std::error_code error;
+    for (std::size_t i = 0; i < PresetShards::shardCount; ++i)
+    {
+        auto path = PresetShards::ShardPath(shardDirectory, i);
+        if (std::filesystem::exists(path, error))
         {
-            continue;
+            shardPaths.push_back(std::move(path));
         }
+    }
+    if (shardPaths.empty())
+    {
+        return;
+    }
+
+    // Parsing is spread over the worker pool; labels are interned here, on the owning thread.
+    PresetCatalogImporter loader(std::move(shardPaths));
+    if (!loader.Start(host.workers, nullptr))
+    {
+        host.log("ExpandedPresets: Could not open the preset shards in " + shardDirectory.string());
+        return;
+    }
+    loader.Wait();
 
-        CustomPreset preset;
-        preset.name = TrimWhitespace(line.substr(0, delimiterPos));
-        preset.loadoutCode = TrimWhitespace(line.substr(delimiterPos + 1));
-        if (preset.name.empty() || preset.loadoutCode.empty())
+    const auto entryCount = loader.EntryCount();
+    presets.reserve(entryCount);
+    presetIndexByName.reserve(entryCount);
+    decodedLoadouts.reserve(entryCount);
+    loadoutHashes.reserve(entryCount);
+    searchIndex.Reserve(entryCount);
+    for (auto &chunk : loader.Chunks())
+    {
+        for (auto &entry : chunk)
         {
-            continue;
+            auto &customization = entry.preset.customization;
+            customization.carLabel = labelPool->Intern(entry.carLabel, defaultCarLabelId);
+            customization.decalLabel = labelPool->Intern(entry.decalLabel, defaultDecalLabelId);
+            customization.wheelsLabel = labelPool->Intern(entry.wheelsLabel, defaultWheelsLabelId);
+            AddOrUpdatePreset(std::move(entry.preset));
         }
+    }
 
-        AddOrUpdatePreset(preset);
+    if (loader.RejectedLineCount() > 0)
+    {
+        host.log("ExpandedPresets: Skipped " + std::to_string(loader.RejectedLineCount()) + " malformed lines in the preset shards.");
     }
 }
 
-void PresetManager::LoadFromStorage()
+void PresetManager::ReplayJournal()
 {
-    presets.clear();
+    journalRecordCount = 0;
+    const MappedFile file(PresetJournal::PathFor(storageFilePath));
+    if (!file.IsOpen())
+    {
+        return;
+    }
+
+    bool torn = false;
+    auto preset = NewArenaPreset();
+    std::string name;
+    journalRecordCount = PresetJournal::ForEachRecord(file.View(), torn, [this, &preset, &name](const PresetJournal::Record &record)
+                                                      {
+                                                          if (record.removal)
+                                                          {
+                                                              name.assign(record.name);
+                                                              RemovePreset(name);
+                                                              return;
+                                                          }
+                                                          PresetSerialization::AssignPreset(record.fields, *labelPool, preset);
+                                                          AddOrUpdatePreset(std::move(preset));
+                                                      });
 
-    std::ifstream file(storageFilePath);
-    if (!file)
+    if (torn)
+    {
+        // Records appended behind the damaged one would be skipped on the next load, so fold the
+        // journal into the cfg right away.
+        host.log("ExpandedPresets: The journal ends in a damaged record; edits after it were lost.");
+        SaveToStorage();
+    }
+}
+
+bool PresetManager::LoadFromBinaryCache(std::string_view storageContents)
+{
+    const auto source = PresetBinaryCache::StatSource(storageFilePath);
+    if (!source)
+    {
+        return false;
+    }
+
+    auto cached = PresetBinaryCache::Load(PresetBinaryCache::CachePathFor(storageFilePath), *source,
+                                          [storageContents]
+                                          {
+                                              return PresetBinaryCache::HashContents(storageContents);
+                                          },
+                                          *labelPool, &stringArena);
+    if (!cached)
+    {
+        return false;
+    }
+
+    auto &cachedPresets = cached->presets;
+    const auto count = cachedPresets.size();
+    presets.reserve(count);
+    presetIndexByName.reserve(count);
+    presetIds.reserve(count);
+    slotById.reserve(count);
+    decodedLoadouts.reserve(count);
+    loadoutHashes.reserve(count);
+    presetCountByLoadoutHash.reserve(count);
+    searchIndex.Reserve(count);
+    std::size_t nameBytes = 0;
+    for (const auto &preset : cachedPresets)
+    {
+        nameBytes += preset.name.size();
+    }
+    hotColumns.Reserve(count, nameBytes);
+    colorIndex.Reserve(count);
+    // The cache carries every loadout already decoded and hashed.
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        StorePreset(std::move(cachedPresets[i]), cached->loadouts[i], cached->loadoutHashes[i]);
+    }
+    return true;
+}
+
+void PresetManager::SaveToStorage()
+{
+    EXP_PRESETS_PROFILE_SCOPE(SaveToStorage);
+    HydrateAll();
+    journalRecordCount = 0;
+    if (!shardedStorage)
+    {
+        // The names stay protected from reloads until this write has actually reached the cfg.
+        ForgetWrittenNames();
+        savingNames.merge(unsavedNames);
+        unsavedNames.clear();
+        savingSequence = storageWriter->Schedule(GetSnapshot());
+        return;
+    }
+
+    // The shards are never reloaded, so there is nothing to protect in that layout.
+    unsavedNames.clear();
+    savingNames.clear();
+
+    if (dirtyShards == 0)
+    {
+        return;
+    }
+    constexpr auto notDirty = PresetShards::shardCount;
+    std::array<std::size_t, PresetShards::shardCount> slotOfShard{};
+    std::vector<PresetShards::Shard> shards;
+    for (std::size_t i = 0; i < PresetShards::shardCount; ++i)
+    {
+        slotOfShard[i] = notDirty;
+        if ((dirtyShards & PresetShards::MaskOf(i)) != 0)
+        {
+            slotOfShard[i] = shards.size();
+            shards.push_back({i, {}});
+        }
+    }
+    for (const auto &preset : presets)
+    {
+        const auto slot = slotOfShard[PresetShards::ShardOf(preset.name)];
+        if (slot != notDirty)
+        {
+            shards[slot].presets.push_back(HeapCopyOf(preset));
+        }
+    }
+    dirtyShards = 0;
+    storageWriter->ScheduleShards(std::move(shards));
+}
+
+bool PresetManager::SetShardedStorage(bool enabled)
+{
+    if (enabled == shardedStorage)
+    {
+        return false;
+    }
+
+    shardedStorage = enabled;
+    dirtyShards = PresetShards::allShards;
+    SaveToStorage();
+    return true;
+}
+
+bool PresetManager::IsShardedStorage() const noexcept
+{
+    return shardedStorage;
+}
+
+void PresetManager::MarkShardDirty(std::string_view presetName) noexcept
+{
+    if (shardedStorage)
+    {
+        dirtyShards |= PresetShards::MaskOf(PresetShards::ShardOf(presetName));
+    }
+}
+
+void PresetManager::MarkUnsaved(std::string_view presetName)
+{
+    if (trackUnsavedNames)
+    {
+        unsavedNames.emplace(presetName);
+    }
+}
+
+void PresetManager::ForgetWrittenNames() noexcept
+{
+    if (!savingNames.empty() && storageWriter->GetWrittenSequence() >= savingSequence)
+    {
+        savingNames.clear();
+    }
+}
+
+void PresetManager::JournalUpsert(std::string &records, const CustomPreset &preset) const
+{
+    PresetJournal::AppendUpsert(records, preset, *labelPool);
+}
+
+void PresetManager::JournalRemoval(std::string &records, const std::string &name) const
+{
+    PresetJournal::AppendRemoval(records, name);
+}
+
+void PresetManager::SaveJournal(std::string records, std::size_t recordCount)
+{
+    EXP_PRESETS_PROFILE_COUNT(JournalRecords, recordCount);
+    journalRecordCount += recordCount;
+    // Compact once replaying the journal would cost a noticeable share of a full load.
+    if (journalRecordCount > std::max<std::size_t>(256, presets.size() / 4))
     {
-        cvarManager->log("ExpandedPresets: No stored presets were found, importing from presets.data instead.");
-        RefreshFromVanillaPresets();
         SaveToStorage();
         return;
     }
 
-    std::string line;
-    while (std::getline(file, line))
+    storageWriter->ScheduleJournal(std::move(records));
+}
+
+void PresetManager::FlushStorage() const
+{
+    storageWriter->Flush();
+}
+
+void PresetManager::SetSaveDebounceWindow(std::chrono::milliseconds window) const
+{
+    storageWriter->SetDebounceWindow(window);
+}
+
+bool PresetManager::StartCatalogImport(CatalogImportCallback onMerged)
+{
+    return StartCatalogImport(std::vector<std::filesystem::path>{catalogFilePath}, std::move(onMerged));
+}
+
+bool PresetManager::StartCatalogImport(std::vector<std::filesystem::path> catalogPaths, CatalogImportCallback onMerged)
+{
+    if (catalogImporter)
     {
-        line = TrimWhitespace(line);
-        if (line.empty() || line.front() == '#')
+        host.log("ExpandedPresets: A catalog import is already running.");
+        return false;
+    }
+
+    const bool started = StartImporter(catalogImporter, std::make_shared<PresetCatalogImporter>(catalogPaths),
+                                       [this, onMerged = std::move(onMerged)](PresetCatalogImporter &importer)
+                                       {
+                                           MergeCatalog(importer, onMerged);
+                                       });
+    if (!started)
+    {
+        std::string files;
+        for (const auto &path : catalogPaths)
         {
-            continue;
+            files += (files.empty() ? "" : ", ") + path.string();
         }
+        host.log("ExpandedPresets: Could not open catalog file: " + files);
+    }
+    return started;
+}
+
+bool PresetManager::StartImporter(std::shared_ptr<PresetCatalogImporter> &slot, std::shared_ptr<PresetCatalogImporter> importer,
+                                  std::function<void(PresetCatalogImporter &)> onParsed)
+{
+    if (!host.post)
+    {
+        return false;
+    }
+
+    const std::weak_ptr<PresetCatalogImporter> weakImporter = importer;
+    const bool started = importer->Start(host.workers, [this, &slot, weakImporter, post = host.post, onParsed = std::move(onParsed)]
+                                                       {
+                                                           // Runs on a worker; the merge itself must happen on the game thread.
+                                                           post([this, &slot, weakImporter, onParsed]
+                                                                {
+                                                                    // The manager owns the importer, so an expired importer
+                                                                    // means `this` and `slot` must not be touched.
+                                                                    const auto importer = weakImporter.lock();
+                                                                    if (!importer || importer != slot)
+                                                                    {
+                                                                        return;
+                                                                    }
+                                                                    onParsed(*importer);
+                                                                });
+                                                       });
+    if (started)
+    {
+        slot = std::move(importer);
+    }
+    return started;
+}
+
+std::optional<float> PresetManager::GetCatalogImportProgress() const
+{
+    if (!catalogImporter)
+    {
+        return std::nullopt;
+    }
+
+    return catalogImporter->Progress();
+}
 
-        const auto tokens = TokenizeLine(line);
-        if (tokens.size() < 2)
+const std::filesystem::path &PresetManager::GetCatalogFilePath() const noexcept
+{
+    return catalogFilePath;
+}
+
+std::filesystem::path PresetManager::GetDataFolder() const
+{
+    return storageFilePath.parent_path();
+}
+
+bool PresetManager::StartPackExport(const std::filesystem::path &packPath, PackExportCallback onWritten)
+{
+    if (!host.post)
+    {
+        return false;
+    }
+    if (packExportRunning)
+    {
+        host.log("ExpandedPresets: A pack export is already running.");
+        return false;
+    }
+
+    packExportRunning = true;
+    auto task = [this, snapshot = GetSnapshot(), labels = labelPool, packPath, alive = std::weak_ptr<const bool>(aliveToken),
+                 post = host.post, onWritten = std::move(onWritten)]
+    {
+        std::optional<PresetPack::WriteSummary> summary;
         {
-            continue;
+            EXP_PRESETS_PROFILE_SCOPE(PackExport);
+            summary = PresetPack::Write(packPath, *snapshot, *labels);
         }
+        post([this, alive, summary, onWritten]
+             {
+                 if (alive.expired())
+                 {
+                     return;
+                 }
+                 packExportRunning = false;
+                 if (onWritten)
+                 {
+                     onWritten(summary);
+                 }
+             });
+    };
+    if (host.workers)
+    {
+        host.workers->Submit(std::move(task));
+    }
+    else
+    {
+        task();
+    }
+    return true;
+}
+
+std::optional<PresetManager::PackImportSummary> PresetManager::ImportPack(const std::filesystem::path &packPath)
+{
+    EXP_PRESETS_PROFILE_SCOPE(PackImport);
+    const auto start = std::chrono::steady_clock::now();
+
+    PresetPack::Reader reader(packPath);
+    if (!reader.IsOpen())
+    {
+        host.log("ExpandedPresets: Not a preset pack: " + packPath.string());
+        return std::nullopt;
+    }
+
+    // Bounded so a damaged header cannot reserve an absurd amount of memory.
+    const auto incoming = std::min<std::size_t>(reader.GetDeclaredPresetCount(), 1u << 20);
+    presets.reserve(presets.size() + incoming);
+    presetIndexByName.reserve(presets.size() + incoming);
+    presetIds.reserve(presets.size() + incoming);
+    decodedLoadouts.reserve(presets.size() + incoming);
+    loadoutHashes.reserve(presets.size() + incoming);
+    searchIndex.Reserve(presets.size() + incoming);
+
+    PackImportSummary summary;
+    auto status = PresetPack::Reader::Status::Block;
+    while (status == PresetPack::Reader::Status::Block)
+    {
+        status = reader.ReadBlock([this, &summary](const PresetPack::Entry &entry)
+                                  {
+                                      auto preset = NewArenaPreset();
+                                      preset.name.assign(entry.name);
+                                      preset.loadoutCode.assign(entry.loadoutCode);
+                                      auto &customization = preset.customization;
+                                      customization.primaryColor = entry.primaryColor;
+                                      customization.accentColor = entry.accentColor;
+                                      customization.carLabel = labelPool->Intern(entry.carLabel, defaultCarLabelId);
+                                      customization.decalLabel = labelPool->Intern(entry.decalLabel, defaultDecalLabelId);
+                                      customization.wheelsLabel = labelPool->Intern(entry.wheelsLabel, defaultWheelsLabelId);
+                                      customization.paintFinishMatte = entry.paintFinishMatte;
+                                      customization.paintFinishPearlescent = entry.paintFinishPearlescent;
+
+                                      const auto loadout = entry.loadoutBytes.empty() ? LoadoutCode::Decode(preset.loadoutCode)
+                                                                                      : LoadoutCode::DecodeBytes(entry.loadoutBytes);
+                                      const auto previousCount = presets.size();
+                                      StorePreset(std::move(preset), loadout);
+                                      ++(presets.size() > previousCount ? summary.added : summary.updated);
+                                  });
+    }
+
+    summary.complete = status == PresetPack::Reader::Status::End;
+    summary.time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    return summary;
+}
 
-        CustomPreset preset;
-        preset.name = TrimWhitespace(tokens[0]);
-        preset.loadoutCode = TrimWhitespace(tokens[1]);
+void PresetManager::MergeCatalog(PresetCatalogImporter &importer, const CatalogImportCallback &onMerged)
+{
+    EXP_PRESETS_PROFILE_SCOPE(CatalogMerge);
+    const auto start = std::chrono::steady_clock::now();
+
+    CatalogImportSummary summary;
+    summary.rejectedLines = importer.RejectedLineCount();
+    summary.parseTime = importer.ParseDuration();
 
-        if (tokens.size() >= 3)
+    const auto incoming = importer.EntryCount();
+    presets.reserve(presets.size() + incoming);
+    presetIndexByName.reserve(presets.size() + incoming);
+    decodedLoadouts.reserve(presets.size() + incoming);
+    searchIndex.Reserve(presets.size() + incoming);
+
+    for (auto &chunk : importer.Chunks())
+    {
+        for (auto &entry : chunk)
         {
-            preset.customization.primaryColor = ParseColorToken(tokens[2]);
+            auto &customization = entry.preset.customization;
+            customization.carLabel = labelPool->Intern(entry.carLabel, defaultCarLabelId);
+            customization.decalLabel = labelPool->Intern(entry.decalLabel, defaultDecalLabelId);
+            customization.wheelsLabel = labelPool->Intern(entry.wheelsLabel, defaultWheelsLabelId);
+
+            const auto previousCount = presets.size();
+            AddOrUpdatePreset(std::move(entry.preset));
+            if (presets.size() > previousCount)
+            {
+                ++summary.added;
+                summary.duplicates += GetDuplicateCount(previousCount) > 1;
+            }
+            else
+            {
+                ++summary.updated;
+            }
         }
-        if (tokens.size() >= 4)
+    }
+
+    summary.mergeTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    // The label views above point into the importer's mapping, so only drop it once the merge is done.
+    catalogImporter.reset();
+    if (onMerged)
+    {
+        onMerged(summary);
+    }
+}
+
+void PresetManager::StartWatchingFiles(ExternalChangeCallback onApplied)
+{
+    externalChangeCallback = std::move(onApplied);
+    if (fileWatcher || !host.post)
+    {
+        return;
+    }
+
+    fileWatcher = std::make_unique<PresetFileWatcher>(
+        std::vector<std::filesystem::path>{storageFilePath, vanillaPresetsPath},
+        [this, alive = std::weak_ptr<const bool>(aliveToken), post = host.post](const std::filesystem::path &file)
+        {
+            if (file == storageFilePath)
+            {
+                // Our own saves leave exactly the stamp the writer recorded; anything else is an
+                // external edit. The settle delay gives the writer time to record it.
+                const auto current = PresetBinaryCache::StatSource(storageFilePath);
+                const auto written = storageWriter->GetLastWrittenStamp();
+                if (current && written && current->size == written->size && current->modifiedTime == written->modifiedTime)
+                {
+                    return;
+                }
+            }
+
+            post([this, alive, file]
+                 {
+                     if (!alive.expired())
+                     {
+                         OnWatchedFileChanged(file);
+                     }
+                 });
+        });
+
+    if (!fileWatcher->IsWatching())
+    {
+        host.log("ExpandedPresets: Could not watch the preset files for changes.");
+        fileWatcher.reset();
+    }
+}
+
+void PresetManager::StopWatchingFiles()
+{
+    fileWatcher.reset();
+    storageReloader.reset();
+    storageReloadQueued = false;
+}
+
+bool PresetManager::IsWatchingFiles() const noexcept
+{
+    return fileWatcher != nullptr;
+}
+
+void PresetManager::OnWatchedFileChanged(const std::filesystem::path &file)
+{
+    if (!fileWatcher)
+    {
+        return;
+    }
+
+    if (file == vanillaPresetsPath)
+    {
+        const auto merged = MergeVanillaPresets();
+        if ((merged.added != 0 || merged.updated != 0) && externalChangeCallback)
         {
-            preset.customization.accentColor = ParseColorToken(tokens[3]);
+            externalChangeCallback(file, ExternalChangeSummary{merged.added, merged.updated, 0});
         }
-        if (tokens.size() >= 5)
+        return;
+    }
+
+    // The shards are not watched; in that layout the cfg is gone and its removal means nothing.
+    if (file == storageFilePath && !shardedStorage)
+    {
+        if (storageReloader)
         {
-            preset.customization.carLabel = TrimWhitespace(tokens[4]);
+            storageReloadQueued = true;
+            return;
         }
-        if (tokens.size() >= 6)
+        ReloadChangedStorage();
+    }
+}
+
+void PresetManager::ReloadChangedStorage()
+{
+    const bool started = StartImporter(storageReloader, std::make_shared<PresetCatalogImporter>(storageFilePath),
+                                       [this](PresetCatalogImporter &reloader)
+                                       {
+                                           const auto summary = ApplyReloadedStorage(reloader);
+                                           storageReloader.reset();
+
+                                           if ((summary.added != 0 || summary.updated != 0 || summary.removed != 0) && externalChangeCallback)
+                                           {
+                                               externalChangeCallback(storageFilePath, summary);
+                                           }
+                                           if (storageReloadQueued)
+                                           {
+                                               storageReloadQueued = false;
+                                               ReloadChangedStorage();
+                                           }
+                                       });
+    if (!started)
+    {
+        // Deleted or locked; keep the collection in memory, the next save recreates the file.
+        host.log("ExpandedPresets: " + storageFilePath.string() + " changed but could not be read; keeping the presets in memory.");
+    }
+}
+
+PresetManager::ExternalChangeSummary PresetManager::ApplyReloadedStorage(PresetCatalogImporter &reloader)
+{
+    // Removing one preset shifts everything behind it; past this many a rebuild is cheaper.
+    constexpr std::size_t maxIndividualRemovals = 64;
+
+    ExternalChangeSummary summary;
+    // Entries are compared field by field, which needs every preset parsed.
+    HydrateAll();
+    // Presets changed in memory since the cfg was last written live only in the journal or in a
+    // write still on its way, so the reloaded cfg does not have them; they are neither updated
+    // nor removed here.
+    ForgetWrittenNames();
+    const auto isUnsaved = [this](std::string_view name)
+    {
+        return unsavedNames.count(name) != 0 || savingNames.count(name) != 0;
+    };
+    std::vector<bool> listed(presets.size(), false);
+    if (!unsavedNames.empty() || !savingNames.empty())
+    {
+        for (std::size_t i = 0; i < presets.size(); ++i)
         {
-            preset.customization.decalLabel = TrimWhitespace(tokens[5]);
+            listed[i] = isUnsaved(presets[i].name);
         }
-        if (tokens.size() >= 7)
+    }
+    // What the reload stores is what the cfg holds.
+    trackUnsavedNames = false;
+    for (auto &chunk : reloader.Chunks())
+    {
+        for (auto &entry : chunk)
         {
-            preset.customization.wheelsLabel = TrimWhitespace(tokens[6]);
+            if (isUnsaved(entry.preset.name))
+            {
+                continue;
+            }
+            auto &customization = entry.preset.customization;
+            customization.carLabel = labelPool->Intern(entry.carLabel, defaultCarLabelId);
+            customization.decalLabel = labelPool->Intern(entry.decalLabel, defaultDecalLabelId);
+            customization.wheelsLabel = labelPool->Intern(entry.wheelsLabel, defaultWheelsLabelId);
+
+            const auto index = FindPresetIndex(std::string(entry.preset.name));
+            if (index == presets.size())
+            {
+                AddOrUpdatePreset(std::move(entry.preset));
+                listed.push_back(true);
+                ++summary.added;
+                continue;
+            }
+
+            listed[index] = true;
+            if (StoredPresetDiffers(presets[index], entry.preset))
+            {
+                AddOrUpdatePreset(std::move(entry.preset));
+                ++summary.updated;
+            }
         }
-        if (tokens.size() >= 8)
+    }
+
+    summary.removed = static_cast<std::size_t>(std::count(listed.begin(), listed.end(), false));
+    if (summary.removed > maxIndividualRemovals)
+    {
+        RebuildPresets(listed);
+    }
+    else if (summary.removed != 0)
+    {
+        std::vector<std::string> removedNames;
+        for (std::size_t i = 0; i < listed.size(); ++i)
         {
-            preset.customization.paintFinishMatte = tokens[7] == "1" || tokens[7] == "true" || tokens[7] == "matte";
+            if (!listed[i])
+            {
+                removedNames.emplace_back(presets[i].name);
+            }
         }
-        if (tokens.size() >= 9)
+        for (const auto &name : removedNames)
         {
-            preset.customization.paintFinishPearlescent = tokens[8] == "1" || tokens[8] == "true" || tokens[8] == "pearlescent";
+            RemovePreset(name);
         }
+    }
+    trackUnsavedNames = true;
+
+    if (summary.added == 0 && summary.updated == 0 && summary.removed == 0)
+    {
+        return summary;
+    }
 
-        AddOrUpdatePreset(preset);
+    // The cfg and journal already hold this state; only the binary cache is stale. If our own
+    // write has not landed yet it would put an older snapshot over the edit, and a cache-only
+    // write would drop the presets it carries, so write the merged collection in full instead.
+    auto source = PresetBinaryCache::StatSource(storageFilePath);
+    if (source)
+    {
+        source->contentHash = PresetBinaryCache::HashContents(reloader.Contents());
+    }
+    if (!savingNames.empty() || !source || !storageWriter->ScheduleCacheRefresh(GetSnapshot(), *source))
+    {
+        SaveToStorage();
     }
+    return summary;
 }
 
-void PresetManager::SaveToStorage() const
+const CustomPresetCollection &PresetManager::GetPresets() const noexcept
 {
-    EnsureStorageDirectory();
-    std::ofstream file(storageFilePath, std::ios::trunc);
-    if (!file)
+    return presets;
+}
+
+PresetSnapshotPtr PresetManager::GetSnapshot()
+{
+    if (publishedSnapshot && publishedSnapshot->GetRevision() == revision)
     {
-        cvarManager->log("ExpandedPresets: Failed to open storage file for writing: " + storageFilePath.string());
-        return;
+        return publishedSnapshot;
     }
 
-    for (const auto &preset : presets)
+    EXP_PRESETS_PROFILE_SCOPE(PublishSnapshot);
+    HydrateAll();
+    publishedSnapshot = PresetSnapshot::Publish(publishedSnapshot.get(), presets, snapshotDirtyChunks, revision);
+    EXP_PRESETS_PROFILE_COUNT(SnapshotChunksCopied, publishedSnapshot->GetChunks().size() - publishedSnapshot->GetSharedChunkCount());
+    snapshotDirtyChunks.assign(publishedSnapshot->GetChunks().size(), false);
+    return publishedSnapshot;
+}
+
+const CustomPreset &PresetManager::GetPreset(std::size_t index)
+{
+    if (unparsedCount != 0)
     {
-        file << preset.name << '|'
-             << preset.loadoutCode << '|'
-             << SerializeColorToken(preset.customization.primaryColor) << '|'
-             << SerializeColorToken(preset.customization.accentColor) << '|'
-             << preset.customization.carLabel << '|'
-             << preset.customization.decalLabel << '|'
-             << preset.customization.wheelsLabel << '|'
-             << (preset.customization.paintFinishMatte ? '1' : '0') << '|'
-             << (preset.customization.paintFinishPearlescent ? '1' : '0')
-             << '\n';
+        HydratePreset(index);
     }
+    return presets[index];
 }
 
-const CustomPresetCollection &PresetManager::GetPresets() const noexcept
+std::size_t PresetManager::GetPresetCount() const noexcept
 {
-    return presets;
+    return presets.size();
 }
 
-CustomPresetCollection &PresetManager::GetPresets() noexcept
+const PresetHotColumns &PresetManager::GetHotColumns() const noexcept
 {
-    return presets;
+    return hotColumns;
+}
+
+std::uint64_t PresetManager::GetRevision() const noexcept
+{
+    return revision;
 }
 
-std::optional<CustomPreset> PresetManager::FindPreset(const std::string &name) const
+std::optional<CustomPreset> PresetManager::FindPreset(const std::string &name)
 {
-    const auto it = std::find_if(presets.begin(), presets.end(),
-                                 [&name](const CustomPreset &preset)
-                                 {
-                                     return preset.name == name;
-                                 });
-    if (it == presets.end())
+    const auto index = FindPresetIndex(name);
+    if (index >= presets.size())
     {
         return std::nullopt;
     }
 
-    return *it;
+    return GetPreset(index);
 }
 
 std::size_t PresetManager::FindPresetIndex(const std::string &name) const
 {
-    const auto it = std::find_if(presets.begin(), presets.end(),
-                                 [&name](const CustomPreset &preset)
-                                 {
-                                     return preset.name == name;
-                                 });
-    if (it == presets.end())
+    const auto it = presetIndexByName.find(name);
+    if (it == presetIndexByName.end())
     {
         return presets.size();
     }
 
-    return static_cast<std::size_t>(std::distance(presets.begin(), it));
+    return it->second;
 }
 
-void PresetManager::AddOrUpdatePreset(const CustomPreset &preset)
+PresetId PresetManager::GetPresetId(std::size_t index) const noexcept
 {
-    const auto index = FindPresetIndex(preset.name);
-    if (index >= presets.size())
-    {
-        presets.push_back(preset);
-    }
-    else
+    return index < presetIds.size() ? presetIds[index] : invalidPresetId;
+}
+
+std::size_t PresetManager::FindPresetIndexById(PresetId id) const
+{
+    const auto it = slotById.find(id);
+    return it == slotById.end() ? presets.size() : it->second;
+}
+
+std::vector<PresetColorIndex::Neighbor> PresetManager::FindSimilarColors(const PresetPaintColor &primary, const PresetPaintColor &accent,
+                                                                        std::size_t count, PresetId excludedId) const
+{
+    const auto excluded = FindPresetIndexById(excludedId);
+    return colorIndex.FindNearest(primary, accent, count, excluded < presets.size() ? excluded : PresetColorIndex::noSlot);
+}
+
+std::vector<std::size_t> PresetManager::FilterPresets(std::string_view filter)
+{
+    // The empty filter lists everything and needs nothing but the names.
+    if (!filter.empty())
     {
-        presets[index] = preset;
+        HydrateAll();
     }
+    return searchIndex.Search(filter);
 }
 
-void PresetManager::RemovePreset(const std::string &name)
+void PresetManager::RefineFilter(std::string_view filter, std::vector<std::size_t> &matches)
 {
-    const auto index = FindPresetIndex(name);
-    if (index >= presets.size())
+    HydrateAll();
+    searchIndex.Refine(filter, matches);
+}
+
+std::vector<PresetQueryMatch> PresetManager::QueryPresets(const PresetQuery &query)
+{
+    HydrateAll();
+    return searchIndex.Query(query);
+}
+
+void PresetManager::AddOrUpdatePreset(const CustomPreset &preset)
+{
+    AddOrUpdatePreset(CustomPreset{preset});
+}
+
+void PresetManager::AddOrUpdatePreset(CustomPreset &&preset)
+{
+    // Edits that keep the loadout code, like recolouring, reuse the cached decode.
+    const auto it = presetIndexByName.find(std::string_view(preset.name));
+    if (it != presetIndexByName.end() && presets[it->second].loadoutCode == preset.loadoutCode)
     {
+        const auto loadout = decodedLoadouts[it->second];
+        StorePreset(std::move(preset), loadout);
         return;
     }
-
-    presets.erase(presets.begin() + static_cast<std::ptrdiff_t>(index));
+    const auto loadout = LoadoutCode::Decode(preset.loadoutCode);
+    StorePreset(std::move(preset), loadout);
 }
 
-std::filesystem::path PresetManager::ResolveDataFolder(const std::shared_ptr<GameWrapper> &gameWrapper)
+void PresetManager::StorePreset(CustomPreset &&preset, const LoadoutCode::Loadout &loadout)
 {
-    std::filesystem::path dataFolder{"./bakkesmod/data"};
+    const auto hash = LoadoutCode::ContentHash(loadout, preset.loadoutCode);
+    StorePreset(std::move(preset), loadout, hash);
+}
 
-    if (gameWrapper)
+void PresetManager::StorePreset(CustomPreset &&preset, const LoadoutCode::Loadout &loadout, std::uint64_t hash)
+{
+    ++revision;
+    MarkShardDirty(preset.name);
+    MarkUnsaved(preset.name);
+    const auto [it, inserted] = presetIndexByName.try_emplace(std::string(preset.name), presets.size());
+    const auto index = it->second;
+    MarkSnapshotDirty(index, index + 1);
+    if (inserted)
     {
-        try
+        presets.push_back(MoveIntoArena(std::move(preset)));
+        AssignNewPresetId(index);
+        decodedLoadouts.push_back(loadout);
+        loadoutHashes.push_back(hash);
+        if (!unparsedLines.empty())
         {
-            const auto folder = gameWrapper->GetDataFolder();
-            if (!folder.empty())
-            {
-                dataFolder = folder;
-            }
+            unparsedLines.emplace_back();
         }
-        catch (...)
+    }
+    else
+    {
+        presets[index] = std::move(preset);
+        decodedLoadouts[index] = loadout;
+        // An unparsed preset being replaced was never counted under a loadout hash.
+        if (!ForgetUnparsedLine(index))
         {
-            // If the BakkesMod SDK we are linked against does not provide GetDataFolder
-            // just keep the fallback path instead of crashing.
+            ForgetLoadoutHash(loadoutHashes[index]);
         }
+        loadoutHashes[index] = hash;
     }
+    ++presetCountByLoadoutHash[hash];
+    searchIndex.Assign(index, presets[index]);
+    hotColumns.Assign(index, presets[index]);
+    colorIndex.Assign(index, presets[index]);
+}
+
+void PresetManager::AddOrUpdatePreset(const EditablePreset &preset)
+{
+    AddOrUpdatePreset(FromEditable(preset));
+}
 
-    dataFolder /= "ExpandedPresets";
-    return dataFolder;
+CustomPreset PresetManager::FromEditable(const EditablePreset &preset)
+{
+    const auto &source = preset.customization;
+    CustomPreset stored;
+    stored.name.assign(preset.name);
+    stored.loadoutCode.assign(preset.loadoutCode);
+    stored.customization.primaryColor = source.primaryColor;
+    stored.customization.accentColor = source.accentColor;
+    stored.customization.carLabel = labelPool->Intern(source.carLabel, defaultCarLabelId);
+    stored.customization.decalLabel = labelPool->Intern(source.decalLabel, defaultDecalLabelId);
+    stored.customization.wheelsLabel = labelPool->Intern(source.wheelsLabel, defaultWheelsLabelId);
+    stored.customization.paintFinishMatte = source.paintFinishMatte;
+    stored.customization.paintFinishPearlescent = source.paintFinishPearlescent;
+    return stored;
 }
 
-std::filesystem::path PresetManager::ResolveVanillaPresetPath(const std::shared_ptr<GameWrapper> &gameWrapper)
+void PresetManager::RemovePreset(const std::string &name)
 {
-    std::filesystem::path path{"./bakkesmod/data/presets.data"};
-    if (gameWrapper)
+    const auto it = presetIndexByName.find(name);
+    if (it == presetIndexByName.end())
     {
-        try
-        {
-            const auto folder = gameWrapper->GetDataFolder();
-            if (!folder.empty())
-            {
-                path = std::filesystem::path(folder) / "presets.data";
-            }
-        }
-        catch (...)
+        return;
+    }
+
+    ++revision;
+    MarkShardDirty(name);
+    MarkUnsaved(name);
+    const auto index = it->second;
+    const auto last = presets.size() - 1;
+    presetIndexByName.erase(it);
+    slotById.erase(presetIds[index]);
+    if (!ForgetUnparsedLine(index))
+    {
+        ForgetLoadoutHash(loadoutHashes[index]);
+    }
+
+    // Swap-and-pop: the last preset takes over the freed slot, so a removal touches two slots of
+    // every column instead of shifting everything behind it.
+    if (index != last)
+    {
+        presets[index] = std::move(presets[last]);
+        decodedLoadouts[index] = decodedLoadouts[last];
+        loadoutHashes[index] = loadoutHashes[last];
+        presetIds[index] = presetIds[last];
+        if (!unparsedLines.empty())
         {
-            // Fall back to default path.
+            unparsedLines[index] = unparsedLines[last];
         }
+        presetIndexByName.find(std::string_view(presets[index].name))->second = index;
+        slotById[presetIds[index]] = index;
+    }
+    presets.pop_back();
+    decodedLoadouts.pop_back();
+    loadoutHashes.pop_back();
+    presetIds.pop_back();
+    if (!unparsedLines.empty())
+    {
+        unparsedLines.pop_back();
+    }
+    searchIndex.SwapRemove(index);
+    hotColumns.SwapRemove(index);
+    colorIndex.SwapRemove(index);
+    MarkSnapshotDirty(index, index + 1);
+    MarkSnapshotDirty(last, last + 1);
+}
+
+void PresetManager::EditPreset(const EditablePreset &preset)
+{
+    EditStep step{preset.name, FindPreset(preset.name), FromEditable(preset)};
+    if (step.before == step.after)
+    {
+        return;
     }
+    ApplyEditState(step.name, step.after);
+    RecordUndoStep(std::move(step));
+}
 
-    return path;
+bool PresetManager::DeletePreset(const std::string &name)
+{
+    EditStep step{name, FindPreset(name), std::nullopt};
+    if (!step.before)
+    {
+        return false;
+    }
+    ApplyEditState(step.name, step.after);
+    RecordUndoStep(std::move(step));
+    return true;
 }
 
-void PresetManager::EnsureStorageDirectory() const
+std::optional<std::string> PresetManager::Undo()
 {
-    const auto directory = storageFilePath.parent_path();
-    if (!directory.empty() && !std::filesystem::exists(directory))
+    if (undoSteps.empty())
     {
-        std::filesystem::create_directories(directory);
+        return std::nullopt;
+    }
+
+    auto step = std::move(undoSteps.back());
+    undoSteps.pop_back();
+    ApplyEditState(step.name, step.before);
+    auto name = step.name;
+    redoSteps.push_back(std::move(step));
+    return name;
+}
+
+std::optional<std::string> PresetManager::Redo()
+{
+    if (redoSteps.empty())
+    {
+        return std::nullopt;
+    }
+
+    auto step = std::move(redoSteps.back());
+    redoSteps.pop_back();
+    ApplyEditState(step.name, step.after);
+    auto name = step.name;
+    undoSteps.push_back(std::move(step));
+    return name;
+}
+
+bool PresetManager::CanUndo() const noexcept
+{
+    return !undoSteps.empty();
+}
+
+bool PresetManager::CanRedo() const noexcept
+{
+    return !redoSteps.empty();
+}
+
+void PresetManager::ApplyEditState(const std::string &name, const std::optional<CustomPreset> &state)
+{
+    std::string records;
+    if (state)
+    {
+        JournalUpsert(records, *state);
+        AddOrUpdatePreset(*state);
+    }
+    else
+    {
+        JournalRemoval(records, name);
+        RemovePreset(name);
     }
+    SaveJournal(std::move(records), 1);
 }
 
-std::vector<std::string> PresetManager::TokenizeLine(const std::string &line)
+void PresetManager::RecordUndoStep(EditStep step)
 {
-    std::vector<std::string> tokens;
-    std::stringstream stream(line);
-    std::string token;
-    while (std::getline(stream, token, '|'))
+    if (undoSteps.size() == maxUndoSteps)
     {
-        tokens.push_back(token);
+        undoSteps.erase(undoSteps.begin());
     }
+    undoSteps.push_back(std::move(step));
+    redoSteps.clear();
+}
+
+const LoadoutCode::Loadout &PresetManager::GetDecodedLoadout(std::size_t index) const noexcept
+{
+    return decodedLoadouts[index];
+}
 
-    return tokens;
+std::size_t PresetManager::GetDuplicateCount(std::size_t index) const noexcept
+{
+    const auto it = presetCountByLoadoutHash.find(loadoutHashes[index]);
+    return it == presetCountByLoadoutHash.end() ? 0 : it->second;
 }
 
-PresetPaintColor PresetManager::ParseColorToken(const std::string &token)
+std::size_t PresetManager::CollapseDuplicates()
 {
-    PresetPaintColor color{};
+    HydrateAll();
+    const auto removed = presets.size() - presetCountByLoadoutHash.size();
+    if (removed == 0)
+    {
+        return 0;
+    }
+
+    std::unordered_set<std::uint64_t> seen;
+    seen.reserve(presetCountByLoadoutHash.size());
+    std::vector<bool> keep(presets.size());
+    for (std::size_t i = 0; i < presets.size(); ++i)
+    {
+        keep[i] = seen.insert(loadoutHashes[i]).second;
+    }
+    RebuildPresets(keep);
+    return removed;
+}
 
-    std::stringstream stream(token);
-    std::string component;
-    std::size_t index = 0;
-    while (std::getline(stream, component, ','))
+void PresetManager::RebuildPresets(const std::vector<bool> &keep)
+{
+    // The kept presets are stored again as complete records.
+    HydrateAll();
+    CustomPresetCollection keptPresets;
+    std::vector<LoadoutCode::Loadout> keptLoadouts;
+    std::vector<PresetId> keptIds;
+    const auto keptCount = static_cast<std::size_t>(std::count(keep.begin(), keep.end(), true));
+    keptPresets.reserve(keptCount);
+    keptLoadouts.reserve(keptCount);
+    keptIds.reserve(keptCount);
+    for (std::size_t i = 0; i < presets.size(); ++i)
     {
-        float value = 0.0f;
-        try
+        if (keep[i])
         {
-            value = std::stof(component);
+            keptPresets.push_back(std::move(presets[i]));
+            keptLoadouts.push_back(decodedLoadouts[i]);
+            keptIds.push_back(presetIds[i]);
         }
-        catch (...)
+        else
         {
-            value = 0.0f;
+            MarkShardDirty(presets[i].name);
+            MarkUnsaved(presets[i].name);
         }
+    }
 
-        value = std::max(0.0f, value);
-        const float normalized = value > 1.0f ? value / 255.0f : value;
-        switch (index)
-        {
-        case 0: color.r = normalized; break;
-        case 1: color.g = normalized; break;
-        case 2: color.b = normalized; break;
-        default: break;
-        }
-        ++index;
+    // Only the shards that lost a preset change; the kept ones are stored back unchanged.
+    const auto changedShards = dirtyShards;
+    // Edit steps hold their own copies of the presets they touched, so the undo history outlives
+    // the rebuild; only full reloads drop it.
+    auto keptUndoSteps = std::move(undoSteps);
+    auto keptRedoSteps = std::move(redoSteps);
+    // The kept strings still live in the arena and move back without being copied.
+    ClearPresets(true);
+    undoSteps = std::move(keptUndoSteps);
+    redoSteps = std::move(keptRedoSteps);
+    presets.reserve(keptCount);
+    presetIndexByName.reserve(keptCount);
+    decodedLoadouts.reserve(keptCount);
+    loadoutHashes.reserve(keptCount);
+    searchIndex.Reserve(keptCount);
+    // The kept presets are stored back unchanged.
+    const bool tracking = trackUnsavedNames;
+    trackUnsavedNames = false;
+    for (std::size_t i = 0; i < keptCount; ++i)
+    {
+        StorePreset(std::move(keptPresets[i]), keptLoadouts[i]);
+    }
+    trackUnsavedNames = tracking;
+    // The kept presets are still the same presets to anyone holding their ids.
+    slotById.clear();
+    for (std::size_t i = 0; i < keptCount; ++i)
+    {
+        presetIds[i] = keptIds[i];
+        slotById.emplace(keptIds[i], i);
+    }
+    dirtyShards = changedShards;
+}
+
+void PresetManager::ForgetLoadoutHash(std::uint64_t hash)
+{
+    const auto it = presetCountByLoadoutHash.find(hash);
+    if (it != presetCountByLoadoutHash.end() && --it->second == 0)
+    {
+        presetCountByLoadoutHash.erase(it);
+    }
+}
+
+std::string_view PresetManager::DetectCarLabel(std::string_view loadoutCode) noexcept
+{
+    const auto loadout = LoadoutCode::Decode(loadoutCode);
+    const auto *body = loadout.blue.Find(LoadoutCode::Slot::Body);
+    return body ? LoadoutCode::BuiltInBodyName(body->productId) : std::string_view{};
+}
+
+PresetLabelId PresetManager::DetectedCarLabel(const LoadoutCode::Loadout &loadout, PresetLabelId fallback)
+{
+    const auto *body = loadout.blue.Find(LoadoutCode::Slot::Body);
+    const auto name = body ? LoadoutCode::BuiltInBodyName(body->productId) : std::string_view{};
+    return name.empty() ? fallback : labelPool->Intern(name, fallback);
+}
+
+const std::string &PresetManager::GetLabel(PresetLabelId id) const noexcept
+{
+    return labelPool->Resolve(id);
+}
+
+PresetLabelId PresetManager::InternLabel(std::string_view label, PresetLabelId fallback)
+{
+    return labelPool->Intern(label, fallback);
+}
+
+const PresetLabelPool &PresetManager::GetLabelPool() const noexcept
+{
+    return *labelPool;
+}
+
+PresetStringArena::Stats PresetManager::GetStringArenaStats() const noexcept
+{
+    return stringArena.GetStats();
+}
+
+EditablePreset PresetManager::ToEditable(const CustomPreset &preset) const
+{
+    const auto &source = preset.customization;
+    EditablePreset editable;
+    editable.name.assign(preset.name);
+    editable.loadoutCode.assign(preset.loadoutCode);
+    editable.customization.primaryColor = source.primaryColor;
+    editable.customization.accentColor = source.accentColor;
+    editable.customization.carLabel = labelPool->Resolve(source.carLabel);
+    editable.customization.decalLabel = labelPool->Resolve(source.decalLabel);
+    editable.customization.wheelsLabel = labelPool->Resolve(source.wheelsLabel);
+    editable.customization.paintFinishMatte = source.paintFinishMatte;
+    editable.customization.paintFinishPearlescent = source.paintFinishPearlescent;
+    return editable;
+}
+
+void PresetManager::ClearPresets(bool keepStrings)
+{
+    ++revision;
+    dirtyShards = PresetShards::allShards;
+    // Nothing is left to share with; readers still holding the old snapshot keep it alive.
+    publishedSnapshot.reset();
+    snapshotDirtyChunks.clear();
+    presets.clear();
+    presetIndexByName.clear();
+    presetIds.clear();
+    slotById.clear();
+    decodedLoadouts.clear();
+    loadoutHashes.clear();
+    presetCountByLoadoutHash.clear();
+    searchIndex.Clear();
+    hotColumns.Clear();
+    colorIndex.Clear();
+    unparsedLines.clear();
+    unparsedCount = 0;
+    lazyStorageFile.Close();
+    undoSteps.clear();
+    redoSteps.clear();
+    if (!keepStrings)
+    {
+        stringArena.Release();
+    }
+}
+
+void PresetManager::AssignNewPresetId(std::size_t index)
+{
+    const auto id = nextPresetId++;
+    presetIds.push_back(id);
+    slotById.emplace(id, index);
+}
+
+void PresetManager::MarkSnapshotDirty(std::size_t first, std::size_t last)
+{
+    if (first >= last)
+    {
+        return;
+    }
+    const auto lastChunk = (last - 1) / PresetSnapshot::chunkSize;
+    if (snapshotDirtyChunks.size() <= lastChunk)
+    {
+        snapshotDirtyChunks.resize(lastChunk + 1, false);
     }
+    std::fill(snapshotDirtyChunks.begin() + static_cast<std::ptrdiff_t>(first / PresetSnapshot::chunkSize),
+              snapshotDirtyChunks.begin() + static_cast<std::ptrdiff_t>(lastChunk + 1), true);
+}
 
-    return color;
+CustomPreset PresetManager::NewArenaPreset()
+{
+    return CustomPreset{PresetString(&stringArena), PresetString(&stringArena)};
+}
+
+CustomPreset PresetManager::MoveIntoArena(CustomPreset &&preset)
+{
+    return CustomPreset{PresetString(std::move(preset.name), &stringArena),
+                        PresetString(std::move(preset.loadoutCode), &stringArena),
+                        preset.customization};
 }
 
-std::string PresetManager::SerializeColorToken(const PresetPaintColor &color)
+void PresetManager::EnsureStorageDirectory() const
 {
-    std::ostringstream stream;
-    stream << std::fixed << std::setprecision(3)
-           << color.r << ','
-           << color.g << ','
-           << color.b;
-    return stream.str();
+    const auto directory = storageFilePath.parent_path();
+    if (!directory.empty() && !std::filesystem::exists(directory))
+    {
+        std::filesystem::create_directories(directory);
+    }
 }
 
+void PresetManager::LogFromAnyThread(const std::string &message) const
+{
+    if (std::this_thread::get_id() == gameThreadId || !host.post)
+    {
+        host.log(message);
+        return;
+    }
+
+    // The console is owned by the game thread; marshal background messages back onto it.
+    host.post([log = host.log, message]
+              {
+                  log(message);
+              });
+}
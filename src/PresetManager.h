@@ -1,46 +1,352 @@
 #pragma once
 
+#include "LoadoutCode.h"
+#include "MappedFile.h"
+#include "PresetCatalogImporter.h"
+#include "PresetColorIndex.h"
+#include "PresetFileWatcher.h"
+#include "PresetHotColumns.h"
+#include "PresetLabelPool.h"
+#include "PresetManagerHost.h"
+#include "PresetPack.h"
+#include "PresetSearchIndex.h"
+#include "PresetSerialization.h"
+#include "PresetShards.h"
+#include "PresetSnapshot.h"
+#include "PresetStorageWriter.h"
+#include "PresetStringArena.h"
 #include "PresetTypes.h"
 
-#include "bakkesmod/plugin/bakkesmodplugin.h"
-
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 class PresetManager
 {
 public:
-    PresetManager(std::shared_ptr<GameWrapper> gameWrapper,
-                  std::shared_ptr<CVarManagerWrapper> cvarManager);
+    struct CatalogImportSummary
+    {
+        std::size_t added{0};
+        std::size_t updated{0};
+        std::size_t rejectedLines{0};
+        // Incoming presets whose loadout was already in the library under another name.
+        std::size_t duplicates{0};
+        std::chrono::milliseconds parseTime{0};
+        std::chrono::milliseconds mergeTime{0};
+    };
+    using CatalogImportCallback = std::function<void(const CatalogImportSummary &)>;
+
+    struct VanillaMergeSummary
+    {
+        std::size_t added{0};
+        std::size_t updated{0};
+        std::size_t unchanged{0};
+        std::size_t skipped{0};
+    };
+
+    struct PackImportSummary
+    {
+        std::size_t added{0};
+        std::size_t updated{0};
+        // False when the import stopped at a damaged block; the presets read before it are kept.
+        bool complete{false};
+        std::chrono::milliseconds time{0};
+    };
+    // Gets nullopt when the pack could not be written.
+    using PackExportCallback = std::function<void(const std::optional<PresetPack::WriteSummary> &)>;
+
+    struct ExternalChangeSummary
+    {
+        std::size_t added{0};
+        std::size_t updated{0};
+        std::size_t removed{0};
+    };
+    using ExternalChangeCallback = std::function<void(const std::filesystem::path &, const ExternalChangeSummary &)>;
 
+    explicit PresetManager(PresetManagerHost host);
+
+    // Replaces the whole collection with presets.data, dropping all customizations. Car labels
+    // are filled in from the body in each loadout code where it is a known car.
     void RefreshFromVanillaPresets();
+    // Brings presets.data into the collection without clearing it: new names are added, changed
+    // loadout codes are updated in place and keep their customization, and lines that do not
+    // parse are counted as skipped. Presets still on the default car label get it from the
+    // loadout code. Only the changed presets are journaled.
+    VanillaMergeSummary MergeVanillaPresets();
+    // Loads expanded_presets.cfg (or its binary cache) or, in the sharded layout, parses every
+    // shard in parallel; then replays the journal over it.
     void LoadFromStorage();
-    void SaveToStorage() const;
+    // With lazy loading LoadFromStorage only indexes expanded_presets.cfg: each preset starts out
+    // with just its name, colours and finish flags, and the rest of its line is parsed from the
+    // mapped file the first time it is needed (GetPreset, FindPreset, searches, saves). Takes
+    // effect on the next load; the binary cache and the sharded layout always load in full.
+    void SetLazyLoading(bool enabled) noexcept;
+    [[nodiscard]] bool IsLazyLoading() const noexcept;
+    // Presets still waiting to be parsed in full.
+    [[nodiscard]] std::size_t GetUnparsedCount() const noexcept;
+    // Parses every preset lazy loading left for later.
+    void HydrateAll();
+    // Hands a snapshot to the background writer, which rewrites the cfg (or only the shards with
+    // changed presets) once the debounce window elapses and drops the journal. Call
+    // FlushStorage() when the data must be on disk before returning.
+    void SaveToStorage();
+    // Switches between expanded_presets.cfg and the sharded layout (see PresetShards) by saving
+    // the whole library in the new one. Returns false if that layout is already in use.
+    bool SetShardedStorage(bool enabled);
+    [[nodiscard]] bool IsShardedStorage() const noexcept;
+    void FlushStorage() const;
+    void SetSaveDebounceWindow(std::chrono::milliseconds window) const;
+
+    // Parses bakkesplugins_cars.cfg on worker threads, then merges it into the collection in one
+    // step on the game thread and calls `onMerged` there. Catalog entries overwrite presets with
+    // the same name. Returns false if an import is already running or the file cannot be opened.
+    bool StartCatalogImport(CatalogImportCallback onMerged);
+    // Same for any files in that format, parsed as one import; later files win on equal names.
+    bool StartCatalogImport(std::vector<std::filesystem::path> catalogPaths, CatalogImportCallback onMerged);
+    // Parse progress (0-1) of the running catalog import, or nullopt when none is running.
+    [[nodiscard]] std::optional<float> GetCatalogImportProgress() const;
+    [[nodiscard]] const std::filesystem::path &GetCatalogFilePath() const noexcept;
+    // Writes a snapshot of the collection to `packPath` (see PresetPack) on the worker pool and
+    // calls `onWritten` on the game thread. Returns false while an export is running or when
+    // host.post is unset.
+    bool StartPackExport(const std::filesystem::path &packPath, PackExportCallback onWritten);
+    // Streams a pack into the collection one block at a time; its presets overwrite those with
+    // the same name, as in a catalog import. Returns nullopt if the file is not a pack. The caller
+    // decides when to save.
+    std::optional<PackImportSummary> ImportPack(const std::filesystem::path &packPath);
+    // bakkesmod/data/ExpandedPresets, where the plugin keeps everything it writes.
+    [[nodiscard]] std::filesystem::path GetDataFolder() const;
 
+    // Watches presets.data and expanded_presets.cfg for edits made outside the plugin and applies
+    // only the presets that changed, on the game thread. presets.data goes through
+    // MergeVanillaPresets; expanded_presets.cfg is re-parsed in the background and diffed against
+    // the collection. Writes made by this manager are recognised and ignored. `onApplied` runs on
+    // the game thread after a change touched the collection.
+    void StartWatchingFiles(ExternalChangeCallback onApplied);
+    void StopWatchingFiles();
+    [[nodiscard]] bool IsWatchingFiles() const noexcept;
+
+    // Under lazy loading, presets that were not parsed in full yet only hold their name, colours
+    // and finish flags here; use GetPreset for a complete record.
     [[nodiscard]] const CustomPresetCollection &GetPresets() const noexcept;
-    [[nodiscard]] CustomPresetCollection &GetPresets() noexcept;
+    // Immutable view of the whole collection at the current revision, for readers that must not
+    // see later edits or that run on another thread. Published on demand: repeated calls at one
+    // revision return the same snapshot, and after an edit only the chunks of changed presets are
+    // copied. Parses everything lazy loading deferred.
+    [[nodiscard]] PresetSnapshotPtr GetSnapshot();
+    // The preset at `index`, parsed first if lazy loading deferred it.
+    [[nodiscard]] const CustomPreset &GetPreset(std::size_t index);
+    [[nodiscard]] std::size_t GetPresetCount() const noexcept;
+
+    // Contiguous names, packed colors and finish flags by slot, for per-frame list rendering.
+    [[nodiscard]] const PresetHotColumns &GetHotColumns() const noexcept;
 
-    std::optional<CustomPreset> FindPreset(const std::string &name) const;
+    // Loadout code of the preset at `index`, decoded once when the code was added or changed.
+    [[nodiscard]] const LoadoutCode::Loadout &GetDecodedLoadout(std::size_t index) const noexcept;
+    // Name of the car body in `loadoutCode`, or an empty view when it cannot be decoded or the
+    // body is not a known car.
+    [[nodiscard]] static std::string_view DetectCarLabel(std::string_view loadoutCode) noexcept;
+
+    // Number of presets, including the one at `index`, whose loadout has the same content. Zero
+    // for presets lazy loading has not parsed yet.
+    [[nodiscard]] std::size_t GetDuplicateCount(std::size_t index) const noexcept;
+    // Removes every preset whose loadout content matches an earlier one, keeping the first in
+    // collection order. Returns the number removed; the caller decides when to save.
+    std::size_t CollapseDuplicates();
+
+    // Incremented on every change to the collection so callers can cache derived data.
+    [[nodiscard]] std::uint64_t GetRevision() const noexcept;
+
+    std::optional<CustomPreset> FindPreset(const std::string &name);
     std::size_t FindPresetIndex(const std::string &name) const;
+    // Id of the preset at `index`, or invalidPresetId past the end. A preset keeps its id through
+    // edits, removals of other presets (which move at most one preset to another slot),
+    // CollapseDuplicates and external-edit reloads; reloading the whole collection assigns new ids.
+    [[nodiscard]] PresetId GetPresetId(std::size_t index) const noexcept;
+    // Slot of the preset with `id`, or GetPresetCount() once it is gone.
+    [[nodiscard]] std::size_t FindPresetIndexById(PresetId id) const;
+
+    // Indices of presets whose name or loadout code contains `filter` (case-insensitive). Any
+    // search other than the empty one parses the presets lazy loading deferred.
+    [[nodiscard]] std::vector<std::size_t> FilterPresets(std::string_view filter);
+    // Narrows an earlier FilterPresets result after the filter grew around the previous text.
+    // `matches` must have been computed at the current revision.
+    void RefineFilter(std::string_view filter, std::vector<std::size_t> &matches);
+    // Evaluates a structured query (see PresetQuery) and returns matches best first.
+    [[nodiscard]] std::vector<PresetQueryMatch> QueryPresets(const PresetQuery &query);
+    // Up to `count` presets whose primary and accent colours are closest to the given ones, nearest
+    // first (see PresetColorIndex), leaving out the preset with `excludedId`. Needs no parsing, so
+    // presets lazy loading deferred are included.
+    [[nodiscard]] std::vector<PresetColorIndex::Neighbor> FindSimilarColors(const PresetPaintColor &primary,
+                                                                            const PresetPaintColor &accent,
+                                                                            std::size_t count,
+                                                                            PresetId excludedId = invalidPresetId) const;
 
     void AddOrUpdatePreset(const CustomPreset &preset);
+    void AddOrUpdatePreset(CustomPreset &&preset);
+    void AddOrUpdatePreset(const EditablePreset &preset);
+    // Moves the last preset into the freed slot, so slots are not stable across removals; hold
+    // on to a PresetId instead.
     void RemovePreset(const std::string &name);
 
+    // Editor edits: applied, appended to the journal and recorded for Undo. Bulk changes go
+    // through AddOrUpdatePreset/RemovePreset and SaveToStorage instead.
+    void EditPreset(const EditablePreset &preset);
+    // Returns false if no preset has that name.
+    bool DeletePreset(const std::string &name);
+    // Reverts or reapplies the most recent editor edit, journaling the result like a new edit.
+    // Returns the name of the preset it touched, or nullopt when there is nothing to do.
+    std::optional<std::string> Undo();
+    std::optional<std::string> Redo();
+    [[nodiscard]] bool CanUndo() const noexcept;
+    [[nodiscard]] bool CanRedo() const noexcept;
+
+    // Label interning. Presets store PresetLabelIds; these convert to and from text.
+    [[nodiscard]] const std::string &GetLabel(PresetLabelId id) const noexcept;
+    PresetLabelId InternLabel(std::string_view label, PresetLabelId fallback);
+    [[nodiscard]] const PresetLabelPool &GetLabelPool() const noexcept;
+    // Memory behind the names and loadout codes of the collection.
+    [[nodiscard]] PresetStringArena::Stats GetStringArenaStats() const noexcept;
+    [[nodiscard]] EditablePreset ToEditable(const CustomPreset &preset) const;
+
 private:
-    std::shared_ptr<GameWrapper> gameWrapper;
-    std::shared_ptr<CVarManagerWrapper> cvarManager;
+    PresetManagerHost host;
+    // Shared with the storage writer, which resolves labels of snapshots on its own thread.
+    std::shared_ptr<PresetLabelPool> labelPool;
+    // Every string in `presets` is allocated from here; declared first so it outlives them.
+    PresetStringArena stringArena;
     CustomPresetCollection presets;
+    // Maps a preset name to its position in `presets` so lookups stay O(1) during bulk imports.
+    std::unordered_map<std::string, std::size_t, PresetNameHash, std::equal_to<>> presetIndexByName;
+    // Id of each slot (parallel to `presets`) and the reverse map.
+    std::vector<PresetId> presetIds;
+    std::unordered_map<PresetId, std::size_t> slotById;
+    PresetId nextPresetId{invalidPresetId + 1};
+    std::uint64_t revision{0};
+    // Parallel to `presets`. Declared before the search index, which reads it.
+    std::vector<LoadoutCode::Loadout> decodedLoadouts;
+    // Content hash of each decoded loadout (parallel to `presets`) and how many presets share it.
+    std::vector<std::uint64_t> loadoutHashes;
+    std::unordered_map<std::uint64_t, std::uint32_t> presetCountByLoadoutHash;
+    PresetSearchIndex searchIndex;
+    PresetHotColumns hotColumns;
+    PresetColorIndex colorIndex;
     std::filesystem::path storageFilePath;
+    std::filesystem::path shardDirectory;
+    bool shardedStorage{false};
+    // Shards holding a preset that changed since the last save; only tracked in the sharded layout.
+    PresetShards::ShardMask dirtyShards{PresetShards::allShards};
+    bool lazyLoading{false};
+    // The mapped cfg and, parallel to `presets`, the line each preset still has to be parsed from
+    // (empty once parsed). Both are dropped once nothing is left to parse.
+    MappedFile lazyStorageFile;
+    std::vector<std::string_view> unparsedLines;
+    std::size_t unparsedCount{0};
+    // Last snapshot handed out, and which of its chunks hold presets changed since (indexed by
+    // chunk, may be shorter than the collection).
+    PresetSnapshotPtr publishedSnapshot;
+    std::vector<bool> snapshotDirtyChunks;
     std::filesystem::path vanillaPresetsPath;
+    std::filesystem::path catalogFilePath;
+    std::thread::id gameThreadId;
+    std::unique_ptr<PresetStorageWriter> storageWriter;
+    // Records in the journal since the last full write. Once they pile up the next edit rewrites
+    // the cfg instead of appending again.
+    std::size_t journalRecordCount{0};
+    // Presets whose current state the cfg on disk does not hold, so a reload of the cfg leaves
+    // them alone: `unsavedNames` changed since the last full write was scheduled, `savingNames`
+    // are in that write until the writer reports sequence `savingSequence` as written. Loads and
+    // reloads turn `trackUnsavedNames` off, since what they store is what the disk holds.
+    std::unordered_set<std::string, PresetNameHash, std::equal_to<>> unsavedNames;
+    std::unordered_set<std::string, PresetNameHash, std::equal_to<>> savingNames;
+    std::uint64_t savingSequence{0};
+    bool trackUnsavedNames{true};
+    // A preset's state before and after one editor edit; nullopt means it did not exist.
+    struct EditStep
+    {
+        std::string name;
+        std::optional<CustomPreset> before;
+        std::optional<CustomPreset> after;
+    };
+    std::vector<EditStep> undoSteps;
+    std::vector<EditStep> redoSteps;
+    // Shared so the completion posted to the game thread can tell whether the import it belongs
+    // to is still alive.
+    std::shared_ptr<PresetCatalogImporter> catalogImporter;
+    // Re-parses expanded_presets.cfg after an external edit; `storageReloadQueued` remembers an
+    // edit that arrived while a reload was still running.
+    std::shared_ptr<PresetCatalogImporter> storageReloader;
+    bool storageReloadQueued{false};
+    bool packExportRunning{false};
+    ExternalChangeCallback externalChangeCallback;
+    // Declared after the writer so the watcher thread, which reads the writer's stamp, stops first.
+    std::unique_ptr<PresetFileWatcher> fileWatcher;
+    // Callbacks posted to the game thread hold a weak reference and do nothing once it expired.
+    std::shared_ptr<const bool> aliveToken{std::make_shared<const bool>(true)};
 
     static constexpr std::string_view storageFileName{"expanded_presets.cfg"};
+    static constexpr std::string_view catalogFileName{"bakkesplugins_cars.cfg"};
+    static constexpr std::size_t maxUndoSteps{100};
 
-    static std::filesystem::path ResolveDataFolder(const std::shared_ptr<GameWrapper> &gameWrapper);
-    static std::filesystem::path ResolveVanillaPresetPath(const std::shared_ptr<GameWrapper> &gameWrapper);
-
+    // Gives the preset just appended at `index` a fresh id.
+    void AssignNewPresetId(std::size_t index);
+    // Flags the snapshot chunks covering slots [first, last) for copying on the next publish.
+    void MarkSnapshotDirty(std::size_t first, std::size_t last);
+    // Drops the collection and releases the string arena, unless `keepStrings` because the caller
+    // still holds presets moved out of the collection.
+    void ClearPresets(bool keepStrings = false);
+    // An empty preset whose strings allocate from the arena, for reuse as a parsing scratch.
+    [[nodiscard]] CustomPreset NewArenaPreset();
+    // Moves `preset` into arena-backed strings; copies only strings allocated elsewhere.
+    [[nodiscard]] CustomPreset MoveIntoArena(CustomPreset &&preset);
+    // Drops every preset whose `keep` entry is false in one pass; the kept presets keep their ids
+    // and the undo history is left alone. Cheaper than RemovePreset once more than a few presets go.
+    void RebuildPresets(const std::vector<bool> &keep);
+    void ForgetLoadoutHash(std::uint64_t hash);
+    // AddOrUpdatePreset with the loadout code already decoded (and hashed) by the caller.
+    void StorePreset(CustomPreset &&preset, const LoadoutCode::Loadout &loadout);
+    void StorePreset(CustomPreset &&preset, const LoadoutCode::Loadout &loadout, std::uint64_t hash);
+    [[nodiscard]] PresetLabelId DetectedCarLabel(const LoadoutCode::Loadout &loadout, PresetLabelId fallback);
+    // Encodes a journal record into `records`.
+    void JournalUpsert(std::string &records, const CustomPreset &preset) const;
+    void JournalRemoval(std::string &records, const std::string &name) const;
+    // Appends `records` (`recordCount` of them) to the journal, or rewrites the cfg instead once
+    // the journal has grown past a quarter of the collection.
+    void SaveJournal(std::string records, std::size_t recordCount);
+    void ReplayJournal();
+    // Puts the preset called `name` into `state` (nullopt removes it) and journals the change.
+    void ApplyEditState(const std::string &name, const std::optional<CustomPreset> &state);
+    // Pushes a new editor edit, dropping the oldest step past maxUndoSteps and the redo steps.
+    void RecordUndoStep(EditStep step);
+    [[nodiscard]] CustomPreset FromEditable(const EditablePreset &preset);
+    bool LoadFromBinaryCache(std::string_view storageContents);
+    // Lazy loading: adds or replaces the index-only entry for one cfg line of lazyStorageFile.
+    void IndexPresetLine(const PresetSerialization::PresetLineFields &fields, std::string_view line, CustomPreset &scratch);
+    void HydratePreset(std::size_t index);
+    // Drops the deferred line of `index`; returns false if that preset had already been parsed.
+    bool ForgetUnparsedLine(std::size_t index) noexcept;
+    void LoadFromShards();
+    void MarkShardDirty(std::string_view presetName) noexcept;
+    void MarkUnsaved(std::string_view presetName);
+    // Drops `savingNames` once the write holding them has reached the cfg.
+    void ForgetWrittenNames() noexcept;
+    void MergeCatalog(PresetCatalogImporter &importer, const CatalogImportCallback &onMerged);
+    // Starts `importer` and, once it has parsed everything, runs `onParsed` on the game thread
+    // provided `slot` still holds that importer. `slot` is only assigned if the start succeeds.
+    bool StartImporter(std::shared_ptr<PresetCatalogImporter> &slot, std::shared_ptr<PresetCatalogImporter> importer,
+                       std::function<void(PresetCatalogImporter &)> onParsed);
+    void OnWatchedFileChanged(const std::filesystem::path &file);
+    void ReloadChangedStorage();
+    ExternalChangeSummary ApplyReloadedStorage(PresetCatalogImporter &reloader);
     void EnsureStorageDirectory() const;
-    static std::vector<std::string> TokenizeLine(const std::string &line);
-    static PresetPaintColor ParseColorToken(const std::string &token);
-    static std::string SerializeColorToken(const PresetPaintColor &color);
+    void LogFromAnyThread(const std::string &message) const;
 };
 
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <string>
+
+class PresetWorkerPool;
+
+// Everything PresetManager needs from the process it runs in, so the library side of the plugin
+// builds without the BakkesMod SDK. The plugin fills this in from its wrappers (see
+// BakkesModPresetHost); benchmarks and tools pass plain callbacks.
+struct PresetManagerHost
+{
+    using Task = std::function<void()>;
+
+    // Folder for expanded_presets.cfg and everything else the plugin writes.
+    std::filesystem::path dataFolder;
+    std::filesystem::path vanillaPresetsPath;
+    // Only ever called on the game thread. Required.
+    std::function<void(const std::string &)> log;
+    // Queues `task` to run later on the game thread. When unset, background work that has to
+    // report back (catalog imports, file watching) is unavailable.
+    std::function<void(Task)> post;
+    // Runs imports, reloads and the sharded load in parallel; owned by the caller and must outlive
+    // the manager. Without one that work runs on the calling thread (see PresetWorkerPool for
+    // what tasks may touch).
+    PresetWorkerPool *workers{nullptr};
+};
@@ -0,0 +1,599 @@
+#include "PresetPack.h"
+
+#include "LoadoutCode.h"
+#include "PresetBinaryCache.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <system_error>
+#include <type_traits>
+
+namespace PresetPack
+{
+namespace
+{
+static_assert(std::endian::native == std::endian::little, "The preset pack format is little endian");
+
+constexpr std::array<char, 4> packMagic{'E', 'P', 'P', 'K'};
+constexpr std::uint32_t packFormatVersion = 1;
+
+constexpr char tagLabel = 0x01;
+constexpr char tagPreset = 0x02;
+
+constexpr std::uint8_t flagMatte = 1u << 0;
+constexpr std::uint8_t flagPearlescent = 1u << 1;
+constexpr std::uint8_t flagRawCode = 1u << 2;
+// The text form of a raw code ended in '=' padding.
+constexpr std::uint8_t flagPaddedCode = 1u << 3;
+
+// A block is closed after the entry that takes it past this size. Matches the reach of the
+// 16-bit match offsets below, so one block is one compression window.
+constexpr std::size_t blockBytes = 64 * 1024;
+// Anything larger is a damaged size field, not a block this writer produced.
+constexpr std::size_t maxBlockBytes = 16 * 1024 * 1024;
+
+struct Header
+{
+    std::array<char, 4> magic;
+    std::uint32_t formatVersion;
+    std::uint64_t presetCount;
+};
+
+struct BlockHeader
+{
+    std::uint32_t rawSize;
+    std::uint32_t storedSize;
+    std::uint64_t checksum;
+};
+
+static_assert(sizeof(Header) == 16 && std::is_trivially_copyable_v<Header>);
+static_assert(sizeof(BlockHeader) == 16 && std::is_trivially_copyable_v<BlockHeader>);
+
+// Byte-oriented LZ77 in the style of LZ4: each sequence is a token (literal count in the high
+// nibble, match length - 4 in the low one, 15 meaning more length bytes follow), the literals, a
+// 16-bit offset and the extra match length. The last sequence has literals only. Hand-rolled for
+// the same reason as PngEncoder: a pack codec is not worth a zlib dependency.
+constexpr std::size_t minMatch = 4;
+constexpr std::size_t maxOffset = 65535;
+constexpr unsigned hashBits = 14;
+
+std::uint32_t Load32(const char *bytes) noexcept
+{
+    std::uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+void PutLength(std::string &output, std::size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        output.push_back('\xFF');
+    }
+    output.push_back(static_cast<char>(length));
+}
+
+void PutSequence(std::string &output, std::string_view literals, std::size_t offset, std::size_t matchLength)
+{
+    const auto extraMatch = matchLength - minMatch;
+    const auto token = std::min<std::size_t>(literals.size(), 15) << 4 | std::min<std::size_t>(extraMatch, 15);
+    output.push_back(static_cast<char>(token));
+    if (literals.size() >= 15)
+    {
+        PutLength(output, literals.size() - 15);
+    }
+    output.append(literals);
+    output.push_back(static_cast<char>(offset));
+    output.push_back(static_cast<char>(offset >> 8));
+    if (extraMatch >= 15)
+    {
+        PutLength(output, extraMatch - 15);
+    }
+}
+
+void Compress(std::string_view input, std::string &output)
+{
+    output.clear();
+    output.reserve(input.size() + input.size() / 255 + 16);
+
+    // Last position + 1 of each hashed 4-byte sequence; 0 means none yet.
+    std::array<std::uint32_t, 1u << hashBits> candidates{};
+    const auto *data = input.data();
+    std::size_t anchor = 0;
+    std::size_t position = 0;
+    while (position + minMatch <= input.size())
+    {
+        const auto sequence = Load32(data + position);
+        const auto hash = (sequence * 2654435761u) >> (32 - hashBits);
+        const auto candidate = candidates[hash];
+        candidates[hash] = static_cast<std::uint32_t>(position + 1);
+        if (candidate == 0 || position - (candidate - 1) > maxOffset || Load32(data + candidate - 1) != sequence)
+        {
+            ++position;
+            continue;
+        }
+
+        const auto match = candidate - 1;
+        auto length = minMatch;
+        while (position + length < input.size() && data[match + length] == data[position + length])
+        {
+            ++length;
+        }
+        PutSequence(output, input.substr(anchor, position - anchor), position - match, length);
+        position += length;
+        anchor = position;
+    }
+
+    const auto literals = input.substr(anchor);
+    output.push_back(static_cast<char>(std::min<std::size_t>(literals.size(), 15) << 4));
+    if (literals.size() >= 15)
+    {
+        PutLength(output, literals.size() - 15);
+    }
+    output.append(literals);
+}
+
+bool ReadLength(std::string_view input, std::size_t &position, std::size_t limit, std::size_t &length) noexcept
+{
+    while (true)
+    {
+        if (position >= input.size())
+        {
+            return false;
+        }
+        const auto byte = static_cast<unsigned char>(input[position++]);
+        length += byte;
+        if (length > limit)
+        {
+            return false;
+        }
+        if (byte != 255)
+        {
+            return true;
+        }
+    }
+}
+
+// Fails on anything that would read or write out of bounds or does not produce exactly
+// `rawSize` bytes.
+bool Decompress(std::string_view input, std::size_t rawSize, std::string &output)
+{
+    output.resize(rawSize);
+    auto *out = output.data();
+    std::size_t written = 0;
+    std::size_t position = 0;
+    while (position < input.size())
+    {
+        const auto token = static_cast<unsigned char>(input[position++]);
+        std::size_t literals = token >> 4;
+        if (literals == 15 && !ReadLength(input, position, rawSize, literals))
+        {
+            return false;
+        }
+        if (literals > input.size() - position || literals > rawSize - written)
+        {
+            return false;
+        }
+        std::memcpy(out + written, input.data() + position, literals);
+        position += literals;
+        written += literals;
+        if (position == input.size())
+        {
+            break;
+        }
+
+        if (input.size() - position < 2)
+        {
+            return false;
+        }
+        const auto offset = static_cast<std::size_t>(static_cast<unsigned char>(input[position])) |
+                            static_cast<std::size_t>(static_cast<unsigned char>(input[position + 1])) << 8;
+        position += 2;
+        std::size_t length = token & 0x0Fu;
+        if (length == 15 && !ReadLength(input, position, rawSize, length))
+        {
+            return false;
+        }
+        length += minMatch;
+        if (offset == 0 || offset > written || length > rawSize - written)
+        {
+            return false;
+        }
+        // Matches may overlap the bytes they produce, so this copies forward one byte at a time.
+        for (const auto *from = out + written - offset; length > 0; --length)
+        {
+            out[written++] = *from++;
+        }
+    }
+    return written == rawSize;
+}
+
+void PutVarint(std::string &output, std::uint64_t value)
+{
+    for (; value >= 0x80; value >>= 7)
+    {
+        output.push_back(static_cast<char>(value | 0x80));
+    }
+    output.push_back(static_cast<char>(value));
+}
+
+void PutString(std::string &output, std::string_view text)
+{
+    PutVarint(output, text.size());
+    output.append(text);
+}
+
+void PutColor(std::string &output, const PresetPaintColor &color)
+{
+    for (const float component : {color.r, color.g, color.b})
+    {
+        char bytes[sizeof(float)];
+        std::memcpy(bytes, &component, sizeof(float));
+        output.append(bytes, sizeof(float));
+    }
+}
+
+// Bounds-checked reads over one raw block; a read past the end clears Valid() and yields zeros.
+class BlockParser
+{
+public:
+    explicit BlockParser(std::string_view bytes) noexcept
+        : bytes(bytes)
+    {
+    }
+
+    [[nodiscard]] bool AtEnd() const noexcept
+    {
+        return position == bytes.size();
+    }
+
+    [[nodiscard]] bool Valid() const noexcept
+    {
+        return valid;
+    }
+
+    char Byte() noexcept
+    {
+        if (position >= bytes.size())
+        {
+            valid = false;
+            return 0;
+        }
+        return bytes[position++];
+    }
+
+    std::uint64_t Varint() noexcept
+    {
+        std::uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            const auto byte = static_cast<unsigned char>(Byte());
+            value |= static_cast<std::uint64_t>(byte & 0x7Fu) << shift;
+            if ((byte & 0x80u) == 0)
+            {
+                return value;
+            }
+        }
+        valid = false;
+        return 0;
+    }
+
+    std::string_view String() noexcept
+    {
+        const auto length = Varint();
+        if (length > bytes.size() - position)
+        {
+            valid = false;
+            return {};
+        }
+        const auto text = bytes.substr(position, static_cast<std::size_t>(length));
+        position += text.size();
+        return text;
+    }
+
+    PresetPaintColor Color() noexcept
+    {
+        if (bytes.size() - position < 3 * sizeof(float))
+        {
+            valid = false;
+            return {};
+        }
+        PresetPaintColor color;
+        std::memcpy(&color.r, bytes.data() + position, sizeof(float));
+        std::memcpy(&color.g, bytes.data() + position + sizeof(float), sizeof(float));
+        std::memcpy(&color.b, bytes.data() + position + 2 * sizeof(float), sizeof(float));
+        position += 3 * sizeof(float);
+        return color;
+    }
+
+private:
+    std::string_view bytes;
+    std::size_t position{0};
+    bool valid{true};
+};
+
+std::span<const std::uint8_t> AsBytes(std::string_view text) noexcept
+{
+    return {reinterpret_cast<const std::uint8_t *>(text.data()), text.size()};
+}
+
+bool WriteBlock(std::ofstream &file, std::string_view raw, std::string &packed, WriteSummary &summary)
+{
+    Compress(raw, packed);
+    // Nothing to gain on incompressible blocks; store them as they are.
+    const auto payload = packed.size() < raw.size() ? std::string_view(packed) : raw;
+
+    BlockHeader header{};
+    header.rawSize = static_cast<std::uint32_t>(raw.size());
+    header.storedSize = static_cast<std::uint32_t>(payload.size());
+    header.checksum = PresetBinaryCache::HashContents(raw);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+
+    summary.rawBytes += raw.size();
+    summary.packedBytes += sizeof(header) + payload.size();
+    return static_cast<bool>(file);
+}
+} // namespace
+
+std::optional<WriteSummary> Write(const std::filesystem::path &packPath,
+                                  const PresetSnapshot &presets,
+                                  const PresetLabelPool &labels)
+{
+    auto temporaryPath = packPath;
+    temporaryPath += ".tmp";
+
+    WriteSummary summary;
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return std::nullopt;
+        }
+
+        Header header{};
+        header.magic = packMagic;
+        header.formatVersion = packFormatVersion;
+        header.presetCount = presets.Size();
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        summary.packedBytes = sizeof(header);
+
+        std::string raw;
+        std::string packed;
+        raw.reserve(blockBytes * 2);
+        // Dictionary index + 1 of each label id written so far, 0 for labels not written yet.
+        std::vector<std::uint32_t> dictionaryIndices;
+        std::uint32_t dictionarySize = 0;
+        const auto dictionaryIndex = [&](PresetLabelId id)
+        {
+            if (id >= dictionaryIndices.size())
+            {
+                dictionaryIndices.resize(static_cast<std::size_t>(id) + 1, 0);
+            }
+            if (dictionaryIndices[id] == 0)
+            {
+                raw.push_back(tagLabel);
+                PutString(raw, labels.Resolve(id));
+                dictionaryIndices[id] = ++dictionarySize;
+            }
+            return dictionaryIndices[id] - 1;
+        };
+
+        std::array<std::uint8_t, LoadoutCode::maxCodeBytes> codeBytes{};
+        std::string roundTrip;
+        bool written = true;
+        presets.ForEach([&](const CustomPreset &preset)
+                        {
+                            if (!written)
+                            {
+                                return;
+                            }
+
+                            const auto &customization = preset.customization;
+                            const auto car = dictionaryIndex(customization.carLabel);
+                            const auto decal = dictionaryIndex(customization.decalLabel);
+                            const auto wheels = dictionaryIndex(customization.wheelsLabel);
+
+                            std::uint8_t flags = (customization.paintFinishMatte ? flagMatte : 0u) |
+                                                 (customization.paintFinishPearlescent ? flagPearlescent : 0u);
+                            std::string_view code = preset.loadoutCode;
+                            // Only codes that re-encode to the same text are stored decoded, so an
+                            // import reproduces every code byte for byte.
+                            const bool padded = code.ends_with('=');
+                            if (const auto byteCount = LoadoutCode::DecodeBase64(code, codeBytes))
+                            {
+                                LoadoutCode::EncodeBase64({codeBytes.data(), *byteCount}, padded, roundTrip);
+                                if (roundTrip == code)
+                                {
+                                    flags |= flagRawCode | (padded ? flagPaddedCode : 0u);
+                                    code = {reinterpret_cast<const char *>(codeBytes.data()), *byteCount};
+                                }
+                            }
+
+                            raw.push_back(tagPreset);
+                            PutString(raw, preset.name);
+                            raw.push_back(static_cast<char>(flags));
+                            PutString(raw, code);
+                            PutVarint(raw, car);
+                            PutVarint(raw, decal);
+                            PutVarint(raw, wheels);
+                            PutColor(raw, customization.primaryColor);
+                            PutColor(raw, customization.accentColor);
+                            ++summary.presetCount;
+
+                            if (raw.size() >= blockBytes)
+                            {
+                                written = WriteBlock(file, raw, packed, summary);
+                                raw.clear();
+                            }
+                        });
+        if (written && !raw.empty())
+        {
+            written = WriteBlock(file, raw, packed, summary);
+        }
+
+        BlockHeader end{};
+        end.checksum = summary.presetCount;
+        file.write(reinterpret_cast<const char *>(&end), sizeof(end));
+        summary.packedBytes += sizeof(end);
+        if (!written || !file.flush())
+        {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(temporaryPath, error);
+            return std::nullopt;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, packPath, error);
+    if (error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+        return std::nullopt;
+    }
+    return summary;
+}
+
+Reader::Reader(const std::filesystem::path &packPath)
+    : file(packPath, std::ios::binary)
+{
+    Header header{};
+    if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) && header.magic == packMagic &&
+        header.formatVersion == packFormatVersion)
+    {
+        status = Status::Block;
+        open = true;
+        declaredPresetCount = static_cast<std::size_t>(header.presetCount);
+    }
+}
+
+bool Reader::IsOpen() const noexcept
+{
+    return open;
+}
+
+std::size_t Reader::GetPresetCount() const noexcept
+{
+    return presetCount;
+}
+
+std::size_t Reader::GetDeclaredPresetCount() const noexcept
+{
+    return declaredPresetCount;
+}
+
+Reader::Status Reader::ReadBlock(const std::function<void(const Entry &)> &visit)
+{
+    if (status != Status::Block)
+    {
+        return status;
+    }
+    status = Status::Damaged;
+
+    BlockHeader header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+    {
+        return status;
+    }
+    if (header.rawSize == 0)
+    {
+        if (header.storedSize == 0 && header.checksum == presetCount && presetCount == declaredPresetCount)
+        {
+            status = Status::End;
+        }
+        return status;
+    }
+    if (header.rawSize > maxBlockBytes || header.storedSize == 0 || header.storedSize > header.rawSize)
+    {
+        return status;
+    }
+
+    stored.resize(header.storedSize);
+    if (!file.read(stored.data(), static_cast<std::streamsize>(stored.size())))
+    {
+        return status;
+    }
+    if (header.storedSize == header.rawSize)
+    {
+        raw.swap(stored);
+    }
+    else if (!Decompress(stored, header.rawSize, raw))
+    {
+        return status;
+    }
+    if (PresetBinaryCache::HashContents(raw) != header.checksum || !ParseBlock())
+    {
+        return status;
+    }
+
+    Entry entry;
+    for (const auto &preset : pending)
+    {
+        entry.name = preset.name;
+        if ((preset.flags & flagRawCode) != 0)
+        {
+            entry.loadoutBytes = AsBytes(preset.loadoutCode);
+            LoadoutCode::EncodeBase64(entry.loadoutBytes, (preset.flags & flagPaddedCode) != 0, codeText);
+            entry.loadoutCode = codeText;
+        }
+        else
+        {
+            entry.loadoutBytes = {};
+            entry.loadoutCode = preset.loadoutCode;
+        }
+        entry.carLabel = labels[preset.carLabel];
+        entry.decalLabel = labels[preset.decalLabel];
+        entry.wheelsLabel = labels[preset.wheelsLabel];
+        entry.primaryColor = preset.primaryColor;
+        entry.accentColor = preset.accentColor;
+        entry.paintFinishMatte = (preset.flags & flagMatte) != 0;
+        entry.paintFinishPearlescent = (preset.flags & flagPearlescent) != 0;
+        visit(entry);
+        ++presetCount;
+    }
+    status = Status::Block;
+    return status;
+}
+
+bool Reader::ParseBlock()
+{
+    pending.clear();
+    BlockParser parser(raw);
+    while (parser.Valid() && !parser.AtEnd())
+    {
+        const auto tag = parser.Byte();
+        if (tag == tagLabel)
+        {
+            labels.emplace_back(parser.String());
+            continue;
+        }
+        if (tag != tagPreset)
+        {
+            return false;
+        }
+
+        PendingPreset preset;
+        preset.name = parser.String();
+        preset.flags = static_cast<std::uint8_t>(parser.Byte());
+        preset.loadoutCode = parser.String();
+        const auto car = parser.Varint();
+        const auto decal = parser.Varint();
+        const auto wheels = parser.Varint();
+        // Also rejects labels used before their definition.
+        if (car >= labels.size() || decal >= labels.size() || wheels >= labels.size())
+        {
+            return false;
+        }
+        preset.carLabel = static_cast<std::uint32_t>(car);
+        preset.decalLabel = static_cast<std::uint32_t>(decal);
+        preset.wheelsLabel = static_cast<std::uint32_t>(wheels);
+        preset.primaryColor = parser.Color();
+        preset.accentColor = parser.Color();
+        pending.push_back(preset);
+    }
+    return parser.Valid();
+}
+} // namespace PresetPack
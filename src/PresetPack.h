@@ -0,0 +1,120 @@
+#pragma once
+
+#include "PresetLabelPool.h"
+#include "PresetSnapshot.h"
+#include "PresetTypes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Compressed preset pack for sharing a library between players. Loadout codes are kept as their
+// decoded bytes rather than base64 and every label is stored once, and the file is read one
+// block at a time, so importing a pack holds at most one block of it in memory and skips the
+// per-line text parsing of the cfg formats.
+//
+// Layout (little endian):
+//   Header                  magic, format version, preset count
+//   Block...                BlockHeader (raw size, stored size, FNV-1a of the raw bytes), then
+//                           the LZ-compressed bytes, or the raw bytes when the stored size equals
+//                           the raw size
+//   BlockHeader             raw and stored size 0, checksum = preset count again; ends the pack
+//
+// Raw block contents are a sequence of entries, none of them split across blocks:
+//   0x01 label              varint length, bytes; takes the next dictionary index, from 0
+//   0x02 preset             varint length and name, flags:u8, varint length and loadout code
+//                           (decoded bytes or text, see the flags), car, decal and wheels
+//                           dictionary indices as varints, primary and accent colour as 6 float32
+// A label is always defined before the first preset that uses it.
+namespace PresetPack
+{
+struct WriteSummary
+{
+    std::size_t presetCount{0};
+    std::uint64_t rawBytes{0};
+    std::uint64_t packedBytes{0};
+};
+
+// Writes `presets` to `packPath` through a temporary file, so a failed export leaves an existing
+// pack untouched. `labels` is only resolved, so this may run on any thread.
+[[nodiscard]] std::optional<WriteSummary> Write(const std::filesystem::path &packPath,
+                                                const PresetSnapshot &presets,
+                                                const PresetLabelPool &labels);
+
+// One preset read from a pack. The views are only valid while the visitor runs.
+struct Entry
+{
+    std::string_view name;
+    std::string_view loadoutCode;
+    // Decoded loadout code, so the reader can skip the base64 decode; empty for codes the pack
+    // kept as text because they do not survive a round trip through standard base64.
+    std::span<const std::uint8_t> loadoutBytes;
+    std::string_view carLabel;
+    std::string_view decalLabel;
+    std::string_view wheelsLabel;
+    PresetPaintColor primaryColor;
+    PresetPaintColor accentColor;
+    bool paintFinishMatte{false};
+    bool paintFinishPearlescent{false};
+};
+
+// Streams a pack from disk, one block per ReadBlock call.
+class Reader
+{
+public:
+    enum class Status
+    {
+        Block,
+        End,
+        Damaged,
+    };
+
+    explicit Reader(const std::filesystem::path &packPath);
+
+    // False if the file could not be opened or does not start with a pack header.
+    [[nodiscard]] bool IsOpen() const noexcept;
+    // Checks and unpacks the next block, then calls `visit` for each of its presets. A block that
+    // fails its checksum or does not parse is not visited at all, and a pack that stops before
+    // its end marker is Damaged. Once End or Damaged was returned, later calls return it again.
+    Status ReadBlock(const std::function<void(const Entry &)> &visit);
+    // Presets visited so far.
+    [[nodiscard]] std::size_t GetPresetCount() const noexcept;
+    // Presets the header promises, for reserving space up front. Not verified until End.
+    [[nodiscard]] std::size_t GetDeclaredPresetCount() const noexcept;
+
+private:
+    // A parsed preset whose views point into `raw`; labels are dictionary indices.
+    struct PendingPreset
+    {
+        std::string_view name;
+        std::string_view loadoutCode;
+        std::uint8_t flags{0};
+        std::uint32_t carLabel{0};
+        std::uint32_t decalLabel{0};
+        std::uint32_t wheelsLabel{0};
+        PresetPaintColor primaryColor;
+        PresetPaintColor accentColor;
+    };
+
+    std::ifstream file;
+    bool open{false};
+    Status status{Status::Damaged};
+    std::size_t presetCount{0};
+    std::size_t declaredPresetCount{0};
+    // Reused between blocks.
+    std::string stored;
+    std::string raw;
+    std::string codeText;
+    std::vector<PendingPreset> pending;
+    std::vector<std::string> labels;
+
+    [[nodiscard]] bool ParseBlock();
+};
+} // namespace PresetPack
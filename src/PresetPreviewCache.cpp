@@ -0,0 +1,105 @@
+#include "PresetPreviewCache.h"
+
+namespace
+{
+bool SameVec2(const ImVec2 &lhs, const ImVec2 &rhs) noexcept
+{
+    return lhs.x == rhs.x && lhs.y == rhs.y;
+}
+
+std::string BuildCaption(const EditablePresetCustomization &customization)
+{
+    std::string caption;
+    caption.reserve(48 + customization.carLabel.size() + customization.decalLabel.size() + customization.wheelsLabel.size());
+    caption.append("Car: ").append(customization.carLabel);
+    caption.append("\nDecal: ").append(customization.decalLabel);
+    caption.append("\nWheels: ").append(customization.wheelsLabel);
+    caption.append("\nFinish: ").append(customization.paintFinishMatte ? "Matte" : "Gloss");
+    if (customization.paintFinishPearlescent)
+    {
+        caption.append(", Pearlescent");
+    }
+    return caption;
+}
+} // namespace
+
+bool PresetPreviewCache::Replay(ImDrawList &drawList, ImVec2 origin, ImVec2 size, const EditablePresetCustomization &customization) const
+{
+    if (!Matches(size, customization))
+    {
+        return false;
+    }
+
+    const auto vertexCount = static_cast<int>(vertices.size());
+    const auto indexCount = static_cast<int>(indices.size());
+    drawList.PrimReserve(indexCount, vertexCount);
+    const auto base = drawList._VtxCurrentIdx;
+    for (const auto &vertex : vertices)
+    {
+        drawList._VtxWritePtr->pos = vertex.pos + origin;
+        drawList._VtxWritePtr->uv = vertex.uv;
+        drawList._VtxWritePtr->col = vertex.col;
+        ++drawList._VtxWritePtr;
+    }
+    for (const auto index : indices)
+    {
+        *drawList._IdxWritePtr++ = static_cast<ImDrawIdx>(base + index);
+    }
+    drawList._VtxCurrentIdx += static_cast<unsigned int>(vertexCount);
+    return true;
+}
+
+void PresetPreviewCache::BeginCapture(const ImDrawList &drawList)
+{
+    captureVertexStart = drawList.VtxBuffer.Size;
+    captureIndexStart = drawList.IdxBuffer.Size;
+    captureCommandCount = drawList.CmdBuffer.Size;
+    captureVertexIndex = drawList._VtxCurrentIdx;
+}
+
+void PresetPreviewCache::EndCapture(const ImDrawList &drawList, ImVec2 origin, ImVec2 size, const EditablePresetCustomization &customization)
+{
+    if (!key || !(key->customization == customization))
+    {
+        caption = BuildCaption(customization);
+    }
+
+    vertices.clear();
+    indices.clear();
+    if (drawList.CmdBuffer.Size != captureCommandCount || drawList._VtxCurrentIdx < captureVertexIndex)
+    {
+        key.reset();
+        return;
+    }
+
+    vertices.reserve(static_cast<std::size_t>(drawList.VtxBuffer.Size - captureVertexStart));
+    for (int i = captureVertexStart; i < drawList.VtxBuffer.Size; ++i)
+    {
+        auto vertex = drawList.VtxBuffer[i];
+        vertex.pos = vertex.pos - origin;
+        vertices.push_back(vertex);
+    }
+    indices.reserve(static_cast<std::size_t>(drawList.IdxBuffer.Size - captureIndexStart));
+    for (int i = captureIndexStart; i < drawList.IdxBuffer.Size; ++i)
+    {
+        indices.push_back(static_cast<ImDrawIdx>(drawList.IdxBuffer[i] - captureVertexIndex));
+    }
+
+    key = Key{customization, size, ImGui::GetFontTexUvWhitePixel()};
+}
+
+const std::string &PresetPreviewCache::Caption() const noexcept
+{
+    return caption;
+}
+
+void PresetPreviewCache::Invalidate() noexcept
+{
+    key.reset();
+}
+
+bool PresetPreviewCache::Matches(ImVec2 size, const EditablePresetCustomization &customization) const
+{
+    return key && SameVec2(key->size, size) && SameVec2(key->whitePixelUv, ImGui::GetFontTexUvWhitePixel()) &&
+           key->customization == customization;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "PresetTypes.h"
+
+#include "imgui/imgui.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// Keeps the geometry the preview panel generated for one customization so later frames copy the
+// vertices into the draw list instead of re-tessellating rounded rects and circles. Vertices are
+// stored relative to the canvas origin, so scrolling or moving the window only translates them.
+// The cache is rebuilt when the customization, the canvas size or the font atlas changes.
+//
+//   if (!cache.Replay(*drawList, origin, size, customization))
+//   {
+//       cache.BeginCapture(*drawList);
+//       ...draw...
+//       cache.EndCapture(*drawList, origin, size, customization);
+//   }
+class PresetPreviewCache
+{
+public:
+    // Appends the cached geometry at `origin`. False when the cache does not match, in which case
+    // nothing was drawn.
+    bool Replay(ImDrawList &drawList, ImVec2 origin, ImVec2 size, const EditablePresetCustomization &customization) const;
+
+    void BeginCapture(const ImDrawList &drawList);
+    // Keeps everything drawn since BeginCapture. Nothing is cached if the draw list started a new
+    // command in between, since the captured indices would not be contiguous.
+    void EndCapture(const ImDrawList &drawList, ImVec2 origin, ImVec2 size, const EditablePresetCustomization &customization);
+
+    // "Car: ...\nDecal: ...\nWheels: ...\nFinish: ..." for the customization last captured.
+    [[nodiscard]] const std::string &Caption() const noexcept;
+
+    void Invalidate() noexcept;
+
+private:
+    struct Key
+    {
+        EditablePresetCustomization customization;
+        ImVec2 size;
+        ImVec2 whitePixelUv;
+    };
+
+    std::optional<Key> key;
+    std::vector<ImDrawVert> vertices;
+    // Relative to the first captured vertex.
+    std::vector<ImDrawIdx> indices;
+    std::string caption;
+
+    int captureVertexStart{0};
+    int captureIndexStart{0};
+    int captureCommandCount{0};
+    unsigned int captureVertexIndex{0};
+
+    [[nodiscard]] bool Matches(ImVec2 size, const EditablePresetCustomization &customization) const;
+};
@@ -0,0 +1,305 @@
+#include "PresetProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace
+{
+constexpr std::array<std::string_view, PresetProfiler::zoneCount> zoneNames{
+    "Render",
+    "RenderPresetList",
+    "RenderPreviewPanel",
+    "RenderCanvas",
+    "LoadFromStorage",
+    "SaveToStorage",
+    "PublishSnapshot",
+    "StorageWrite",
+    "VanillaImport",
+    "CatalogMerge",
+    "PackExport",
+    "PackImport",
+};
+
+constexpr std::array<std::string_view, PresetProfiler::counterCount> counterNames{
+    "ListRowsDrawn",
+    "PreviewReplays",
+    "PreviewCaptures",
+    "JournalRecords",
+    "PresetsHydrated",
+    "SnapshotChunksCopied",
+};
+
+#if EXP_PRESETS_PROFILING
+thread_local std::uint64_t threadAllocations = 0;
+
+// Most recent samples kept per thread; a power of two so the index wraps with a mask.
+constexpr std::size_t ringCapacity = 4096;
+
+// A sample is packed into one word so a reader racing the owner never sees a torn value: the
+// zone in the top 8 bits, a saturated allocation count in the next 16 and nanoseconds in the
+// low 40 (about 18 minutes).
+constexpr unsigned durationBits = 40;
+constexpr unsigned allocationBits = 16;
+constexpr std::uint64_t durationMask = (std::uint64_t{1} << durationBits) - 1;
+constexpr std::uint64_t allocationMask = (std::uint64_t{1} << allocationBits) - 1;
+
+std::uint64_t PackSample(PresetProfiler::Zone zone, std::chrono::nanoseconds duration, std::uint64_t allocations) noexcept
+{
+    const auto nanoseconds = std::min<std::uint64_t>(static_cast<std::uint64_t>(std::max<std::int64_t>(duration.count(), 0)), durationMask);
+    return static_cast<std::uint64_t>(zone) << (durationBits + allocationBits) |
+           std::min(allocations, allocationMask) << durationBits | nanoseconds;
+}
+
+// Written only by its owning thread, read by Snapshot() from any thread. The "AtReset" fields
+// belong to the reader side.
+struct ThreadRing
+{
+    std::array<std::atomic<std::uint64_t>, ringCapacity> samples{};
+    std::atomic<std::uint64_t> written{0};
+    std::array<std::atomic<std::uint64_t>, PresetProfiler::zoneCount> calls{};
+    std::array<std::atomic<std::uint64_t>, PresetProfiler::counterCount> counters{};
+    std::atomic<bool> inUse{true};
+
+    std::atomic<std::uint64_t> writtenAtReset{0};
+    std::array<std::atomic<std::uint64_t>, PresetProfiler::zoneCount> callsAtReset{};
+    std::array<std::atomic<std::uint64_t>, PresetProfiler::counterCount> countersAtReset{};
+};
+
+// Owns every ring for the life of the module. Rings of finished threads are handed to the next
+// new thread, so short-lived workers do not grow the list.
+class RingRegistry
+{
+public:
+    ThreadRing &Acquire()
+    {
+        std::lock_guard lock(mutex);
+        for (auto &ring : rings)
+        {
+            bool expected = false;
+            if (ring->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                return *ring;
+            }
+        }
+        return *rings.emplace_back(std::make_unique<ThreadRing>());
+    }
+
+    template <typename Callback>
+    void ForEach(Callback &&callback)
+    {
+        std::lock_guard lock(mutex);
+        for (auto &ring : rings)
+        {
+            callback(*ring);
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+};
+
+RingRegistry &Registry()
+{
+    static RingRegistry registry;
+    return registry;
+}
+
+class RingHandle
+{
+public:
+    RingHandle()
+        : ring(Registry().Acquire())
+    {
+    }
+
+    ~RingHandle()
+    {
+        ring.inUse.store(false, std::memory_order_release);
+    }
+
+    RingHandle(const RingHandle &) = delete;
+    RingHandle &operator=(const RingHandle &) = delete;
+
+    ThreadRing &ring;
+};
+
+ThreadRing &LocalRing()
+{
+    thread_local RingHandle handle;
+    return handle.ring;
+}
+
+// Only the owning thread writes these, so a relaxed load and store replace a locked add.
+void Increment(std::atomic<std::uint64_t> &value, std::uint64_t amount) noexcept
+{
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds Percentile(const std::vector<std::uint64_t> &sorted, std::size_t percent) noexcept
+{
+    return std::chrono::nanoseconds(static_cast<std::int64_t>(sorted[(sorted.size() - 1) * percent / 100]));
+}
+#endif
+} // namespace
+
+#if EXP_PRESETS_PROFILING
+// Counting replacements for the global allocation functions. The array, nothrow and sized forms
+// forward to these by default; aligned allocations are not counted.
+void *operator new(std::size_t size)
+{
+    ++threadAllocations;
+    while (true)
+    {
+        if (void *pointer = std::malloc(size == 0 ? 1 : size))
+        {
+            return pointer;
+        }
+        const auto handler = std::get_new_handler();
+        if (!handler)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+namespace PresetProfiler
+{
+std::string_view ZoneName(Zone zone) noexcept
+{
+    return zone < Zone::Count ? zoneNames[static_cast<std::size_t>(zone)] : std::string_view{};
+}
+
+std::string_view CounterName(Counter counter) noexcept
+{
+    return counter < Counter::Count ? counterNames[static_cast<std::size_t>(counter)] : std::string_view{};
+}
+
+#if EXP_PRESETS_PROFILING
+void Record(Zone zone, std::chrono::nanoseconds duration, std::uint64_t allocations) noexcept
+{
+    auto &ring = LocalRing();
+    const auto index = ring.written.load(std::memory_order_relaxed);
+    ring.samples[index & (ringCapacity - 1)].store(PackSample(zone, duration, allocations), std::memory_order_relaxed);
+    ring.written.store(index + 1, std::memory_order_release);
+    Increment(ring.calls[static_cast<std::size_t>(zone)], 1);
+}
+
+void Count(Counter counter, std::uint64_t amount) noexcept
+{
+    Increment(LocalRing().counters[static_cast<std::size_t>(counter)], amount);
+}
+
+std::uint64_t ThreadAllocationCount() noexcept
+{
+    return threadAllocations;
+}
+
+Stats Snapshot()
+{
+    Stats stats;
+    std::array<std::vector<std::uint64_t>, zoneCount> durations;
+    std::array<std::uint64_t, zoneCount> allocations{};
+    Registry().ForEach([&stats, &durations, &allocations](ThreadRing &ring)
+                       {
+                           for (std::size_t zone = 0; zone < zoneCount; ++zone)
+                           {
+                               stats.zones[zone].calls += ring.calls[zone].load(std::memory_order_relaxed) -
+                                                          ring.callsAtReset[zone].load(std::memory_order_relaxed);
+                           }
+                           for (std::size_t counter = 0; counter < counterCount; ++counter)
+                           {
+                               stats.counters[counter] += ring.counters[counter].load(std::memory_order_relaxed) -
+                                                          ring.countersAtReset[counter].load(std::memory_order_relaxed);
+                           }
+
+                           const auto written = ring.written.load(std::memory_order_acquire);
+                           const auto oldest = written > ringCapacity ? written - ringCapacity : 0;
+                           for (auto i = std::max(oldest, ring.writtenAtReset.load(std::memory_order_relaxed)); i < written; ++i)
+                           {
+                               // A slot the owner has lapped since holds a newer sample, which is just as good.
+                               const auto sample = ring.samples[i & (ringCapacity - 1)].load(std::memory_order_relaxed);
+                               const auto zone = static_cast<std::size_t>(sample >> (durationBits + allocationBits));
+                               if (zone < zoneCount)
+                               {
+                                   durations[zone].push_back(sample & durationMask);
+                                   allocations[zone] += (sample >> durationBits) & allocationMask;
+                               }
+                           }
+                       });
+
+    for (std::size_t zone = 0; zone < zoneCount; ++zone)
+    {
+        auto &samples = durations[zone];
+        auto &result = stats.zones[zone];
+        result.samples = samples.size();
+        if (samples.empty())
+        {
+            continue;
+        }
+        std::sort(samples.begin(), samples.end());
+        result.p50 = Percentile(samples, 50);
+        result.p99 = Percentile(samples, 99);
+        result.max = std::chrono::nanoseconds(static_cast<std::int64_t>(samples.back()));
+        result.allocationsPerCall = static_cast<double>(allocations[zone]) / static_cast<double>(samples.size());
+    }
+    return stats;
+}
+
+void Reset()
+{
+    Registry().ForEach([](ThreadRing &ring)
+                       {
+                           ring.writtenAtReset.store(ring.written.load(std::memory_order_acquire), std::memory_order_relaxed);
+                           for (std::size_t zone = 0; zone < zoneCount; ++zone)
+                           {
+                               ring.callsAtReset[zone].store(ring.calls[zone].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                           }
+                           for (std::size_t counter = 0; counter < counterCount; ++counter)
+                           {
+                               ring.countersAtReset[counter].store(ring.counters[counter].load(std::memory_order_relaxed),
+                                                                   std::memory_order_relaxed);
+                           }
+                       });
+}
+#else
+void Record(Zone, std::chrono::nanoseconds, std::uint64_t) noexcept
+{
+}
+
+void Count(Counter, std::uint64_t) noexcept
+{
+}
+
+std::uint64_t ThreadAllocationCount() noexcept
+{
+    return 0;
+}
+
+Stats Snapshot()
+{
+    return {};
+}
+
+void Reset()
+{
+}
+#endif
+} // namespace PresetProfiler
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Scoped timers and counters for the plugin's hot paths. Every thread records into its own ring
+// of the most recent samples with relaxed atomic stores only, so recording never locks or
+// allocates; Snapshot() reads all rings from another thread while they keep filling.
+//
+// Instrumentation goes through the EXP_PRESETS_PROFILE_* macros, which compile to nothing unless
+// EXP_PRESETS_PROFILING is set (see CMakeLists.txt). Allocation counts come from replacing the
+// global operator new in the same build, so they are only as wide as the module itself.
+namespace PresetProfiler
+{
+enum class Zone : std::uint8_t
+{
+    Render,
+    RenderPresetList,
+    RenderPreviewPanel,
+    RenderCanvas,
+    LoadFromStorage,
+    SaveToStorage,
+    PublishSnapshot,
+    StorageWrite,
+    VanillaImport,
+    CatalogMerge,
+    PackExport,
+    PackImport,
+    Count,
+};
+
+enum class Counter : std::uint8_t
+{
+    ListRowsDrawn,
+    PreviewReplays,
+    PreviewCaptures,
+    JournalRecords,
+    PresetsHydrated,
+    SnapshotChunksCopied,
+    Count,
+};
+
+inline constexpr std::size_t zoneCount = static_cast<std::size_t>(Zone::Count);
+inline constexpr std::size_t counterCount = static_cast<std::size_t>(Counter::Count);
+
+[[nodiscard]] std::string_view ZoneName(Zone zone) noexcept;
+[[nodiscard]] std::string_view CounterName(Counter counter) noexcept;
+
+// False when built without EXP_PRESETS_PROFILING; everything below then records nothing.
+[[nodiscard]] constexpr bool IsEnabled() noexcept
+{
+#if EXP_PRESETS_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Record(Zone zone, std::chrono::nanoseconds duration, std::uint64_t allocations) noexcept;
+void Count(Counter counter, std::uint64_t amount = 1) noexcept;
+// operator new calls made by the calling thread so far.
+[[nodiscard]] std::uint64_t ThreadAllocationCount() noexcept;
+
+struct ZoneStats
+{
+    // Calls since the last Reset; the percentiles only cover the samples still in the rings.
+    std::uint64_t calls{0};
+    std::size_t samples{0};
+    std::chrono::nanoseconds p50{0};
+    std::chrono::nanoseconds p99{0};
+    std::chrono::nanoseconds max{0};
+    double allocationsPerCall{0.0};
+};
+
+struct Stats
+{
+    std::array<ZoneStats, zoneCount> zones{};
+    std::array<std::uint64_t, counterCount> counters{};
+};
+
+// Safe to call from any thread; sorts the recent samples, so keep it off per-frame paths that
+// do not display the result.
+[[nodiscard]] Stats Snapshot();
+// Starts the next Snapshot from zero without touching the recording threads.
+void Reset();
+
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Zone zone) noexcept
+        : zone(zone),
+          allocationsAtStart(ThreadAllocationCount()),
+          start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        Record(zone, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed), ThreadAllocationCount() - allocationsAtStart);
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Zone zone;
+    std::uint64_t allocationsAtStart;
+    std::chrono::steady_clock::time_point start;
+};
+} // namespace PresetProfiler
+
+#define EXP_PRESETS_PROFILE_CONCAT_INNER(a, b) a##b
+#define EXP_PRESETS_PROFILE_CONCAT(a, b) EXP_PRESETS_PROFILE_CONCAT_INNER(a, b)
+
+#if EXP_PRESETS_PROFILING
+#define EXP_PRESETS_PROFILE_SCOPE(zone) \
+    const PresetProfiler::ScopedTimer EXP_PRESETS_PROFILE_CONCAT(profileScope, __LINE__) { PresetProfiler::Zone::zone }
+#define EXP_PRESETS_PROFILE_COUNT(counter, amount) PresetProfiler::Count(PresetProfiler::Counter::counter, amount)
+#else
+#define EXP_PRESETS_PROFILE_SCOPE(zone) static_cast<void>(0)
+#define EXP_PRESETS_PROFILE_COUNT(counter, amount) static_cast<void>(0)
+#endif
@@ -0,0 +1,224 @@
+#include "PresetQuery.h"
+
+#include "PresetSearchIndex.h"
+#include "PresetSerialization.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <optional>
+
+namespace
+{
+std::vector<std::string_view> SplitTerms(std::string_view query)
+{
+    std::vector<std::string_view> terms;
+    std::size_t position = 0;
+    while (position < query.size())
+    {
+        while (position < query.size() && std::isspace(static_cast<unsigned char>(query[position])))
+        {
+            ++position;
+        }
+        if (position >= query.size())
+        {
+            break;
+        }
+
+        // A term runs until unquoted whitespace, so `car:"road hog"` stays one term.
+        const auto start = position;
+        bool quoted = false;
+        while (position < query.size() && (quoted || !std::isspace(static_cast<unsigned char>(query[position]))))
+        {
+            if (query[position] == '"')
+            {
+                quoted = !quoted;
+            }
+            ++position;
+        }
+        terms.push_back(query.substr(start, position - start));
+    }
+    return terms;
+}
+
+// Strips quotes and lowercases so values compare directly against the index keys.
+std::string NormalizeValue(std::string_view value)
+{
+    std::string unquoted;
+    unquoted.reserve(value.size());
+    for (const char c : value)
+    {
+        if (c != '"')
+        {
+            unquoted.push_back(c);
+        }
+    }
+    return PresetSearchIndex::ToLower(unquoted);
+}
+
+std::optional<bool> ParseBool(std::string_view value)
+{
+    const auto lower = PresetSearchIndex::ToLower(value);
+    if (lower == "1" || lower == "true" || lower == "yes")
+    {
+        return true;
+    }
+    if (lower == "0" || lower == "false" || lower == "no")
+    {
+        return false;
+    }
+    return std::nullopt;
+}
+
+std::optional<PresetPaintColor> ParseColor(std::string_view value)
+{
+    if (value.find(',') != std::string_view::npos)
+    {
+        return PresetSerialization::ParseColorToken(value);
+    }
+
+    if (!value.empty() && value.front() == '#')
+    {
+        value.remove_prefix(1);
+    }
+    if (value.size() != 6)
+    {
+        return std::nullopt;
+    }
+
+    std::array<float, 3> components{};
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        unsigned int component = 0;
+        const auto *begin = value.data() + i * 2;
+        const auto result = std::from_chars(begin, begin + 2, component, 16);
+        if (result.ec != std::errc{} || result.ptr != begin + 2)
+        {
+            return std::nullopt;
+        }
+        components[i] = static_cast<float>(component) / 255.0f;
+    }
+    return PresetPaintColor{components[0], components[1], components[2]};
+}
+
+bool ParseColorTerm(std::string_view term, PresetQuery &query)
+{
+    const auto separator = term.find('~');
+    const auto field = PresetSearchIndex::ToLower(term.substr(0, separator));
+    if (field != "primary" && field != "accent")
+    {
+        return false;
+    }
+
+    auto value = term.substr(separator + 1);
+    float tolerance = PresetQuery::defaultColorTolerance;
+    if (const auto slash = value.find('/'); slash != std::string_view::npos)
+    {
+        const auto toleranceText = value.substr(slash + 1);
+        const auto *end = toleranceText.data() + toleranceText.size();
+        const auto result = std::from_chars(toleranceText.data(), end, tolerance);
+        // from_chars accepts "nan" and "inf"; a NaN tolerance would quietly match nothing.
+        if (result.ec != std::errc{} || result.ptr != end || !std::isfinite(tolerance) || tolerance <= 0.0f)
+        {
+            query.errors.push_back("invalid colour tolerance in '" + std::string(term) + "'");
+            return true;
+        }
+        value = value.substr(0, slash);
+    }
+
+    const auto color = ParseColor(value);
+    if (!color)
+    {
+        query.errors.push_back("invalid colour in '" + std::string(term) + "'");
+        return true;
+    }
+
+    query.colors.push_back({field == "accent", *color, tolerance});
+    return true;
+}
+
+bool ParseFieldTerm(std::string_view term, PresetQuery &query)
+{
+    const auto separator = term.find(':');
+    const auto field = PresetSearchIndex::ToLower(term.substr(0, separator));
+    const auto value = term.substr(separator + 1);
+
+    if (field == "car" || field == "decal" || field == "wheels")
+    {
+        const auto labelField = field == "car"   ? PresetQuery::LabelField::Car
+                                : field == "decal" ? PresetQuery::LabelField::Decal
+                                                   : PresetQuery::LabelField::Wheels;
+        query.labels.push_back({labelField, NormalizeValue(value)});
+        return true;
+    }
+    if (field == "name" || field == "code")
+    {
+        query.text.push_back({field == "name" ? PresetQuery::TextField::Name : PresetQuery::TextField::LoadoutCode, NormalizeValue(value)});
+        return true;
+    }
+    if (field == "item")
+    {
+        // Product ids are 13-bit fields in the loadout code.
+        std::uint16_t productId = 0;
+        const auto result = std::from_chars(value.data(), value.data() + value.size(), productId);
+        if (result.ec != std::errc{} || result.ptr != value.data() + value.size() || productId >= 1u << 13)
+        {
+            query.errors.push_back("expected a product id in '" + std::string(term) + "'");
+            return true;
+        }
+        query.items.push_back({productId});
+        return true;
+    }
+    if (field == "matte" || field == "pearlescent")
+    {
+        const auto flag = ParseBool(value);
+        if (!flag)
+        {
+            query.errors.push_back("expected 1 or 0 in '" + std::string(term) + "'");
+            return true;
+        }
+        query.flags.push_back({field == "pearlescent", *flag});
+        return true;
+    }
+    return false;
+}
+} // namespace
+
+PresetQuery PresetQuery::Parse(std::string_view text)
+{
+    PresetQuery query;
+    for (const auto term : SplitTerms(text))
+    {
+        const auto colon = term.find(':');
+        const auto tilde = term.find('~');
+        if (tilde != std::string_view::npos && tilde < colon && ParseColorTerm(term, query))
+        {
+            continue;
+        }
+        if (colon != std::string_view::npos && ParseFieldTerm(term, query))
+        {
+            continue;
+        }
+
+        // Unknown prefixes are kept as plain text so names containing ':' still match.
+        query.text.push_back({TextField::Any, NormalizeValue(term)});
+    }
+    return query;
+}
+
+bool PresetQuery::IsStructured(std::string_view text)
+{
+    const auto query = Parse(text);
+    return !query.labels.empty() || !query.items.empty() || !query.flags.empty() || !query.colors.empty() || !query.errors.empty() ||
+           std::any_of(query.text.begin(), query.text.end(), [](const TextTerm &term)
+                       {
+                           return term.field != TextField::Any;
+                       });
+}
+
+bool PresetQuery::IsEmpty() const noexcept
+{
+    return labels.empty() && text.empty() && items.empty() && flags.empty() && colors.empty();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "PresetTypes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Structured search over preset fields. Terms are separated by whitespace and may be quoted:
+//
+//   car:fennec wheels:"zomba" matte:1 primary~#f06c20 accent~0.1,0.3,0.7/0.15 sunset
+//
+//   car: decal: wheels:   label match; exact beats prefix beats substring when ranking
+//   name: code:           substring of the name or loadout code only
+//   item:                 product id equipped in any slot of either team, from the decoded
+//                         loadout code (e.g. item:4284 for the Fennec body)
+//   matte: pearlescent:   1/0/true/false/yes/no
+//   primary~ accent~      #rrggbb, rrggbb or r,g,b (0-1 or 0-255) with an optional /tolerance
+//                         (normalized RGB distance, default 0.2); closer colours rank higher
+//   anything else         substring of the name or loadout code, like the plain search box
+//
+// All values are matched case-insensitively.
+struct PresetQuery
+{
+    enum class LabelField
+    {
+        Car,
+        Decal,
+        Wheels
+    };
+
+    enum class TextField
+    {
+        Any,
+        Name,
+        LoadoutCode
+    };
+
+    struct LabelTerm
+    {
+        LabelField field;
+        std::string value;
+    };
+
+    struct TextTerm
+    {
+        TextField field;
+        std::string value;
+    };
+
+    struct ItemTerm
+    {
+        std::uint16_t productId;
+    };
+
+    struct FlagTerm
+    {
+        bool pearlescent;
+        bool value;
+    };
+
+    struct ColorTerm
+    {
+        bool accent;
+        PresetPaintColor color;
+        float tolerance;
+    };
+
+    static constexpr float defaultColorTolerance = 0.2f;
+
+    std::vector<LabelTerm> labels;
+    std::vector<TextTerm> text;
+    std::vector<ItemTerm> items;
+    std::vector<FlagTerm> flags;
+    std::vector<ColorTerm> colors;
+    std::vector<std::string> errors;
+
+    [[nodiscard]] static PresetQuery Parse(std::string_view query);
+
+    // True when `query` uses any field syntax; plain text goes through the substring filter.
+    [[nodiscard]] static bool IsStructured(std::string_view query);
+
+    [[nodiscard]] bool IsEmpty() const noexcept;
+};
+
+struct PresetQueryMatch
+{
+    std::size_t index;
+    float score;
+};
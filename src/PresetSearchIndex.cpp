@@ -0,0 +1,599 @@
+#include "PresetSearchIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iterator>
+#include <optional>
+
+namespace
+{
+std::uint32_t PackTrigram(std::string_view text, std::size_t offset) noexcept
+{
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(text[offset])) << 16 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(text[offset + 1])) << 8 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(text[offset + 2]));
+}
+
+std::vector<std::uint32_t> UniqueTrigrams(std::string_view text)
+{
+    std::vector<std::uint32_t> trigrams;
+    if (text.size() < 3)
+    {
+        return trigrams;
+    }
+
+    trigrams.reserve(text.size() - 2);
+    for (std::size_t i = 0; i + 2 < text.size(); ++i)
+    {
+        trigrams.push_back(PackTrigram(text, i));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+// Posting lists stay sorted by slot. Builds and appends only ever add at the back.
+void InsertPosting(std::vector<std::uint32_t> &postings, std::uint32_t slot)
+{
+    if (postings.empty() || postings.back() < slot)
+    {
+        postings.push_back(slot);
+        return;
+    }
+    const auto it = std::lower_bound(postings.begin(), postings.end(), slot);
+    if (*it != slot)
+    {
+        postings.insert(it, slot);
+    }
+}
+
+// Returns true when the list is empty afterwards, so the caller can drop it.
+bool ErasePosting(std::vector<std::uint32_t> &postings, std::uint32_t slot)
+{
+    const auto it = std::lower_bound(postings.begin(), postings.end(), slot);
+    if (it != postings.end() && *it == slot)
+    {
+        postings.erase(it);
+    }
+    return postings.empty();
+}
+
+template <typename Key>
+void ErasePosting(std::unordered_map<Key, std::vector<std::uint32_t>> &postings, Key key, std::uint32_t slot)
+{
+    if (const auto it = postings.find(key); it != postings.end() && ErasePosting(it->second, slot))
+    {
+        postings.erase(it);
+    }
+}
+float ColorDistanceSquared(const PresetPaintColor &lhs, const PresetPaintColor &rhs) noexcept
+{
+    const float dr = lhs.r - rhs.r;
+    const float dg = lhs.g - rhs.g;
+    const float db = lhs.b - rhs.b;
+    // Normalized so opposite corners of the RGB cube are 1.0 apart.
+    return (dr * dr + dg * dg + db * db) / 3.0f;
+}
+
+// Both inputs sorted by index; keeps indices present in both and sums their scores.
+std::vector<PresetQueryMatch> Intersect(const std::vector<PresetQueryMatch> &lhs, const std::vector<PresetQueryMatch> &rhs)
+{
+    std::vector<PresetQueryMatch> result;
+    result.reserve(std::min(lhs.size(), rhs.size()));
+    auto left = lhs.begin();
+    auto right = rhs.begin();
+    while (left != lhs.end() && right != rhs.end())
+    {
+        if (left->index < right->index)
+        {
+            ++left;
+        }
+        else if (right->index < left->index)
+        {
+            ++right;
+        }
+        else
+        {
+            result.push_back({left->index, left->score + right->score});
+            ++left;
+            ++right;
+        }
+    }
+    return result;
+}
+} // namespace
+
+PresetSearchIndex::PresetSearchIndex(const PresetLabelPool &labels, const std::vector<LoadoutCode::Loadout> &loadouts)
+    : labels(labels),
+      loadouts(loadouts)
+{
+}
+
+void PresetSearchIndex::Clear()
+{
+    keys.clear();
+    fields.clear();
+    InvalidateIndices();
+}
+
+void PresetSearchIndex::Reserve(std::size_t count)
+{
+    keys.reserve(count);
+    fields.reserve(count);
+}
+
+void PresetSearchIndex::Assign(std::size_t slot, const CustomPreset &preset)
+{
+    if (slot >= keys.size())
+    {
+        keys.resize(slot + 1);
+        fields.resize(slot + 1);
+    }
+    else
+    {
+        RemovePostings(slot);
+    }
+
+    auto &key = keys[slot];
+    key = ToLower(preset.name);
+    key.push_back('\0');
+    key.append(ToLower(preset.loadoutCode));
+
+    const auto &customization = preset.customization;
+    auto &record = fields[slot];
+    record.labels = {customization.carLabel, customization.decalLabel, customization.wheelsLabel};
+    record.primaryColor = customization.primaryColor;
+    record.accentColor = customization.accentColor;
+    record.matte = customization.paintFinishMatte;
+    record.pearlescent = customization.paintFinishPearlescent;
+
+    record.itemCount = 0;
+    if (slot < loadouts.size())
+    {
+        const auto &loadout = loadouts[slot];
+        const auto addItems = [&record](const LoadoutCode::Team &team)
+        {
+            for (std::size_t i = 0; i < team.itemCount; ++i)
+            {
+                const auto productId = team.items[i].productId;
+                const auto end = record.items.begin() + record.itemCount;
+                if (std::find(record.items.begin(), end, productId) == end)
+                {
+                    record.items[record.itemCount++] = productId;
+                }
+            }
+        };
+        addItems(loadout.blue);
+        if (!loadout.blueIsOrange)
+        {
+            addItems(loadout.orange);
+        }
+    }
+
+    AddPostings(slot);
+}
+
+void PresetSearchIndex::SwapRemove(std::size_t slot)
+{
+    if (slot >= keys.size())
+    {
+        return;
+    }
+
+    // Only the removed slot and the last one, which takes its place, change their postings.
+    RemovePostings(slot);
+    const auto last = keys.size() - 1;
+    if (slot != last)
+    {
+        RemovePostings(last);
+        keys[slot] = std::move(keys[last]);
+        fields[slot] = fields[last];
+        AddPostings(slot);
+    }
+    keys.pop_back();
+    fields.pop_back();
+}
+
+std::vector<std::size_t> PresetSearchIndex::Search(std::string_view filter) const
+{
+    const auto filterLower = ToLower(filter);
+    std::vector<std::size_t> matches;
+
+    if (filterLower.size() < 3 || keys.size() < trigramIndexThreshold)
+    {
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            if (filterLower.empty() || keys[i].find(filterLower) != std::string::npos)
+            {
+                matches.push_back(i);
+            }
+        }
+        return matches;
+    }
+
+    EnsureTrigramIndex();
+
+    std::vector<const std::vector<std::uint32_t> *> lists;
+    for (const auto trigram : UniqueTrigrams(filterLower))
+    {
+        const auto it = trigramPostings.find(trigram);
+        if (it == trigramPostings.end())
+        {
+            return matches;
+        }
+        lists.push_back(&it->second);
+    }
+
+    // Intersect starting from the rarest trigram, then confirm the candidates actually contain
+    // the filter as a contiguous substring.
+    std::sort(lists.begin(), lists.end(), [](const auto *lhs, const auto *rhs)
+              {
+                  return lhs->size() < rhs->size();
+              });
+
+    std::vector<std::uint32_t> candidates = *lists.front();
+    std::vector<std::uint32_t> narrowed;
+    for (std::size_t i = 1; i < lists.size() && !candidates.empty(); ++i)
+    {
+        narrowed.clear();
+        std::set_intersection(candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(),
+                              std::back_inserter(narrowed));
+        candidates.swap(narrowed);
+    }
+
+    matches.reserve(candidates.size());
+    for (const auto slot : candidates)
+    {
+        if (keys[slot].find(filterLower) != std::string::npos)
+        {
+            matches.push_back(slot);
+        }
+    }
+    return matches;
+}
+
+void PresetSearchIndex::Refine(std::string_view filter, std::vector<std::size_t> &candidates) const
+{
+    const auto filterLower = ToLower(filter);
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                    [this, &filterLower](std::size_t slot)
+                                    {
+                                        return slot >= keys.size() || keys[slot].find(filterLower) == std::string::npos;
+                                    }),
+                     candidates.end());
+}
+
+std::vector<PresetQueryMatch> PresetSearchIndex::Query(const PresetQuery &query) const
+{
+    EnsureFieldIndex();
+
+    // Indexed terms narrow the candidate set first; everything else is checked per candidate.
+    std::optional<std::vector<PresetQueryMatch>> candidates;
+    const auto narrow = [&candidates](std::vector<PresetQueryMatch> matches)
+    {
+        candidates = candidates ? Intersect(*candidates, matches) : std::move(matches);
+    };
+
+    for (const auto &term : query.labels)
+    {
+        narrow(MatchLabel(term));
+    }
+    for (const auto &term : query.items)
+    {
+        std::vector<PresetQueryMatch> matches;
+        if (const auto it = itemPostings.find(term.productId); it != itemPostings.end())
+        {
+            matches.reserve(it->second.size());
+            for (const auto slot : it->second)
+            {
+                matches.push_back({slot, 1.0f});
+            }
+        }
+        narrow(std::move(matches));
+    }
+    for (const auto &term : query.flags)
+    {
+        // Once labels have narrowed the set, checking the flag per candidate is cheaper than
+        // intersecting with a posting list that may cover half the library.
+        if (!term.value || candidates)
+        {
+            continue;
+        }
+        const auto &postings = term.pearlescent ? pearlescentPostings : mattePostings;
+        std::vector<PresetQueryMatch> matches;
+        matches.reserve(postings.size());
+        for (const auto slot : postings)
+        {
+            matches.push_back({slot, 0.0f});
+        }
+        narrow(std::move(matches));
+    }
+
+    // Free text can still use the trigram index when no field term narrowed the set.
+    if (!candidates)
+    {
+        for (const auto &term : query.text)
+        {
+            if (term.field == PresetQuery::TextField::Any && term.value.size() >= 3)
+            {
+                std::vector<PresetQueryMatch> matches;
+                for (const auto slot : Search(term.value))
+                {
+                    matches.push_back({slot, 0.0f});
+                }
+                narrow(std::move(matches));
+                break;
+            }
+        }
+    }
+
+    if (!candidates)
+    {
+        candidates.emplace();
+        candidates->reserve(keys.size());
+        for (std::size_t slot = 0; slot < keys.size(); ++slot)
+        {
+            candidates->push_back({slot, 0.0f});
+        }
+    }
+
+    auto &matches = *candidates;
+    matches.erase(std::remove_if(matches.begin(), matches.end(),
+                                 [this, &query](PresetQueryMatch &match)
+                                 {
+                                     const auto &record = fields[match.index];
+                                     for (const auto &term : query.flags)
+                                     {
+                                         if ((term.pearlescent ? record.pearlescent : record.matte) != term.value)
+                                         {
+                                             return true;
+                                         }
+                                     }
+                                     for (const auto &term : query.text)
+                                     {
+                                         if (!MatchesText(match.index, term, match.score))
+                                         {
+                                             return true;
+                                         }
+                                     }
+                                     for (const auto &term : query.colors)
+                                     {
+                                         const auto &color = term.accent ? record.accentColor : record.primaryColor;
+                                         const float distanceSquared = ColorDistanceSquared(color, term.color);
+                                         if (distanceSquared > term.tolerance * term.tolerance)
+                                         {
+                                             return true;
+                                         }
+                                         match.score += 1.0f - std::sqrt(distanceSquared) / term.tolerance;
+                                     }
+                                     return false;
+                                 }),
+                  matches.end());
+
+    std::stable_sort(matches.begin(), matches.end(), [](const PresetQueryMatch &lhs, const PresetQueryMatch &rhs)
+                     {
+                         return lhs.score > rhs.score;
+                     });
+    return std::move(*candidates);
+}
+
+std::string PresetSearchIndex::ToLower(std::string_view text)
+{
+    std::string lower(text);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c)
+                   {
+                       return static_cast<char>(std::tolower(c));
+                   });
+    return lower;
+}
+
+void PresetSearchIndex::AddTrigrams(std::size_t slot) const
+{
+    for (const auto trigram : UniqueTrigrams(keys[slot]))
+    {
+        InsertPosting(trigramPostings[trigram], static_cast<std::uint32_t>(slot));
+    }
+}
+
+void PresetSearchIndex::RemoveTrigrams(std::size_t slot) const
+{
+    for (const auto trigram : UniqueTrigrams(keys[slot]))
+    {
+        ErasePosting(trigramPostings, trigram, static_cast<std::uint32_t>(slot));
+    }
+}
+
+void PresetSearchIndex::EnsureTrigramIndex() const
+{
+    if (trigramIndexBuilt)
+    {
+        return;
+    }
+
+    trigramPostings.clear();
+    for (std::size_t slot = 0; slot < keys.size(); ++slot)
+    {
+        AddTrigrams(slot);
+    }
+    trigramIndexBuilt = true;
+}
+
+void PresetSearchIndex::AddFieldPostings(std::size_t slot) const
+{
+    const auto &record = fields[slot];
+    const auto packedSlot = static_cast<std::uint32_t>(slot);
+    for (std::size_t field = 0; field < record.labels.size(); ++field)
+    {
+        InsertPosting(labelPostings[field][record.labels[field]], packedSlot);
+    }
+    if (record.matte)
+    {
+        InsertPosting(mattePostings, packedSlot);
+    }
+    if (record.pearlescent)
+    {
+        InsertPosting(pearlescentPostings, packedSlot);
+    }
+    // One posting per product and slot, even when both teams or several slots share the item.
+    for (std::size_t i = 0; i < record.itemCount; ++i)
+    {
+        InsertPosting(itemPostings[record.items[i]], packedSlot);
+    }
+}
+
+void PresetSearchIndex::RemoveFieldPostings(std::size_t slot) const
+{
+    const auto &record = fields[slot];
+    const auto packedSlot = static_cast<std::uint32_t>(slot);
+    for (std::size_t field = 0; field < record.labels.size(); ++field)
+    {
+        ErasePosting(labelPostings[field], record.labels[field], packedSlot);
+    }
+    if (record.matte)
+    {
+        ErasePosting(mattePostings, packedSlot);
+    }
+    if (record.pearlescent)
+    {
+        ErasePosting(pearlescentPostings, packedSlot);
+    }
+    for (std::size_t i = 0; i < record.itemCount; ++i)
+    {
+        ErasePosting(itemPostings, record.items[i], packedSlot);
+    }
+}
+
+void PresetSearchIndex::EnsureFieldIndex() const
+{
+    if (fieldIndexBuilt)
+    {
+        return;
+    }
+
+    for (std::size_t slot = 0; slot < fields.size(); ++slot)
+    {
+        AddFieldPostings(slot);
+    }
+    fieldIndexBuilt = true;
+}
+
+void PresetSearchIndex::AddPostings(std::size_t slot) const
+{
+    if (trigramIndexBuilt)
+    {
+        AddTrigrams(slot);
+    }
+    if (fieldIndexBuilt)
+    {
+        AddFieldPostings(slot);
+    }
+}
+
+void PresetSearchIndex::RemovePostings(std::size_t slot) const
+{
+    if (trigramIndexBuilt)
+    {
+        RemoveTrigrams(slot);
+    }
+    if (fieldIndexBuilt)
+    {
+        RemoveFieldPostings(slot);
+    }
+}
+
+void PresetSearchIndex::InvalidateIndices() noexcept
+{
+    trigramPostings.clear();
+    trigramIndexBuilt = false;
+
+    for (auto &postings : labelPostings)
+    {
+        postings.clear();
+    }
+    mattePostings.clear();
+    pearlescentPostings.clear();
+    itemPostings.clear();
+    fieldIndexBuilt = false;
+}
+
+const std::string &PresetSearchIndex::LowercaseLabel(PresetLabelId id) const
+{
+    while (lowercaseLabels.size() < labels.Size())
+    {
+        lowercaseLabels.push_back(ToLower(labels.Resolve(static_cast<PresetLabelId>(lowercaseLabels.size()))));
+    }
+
+    static const std::string unknownLabel;
+    return id < lowercaseLabels.size() ? lowercaseLabels[id] : unknownLabel;
+}
+
+std::vector<PresetQueryMatch> PresetSearchIndex::MatchLabel(const PresetQuery::LabelTerm &term) const
+{
+    // There are only a few hundred distinct labels per field, so scanning the vocabulary and
+    // ranking exact > prefix > substring matches is cheap; each slot has one label per field,
+    // which keeps the merged postings free of duplicates.
+    std::vector<PresetQueryMatch> matches;
+    std::size_t matchedLabels = 0;
+    for (const auto &[labelId, postings] : labelPostings[static_cast<std::size_t>(term.field)])
+    {
+        const auto &label = LowercaseLabel(labelId);
+        float score = 0.0f;
+        if (label == term.value)
+        {
+            score = 3.0f;
+        }
+        else if (label.compare(0, term.value.size(), term.value) == 0)
+        {
+            score = 2.0f;
+        }
+        else if (label.find(term.value) != std::string::npos)
+        {
+            score = 1.0f;
+        }
+        else
+        {
+            continue;
+        }
+
+        ++matchedLabels;
+        for (const auto slot : postings)
+        {
+            matches.push_back({slot, score});
+        }
+    }
+
+    // A single posting list is already in slot order.
+    if (matchedLabels > 1)
+    {
+        std::sort(matches.begin(), matches.end(), [](const PresetQueryMatch &lhs, const PresetQueryMatch &rhs)
+                  {
+                      return lhs.index < rhs.index;
+                  });
+    }
+    return matches;
+}
+
+bool PresetSearchIndex::MatchesText(std::size_t slot, const PresetQuery::TextTerm &term, float &score) const
+{
+    const std::string_view key = keys[slot];
+    const auto separator = key.find('\0');
+    const auto name = key.substr(0, separator);
+    const auto loadoutCode = key.substr(separator + 1);
+
+    const bool checkName = term.field != PresetQuery::TextField::LoadoutCode;
+    const bool checkCode = term.field != PresetQuery::TextField::Name;
+    if (checkName && name.find(term.value) != std::string_view::npos)
+    {
+        // Name hits rank above loadout code hits, and a name prefix above both.
+        score += name.compare(0, term.value.size(), term.value) == 0 ? 1.5f : 1.0f;
+        return true;
+    }
+    if (checkCode && loadoutCode.find(term.value) != std::string_view::npos)
+    {
+        score += 0.5f;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "LoadoutCode.h"
+#include "PresetLabelPool.h"
+#include "PresetQuery.h"
+#include "PresetTypes.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Case-insensitive substring search over preset names and loadout codes, plus structured
+// PresetQuery evaluation over the customization fields. Lowercased keys are computed once per
+// add/edit. Queries with three or more characters on large collections go through a trigram
+// index, and label/finish/item terms through per-field inverted indices; both are built on first
+// use and from then on updated in place for the slots an add, edit or removal touches.
+class PresetSearchIndex
+{
+public:
+    // Both must outlive the index. `labels` resolves the label ids stored in presets, and
+    // `loadouts` holds the decoded loadout code of each slot, kept in sync by the owner before
+    // Assign/SwapRemove is called for that slot.
+    PresetSearchIndex(const PresetLabelPool &labels, const std::vector<LoadoutCode::Loadout> &loadouts);
+
+    void Clear();
+    void Reserve(std::size_t count);
+
+    // Keeps the key at `slot` in sync with `preset`; `slot` may be one past the end to append.
+    void Assign(std::size_t slot, const CustomPreset &preset);
+    // Moves the last slot into `slot` and drops the last one, matching PresetManager's removals.
+    void SwapRemove(std::size_t slot);
+
+    // Slots whose key contains `filter`, in ascending order. An empty filter matches everything.
+    [[nodiscard]] std::vector<std::size_t> Search(std::string_view filter) const;
+
+    // Drops the slots in `candidates` that do not match `filter`. Only valid when `candidates`
+    // came from a query whose filter is a substring of `filter` and nothing changed since.
+    void Refine(std::string_view filter, std::vector<std::size_t> &candidates) const;
+
+    // Matching slots ordered by descending score, ties in slot order.
+    [[nodiscard]] std::vector<PresetQueryMatch> Query(const PresetQuery &query) const;
+
+    [[nodiscard]] static std::string ToLower(std::string_view text);
+
+private:
+    // Below this size a linear scan over the keys is faster than maintaining postings.
+    static constexpr std::size_t trigramIndexThreshold = 2048;
+
+    // "name\0loadoutcode", lowercased. The separator cannot be typed into the search box, so
+    // no match can span both fields.
+    std::vector<std::string> keys;
+
+    const PresetLabelPool &labels;
+    const std::vector<LoadoutCode::Loadout> &loadouts;
+    // Lowercased pool labels by id. The pool is append-only, so entries never go stale.
+    mutable std::vector<std::string> lowercaseLabels;
+
+    struct FieldRecord
+    {
+        // Car, decal and wheels label ids, indexed by PresetQuery::LabelField.
+        std::array<PresetLabelId, 3> labels{};
+        PresetPaintColor primaryColor;
+        PresetPaintColor accentColor;
+        bool matte{false};
+        bool pearlescent{false};
+        // Distinct product ids of the slot's loadout, kept because the owner has already replaced
+        // the decoded loadout by the time an edit has to take the old postings out.
+        std::array<std::uint16_t, 2 * LoadoutCode::maxItemsPerTeam> items{};
+        std::uint8_t itemCount{0};
+    };
+    std::vector<FieldRecord> fields;
+
+    using PostingList = std::vector<std::uint32_t>;
+    mutable std::array<std::unordered_map<PresetLabelId, PostingList>, 3> labelPostings;
+    mutable PostingList mattePostings;
+    mutable PostingList pearlescentPostings;
+    mutable std::unordered_map<std::uint16_t, PostingList> itemPostings;
+    mutable bool fieldIndexBuilt{false};
+
+    mutable std::unordered_map<std::uint32_t, PostingList> trigramPostings;
+    mutable bool trigramIndexBuilt{false};
+
+    void AddTrigrams(std::size_t slot) const;
+    void RemoveTrigrams(std::size_t slot) const;
+    void EnsureTrigramIndex() const;
+    void AddFieldPostings(std::size_t slot) const;
+    void RemoveFieldPostings(std::size_t slot) const;
+    void EnsureFieldIndex() const;
+    // Adds or removes `slot` in whichever indices are built.
+    void AddPostings(std::size_t slot) const;
+    void RemovePostings(std::size_t slot) const;
+    void InvalidateIndices() noexcept;
+
+    [[nodiscard]] const std::string &LowercaseLabel(PresetLabelId id) const;
+    [[nodiscard]] std::vector<PresetQueryMatch> MatchLabel(const PresetQuery::LabelTerm &term) const;
+    [[nodiscard]] bool MatchesText(std::size_t slot, const PresetQuery::TextTerm &term, float &score) const;
+};
@@ -0,0 +1,223 @@
+#include "PresetSerialization.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace PresetSerialization
+{
+namespace
+{
+// Decimals SerializeColorToken writes per component.
+constexpr int colorTokenDecimals = 3;
+constexpr double colorTokenScale = 1000.0; // 10 ^ colorTokenDecimals
+
+long long ColorTokenStep(float component) noexcept
+{
+    // Scaled in double, where a float times 1000 is exact, and rounded half to even like the
+    // stream does. Parsing clamps negative components to zero, so they all write the same token.
+    return std::llrint(static_cast<double>(std::max(0.0f, component)) * colorTokenScale);
+}
+
+constexpr std::size_t maxPresetFields = 9;
+constexpr std::string_view whitespace{" \t\r\n"};
+
+// Splits like repeated std::getline calls would: an empty trailing field after the last
+// delimiter is dropped, empty fields in between are kept. Stops after `tokens.size()` fields.
+template <std::size_t N>
+std::size_t SplitFields(std::string_view text, char delimiter, std::array<std::string_view, N> &tokens) noexcept
+{
+    std::size_t count = 0;
+    while (!text.empty() && count < N)
+    {
+        const auto position = text.find(delimiter);
+        tokens[count++] = text.substr(0, position);
+        text.remove_prefix(position == std::string_view::npos ? text.size() : position + 1);
+    }
+    return count;
+}
+
+// Mirrors std::stof without exceptions: leading whitespace, an optional sign and hexadecimal
+// input are accepted, anything that does not convert (or is out of range) yields 0.
+float ParseFloatComponent(std::string_view text) noexcept
+{
+    const auto first = text.find_first_not_of(" \t\n\v\f\r");
+    if (first == std::string_view::npos)
+    {
+        return 0.0f;
+    }
+    text.remove_prefix(first);
+
+    bool negative = false;
+    if (text.front() == '+' || text.front() == '-')
+    {
+        negative = text.front() == '-';
+        text.remove_prefix(1);
+        if (text.empty() || text.front() == '+' || text.front() == '-')
+        {
+            return 0.0f;
+        }
+    }
+
+    auto format = std::chars_format::general;
+    if (text.size() >= 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+    {
+        // "0x" without hex digits after it converts as a plain "0".
+        const bool hasHexDigits = text.size() > 2 && (std::isxdigit(static_cast<unsigned char>(text[2])) || text[2] == '.');
+        if (!hasHexDigits)
+        {
+            return 0.0f;
+        }
+        format = std::chars_format::hex;
+        text.remove_prefix(2);
+    }
+
+    float value = 0.0f;
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value, format);
+    // std::stof reports underflow into the subnormal range as out of range as well.
+    if (result.ec != std::errc{} || (value != 0.0f && std::fabs(value) < std::numeric_limits<float>::min()))
+    {
+        return 0.0f;
+    }
+
+    return negative ? -value : value;
+}
+
+bool IsFlagSet(std::string_view token, std::string_view keyword) noexcept
+{
+    return token == "1" || token == "true" || token == keyword;
+}
+
+void AssignField(PresetString &target, std::string_view value)
+{
+    target.assign(value.data(), value.size());
+}
+} // namespace
+
+std::string_view TrimWhitespace(std::string_view text) noexcept
+{
+    const auto first = text.find_first_not_of(whitespace);
+    if (first == std::string_view::npos)
+    {
+        return {};
+    }
+    const auto last = text.find_last_not_of(whitespace);
+    return text.substr(first, last - first + 1);
+}
+
+PresetPaintColor ParseColorToken(std::string_view token) noexcept
+{
+    std::array<std::string_view, 3> components{};
+    const auto count = SplitFields(token, ',', components);
+
+    std::array<float, 3> values{};
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const float value = std::max(0.0f, ParseFloatComponent(components[i]));
+        values[i] = value > 1.0f ? value / 255.0f : value;
+    }
+
+    return {values[0], values[1], values[2]};
+}
+
+bool ParsePresetLine(std::string_view line, PresetLineFields &fields) noexcept
+{
+    std::array<std::string_view, maxPresetFields> tokens{};
+    const auto count = SplitFields(line, '|', tokens);
+    if (count < 2)
+    {
+        return false;
+    }
+
+    const PresetCustomization defaults{};
+    fields.name = TrimWhitespace(tokens[0]);
+    fields.loadoutCode = TrimWhitespace(tokens[1]);
+    fields.primaryColor = count >= 3 ? ParseColorToken(tokens[2]) : defaults.primaryColor;
+    fields.accentColor = count >= 4 ? ParseColorToken(tokens[3]) : defaults.accentColor;
+    fields.carLabel = count >= 5 ? TrimWhitespace(tokens[4]) : defaultCarLabelText;
+    fields.decalLabel = count >= 6 ? TrimWhitespace(tokens[5]) : defaultDecalLabelText;
+    fields.wheelsLabel = count >= 7 ? TrimWhitespace(tokens[6]) : defaultWheelsLabelText;
+    fields.paintFinishMatte = count >= 8 ? IsFlagSet(tokens[7], "matte") : defaults.paintFinishMatte;
+    fields.paintFinishPearlescent = count >= 9 ? IsFlagSet(tokens[8], "pearlescent") : defaults.paintFinishPearlescent;
+    return true;
+}
+
+bool ParseVanillaLine(std::string_view line, std::string_view &name, std::string_view &loadoutCode) noexcept
+{
+    const auto delimiterPos = line.find_last_of("\t ");
+    if (delimiterPos == std::string_view::npos)
+    {
+        return false;
+    }
+
+    name = TrimWhitespace(line.substr(0, delimiterPos));
+    loadoutCode = TrimWhitespace(line.substr(delimiterPos + 1));
+    return !name.empty() && !loadoutCode.empty();
+}
+
+void AssignPreset(const PresetLineFields &fields, PresetLabelPool &labels, CustomPreset &preset)
+{
+    AssignField(preset.name, fields.name);
+    AssignField(preset.loadoutCode, fields.loadoutCode);
+
+    auto &customization = preset.customization;
+    customization.primaryColor = fields.primaryColor;
+    customization.accentColor = fields.accentColor;
+    customization.carLabel = labels.Intern(fields.carLabel, defaultCarLabelId);
+    customization.decalLabel = labels.Intern(fields.decalLabel, defaultDecalLabelId);
+    customization.wheelsLabel = labels.Intern(fields.wheelsLabel, defaultWheelsLabelId);
+    customization.paintFinishMatte = fields.paintFinishMatte;
+    customization.paintFinishPearlescent = fields.paintFinishPearlescent;
+}
+
+std::string SerializeColorToken(const PresetPaintColor &color)
+{
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(colorTokenDecimals)
+           << color.r << ','
+           << color.g << ','
+           << color.b;
+    return stream.str();
+}
+
+bool SameColorToken(const PresetPaintColor &lhs, const PresetPaintColor &rhs) noexcept
+{
+    return ColorTokenStep(lhs.r) == ColorTokenStep(rhs.r) && ColorTokenStep(lhs.g) == ColorTokenStep(rhs.g) &&
+           ColorTokenStep(lhs.b) == ColorTokenStep(rhs.b);
+}
+
+void WritePresetLine(std::ostream &stream, const CustomPreset &preset, const PresetLabelPool &labels)
+{
+    stream << preset.name << '|'
+           << preset.loadoutCode << '|'
+           << SerializeColorToken(preset.customization.primaryColor) << '|'
+           << SerializeColorToken(preset.customization.accentColor) << '|'
+           << labels.Resolve(preset.customization.carLabel) << '|'
+           << labels.Resolve(preset.customization.decalLabel) << '|'
+           << labels.Resolve(preset.customization.wheelsLabel) << '|'
+           << (preset.customization.paintFinishMatte ? '1' : '0') << '|'
+           << (preset.customization.paintFinishPearlescent ? '1' : '0')
+           << '\n';
+}
+
+void WritePresets(std::ostream &stream, const CustomPresetCollection &presets, const PresetLabelPool &labels)
+{
+    for (const auto &preset : presets)
+    {
+        WritePresetLine(stream, preset, labels);
+    }
+}
+
+void WritePresets(std::ostream &stream, const PresetSnapshot &snapshot, const PresetLabelPool &labels)
+{
+    for (const auto &chunk : snapshot.GetChunks())
+    {
+        WritePresets(stream, *chunk, labels);
+    }
+}
+} // namespace PresetSerialization
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "PresetLabelPool.h"
+#include "PresetSnapshot.h"
+#include "PresetTypes.h"
+
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Helpers for the pipe-delimited expanded_presets.cfg format:
+// Name|LoadoutCode|primaryR,primaryG,primaryB|accentR,accentG,accentB|Car|Decal|Wheels|MatteFlag|PearlescentFlag
+//
+// The parsing side works on string_views into a caller-owned buffer (usually a MappedFile) and
+// never allocates; only copying the parsed name and loadout code into a CustomPreset and
+// interning previously unseen labels touches the heap.
+namespace PresetSerialization
+{
+[[nodiscard]] std::string_view TrimWhitespace(std::string_view text) noexcept;
+
+// Calls `callback(line)` for every line of `buffer` with surrounding whitespace removed,
+// skipping blank lines and '#' comments.
+template <typename Callback>
+void ForEachLine(std::string_view buffer, Callback &&callback)
+{
+    while (!buffer.empty())
+    {
+        const auto newline = buffer.find('\n');
+        const auto rawLine = buffer.substr(0, newline);
+        buffer.remove_prefix(newline == std::string_view::npos ? buffer.size() : newline + 1);
+
+        const auto line = TrimWhitespace(rawLine);
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+        callback(line);
+    }
+}
+
+// Accepts 0-1 floats and 0-255 values per component; unparsable components become 0.
+[[nodiscard]] PresetPaintColor ParseColorToken(std::string_view token) noexcept;
+
+// Fields of one storage line. The views point into the parsed line, or at static defaults for
+// fields the line omits.
+struct PresetLineFields
+{
+    std::string_view name;
+    std::string_view loadoutCode;
+    PresetPaintColor primaryColor{};
+    PresetPaintColor accentColor{};
+    std::string_view carLabel;
+    std::string_view decalLabel;
+    std::string_view wheelsLabel;
+    bool paintFinishMatte{false};
+    bool paintFinishPearlescent{false};
+};
+
+// Parses one trimmed storage line, filling omitted fields with the customization defaults.
+// Returns false for lines with fewer than two fields.
+bool ParsePresetLine(std::string_view line, PresetLineFields &fields) noexcept;
+
+// Parses one trimmed presets.data line ("Name<whitespace>LoadoutCode").
+bool ParseVanillaLine(std::string_view line, std::string_view &name, std::string_view &loadoutCode) noexcept;
+
+// Builds `preset` from parsed fields, interning the labels into `labels`. Reuses the string
+// capacity already held by `preset`.
+void AssignPreset(const PresetLineFields &fields, PresetLabelPool &labels, CustomPreset &preset);
+
+std::string SerializeColorToken(const PresetPaintColor &color);
+// True when both colours write the same token, i.e. they are equal at the precision the cfg keeps.
+[[nodiscard]] bool SameColorToken(const PresetPaintColor &lhs, const PresetPaintColor &rhs) noexcept;
+void WritePresetLine(std::ostream &stream, const CustomPreset &preset, const PresetLabelPool &labels);
+void WritePresets(std::ostream &stream, const CustomPresetCollection &presets, const PresetLabelPool &labels);
+void WritePresets(std::ostream &stream, const PresetSnapshot &snapshot, const PresetLabelPool &labels);
+} // namespace PresetSerialization
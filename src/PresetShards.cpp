@@ -0,0 +1,37 @@
+#include "PresetShards.h"
+
+#include "PresetBinaryCache.h"
+
+#include <cstdio>
+#include <system_error>
+
+namespace PresetShards
+{
+std::filesystem::path DirectoryFor(const std::filesystem::path &storageFilePath)
+{
+    return storageFilePath.parent_path() / "shards";
+}
+
+std::filesystem::path MarkerPath(const std::filesystem::path &shardDirectory)
+{
+    return shardDirectory / "layout.txt";
+}
+
+std::filesystem::path ShardPath(const std::filesystem::path &shardDirectory, std::size_t index)
+{
+    char name[24];
+    std::snprintf(name, sizeof(name), "shard_%02zu.cfg", index);
+    return shardDirectory / name;
+}
+
+bool IsActive(const std::filesystem::path &shardDirectory)
+{
+    std::error_code error;
+    return std::filesystem::exists(MarkerPath(shardDirectory), error);
+}
+
+std::size_t ShardOf(std::string_view presetName) noexcept
+{
+    return static_cast<std::size_t>(PresetBinaryCache::HashContents(presetName) % shardCount);
+}
+} // namespace PresetShards
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "PresetTypes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+// Optional storage layout for large libraries: instead of one expanded_presets.cfg, presets are
+// spread over `shardCount` files in ExpandedPresets/shards by a hash of their name, each in the
+// cfg line format. Saves then rewrite only the shards whose presets changed, and loads parse
+// the shards in parallel. The layout is active while shards/layout.txt exists; that marker is
+// written after the shards and removed before them, so a crash mid-switch leaves one complete
+// layout in charge.
+namespace PresetShards
+{
+inline constexpr std::size_t shardCount = 64;
+// One bit per shard.
+using ShardMask = std::uint64_t;
+static_assert(shardCount == sizeof(ShardMask) * 8);
+inline constexpr ShardMask allShards = ~ShardMask{0};
+
+struct Shard
+{
+    std::size_t index{0};
+    CustomPresetCollection presets;
+};
+
+[[nodiscard]] std::filesystem::path DirectoryFor(const std::filesystem::path &storageFilePath);
+[[nodiscard]] std::filesystem::path MarkerPath(const std::filesystem::path &shardDirectory);
+[[nodiscard]] std::filesystem::path ShardPath(const std::filesystem::path &shardDirectory, std::size_t index);
+[[nodiscard]] bool IsActive(const std::filesystem::path &shardDirectory);
+
+[[nodiscard]] std::size_t ShardOf(std::string_view presetName) noexcept;
+[[nodiscard]] constexpr ShardMask MaskOf(std::size_t index) noexcept
+{
+    return ShardMask{1} << index;
+}
+} // namespace PresetShards
@@ -0,0 +1,42 @@
+#include "PresetSnapshot.h"
+
+#include "PresetStringArena.h"
+
+#include <algorithm>
+
+std::shared_ptr<const PresetSnapshot> PresetSnapshot::Publish(const PresetSnapshot *previous,
+                                                              const CustomPresetCollection &presets,
+                                                              const std::vector<bool> &dirtyChunks,
+                                                              std::uint64_t revision)
+{
+    auto snapshot = std::make_shared<PresetSnapshot>();
+    snapshot->revision = revision;
+    snapshot->presetCount = presets.size();
+
+    const auto chunkCount = (presets.size() + chunkSize - 1) / chunkSize;
+    snapshot->chunks.reserve(chunkCount);
+    for (std::size_t i = 0; i < chunkCount; ++i)
+    {
+        const auto first = i * chunkSize;
+        const auto count = std::min(chunkSize, presets.size() - first);
+        const bool dirty = i < dirtyChunks.size() && dirtyChunks[i];
+        if (previous && !dirty && i < previous->chunks.size() && previous->chunks[i]->size() == count)
+        {
+            snapshot->chunks.push_back(previous->chunks[i]);
+            ++snapshot->sharedChunks;
+            continue;
+        }
+
+        auto chunk = std::make_shared<CustomPresetCollection>();
+        chunk->reserve(count);
+        for (std::size_t index = first; index < first + count; ++index)
+        {
+            const auto &preset = presets[index];
+            chunk->push_back(CustomPreset{PresetString(preset.name, PresetStringArena::Heap()),
+                                          PresetString(preset.loadoutCode, PresetStringArena::Heap()),
+                                          preset.customization});
+        }
+        snapshot->chunks.push_back(std::move(chunk));
+    }
+    return snapshot;
+}
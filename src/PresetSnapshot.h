@@ -0,0 +1,78 @@
+#pragma once
+
+#include "PresetTypes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Immutable copy of the preset collection at one revision, for readers that must not see edits
+// land halfway: the storage writer, anything run on the worker pool, or UI code that iterates
+// while it edits. Presets are held in fixed-size chunks, and a new snapshot shares every chunk
+// of the previous one that holds no changed preset, so publishing after an edit copies a single
+// chunk rather than the library. Holding the shared_ptr is all a reader needs, on any thread;
+// indices are the collection's slots at the snapshot's revision.
+//
+// Strings are copied off PresetManager's arena onto the heap, so a snapshot stays valid after
+// the manager reloads or is destroyed.
+class PresetSnapshot
+{
+public:
+    static constexpr std::size_t chunkSize = 256;
+
+    using Chunk = std::shared_ptr<const CustomPresetCollection>;
+
+    // Builds the snapshot of `presets` at `revision`. Chunks of `previous` whose flag in
+    // `dirtyChunks` is clear (or lies past its end) are shared rather than copied.
+    [[nodiscard]] static std::shared_ptr<const PresetSnapshot> Publish(const PresetSnapshot *previous,
+                                                                       const CustomPresetCollection &presets,
+                                                                       const std::vector<bool> &dirtyChunks,
+                                                                       std::uint64_t revision);
+
+    [[nodiscard]] std::uint64_t GetRevision() const noexcept
+    {
+        return revision;
+    }
+
+    [[nodiscard]] std::size_t Size() const noexcept
+    {
+        return presetCount;
+    }
+
+    [[nodiscard]] const CustomPreset &operator[](std::size_t index) const noexcept
+    {
+        return (*chunks[index / chunkSize])[index % chunkSize];
+    }
+
+    [[nodiscard]] const std::vector<Chunk> &GetChunks() const noexcept
+    {
+        return chunks;
+    }
+
+    // Chunks this snapshot took over from the one it was published after.
+    [[nodiscard]] std::size_t GetSharedChunkCount() const noexcept
+    {
+        return sharedChunks;
+    }
+
+    template <typename Visitor>
+    void ForEach(Visitor &&visit) const
+    {
+        for (const auto &chunk : chunks)
+        {
+            for (const auto &preset : *chunk)
+            {
+                visit(preset);
+            }
+        }
+    }
+
+private:
+    std::uint64_t revision{0};
+    std::size_t presetCount{0};
+    std::size_t sharedChunks{0};
+    std::vector<Chunk> chunks;
+};
+
+using PresetSnapshotPtr = std::shared_ptr<const PresetSnapshot>;
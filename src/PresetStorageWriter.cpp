@@ -0,0 +1,379 @@
+#include "PresetStorageWriter.h"
+
+#include "PresetJournal.h"
+#include "PresetProfiler.h"
+#include "PresetSerialization.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+PresetStorageWriter::PresetStorageWriter(std::filesystem::path storageFilePath,
+                                         std::shared_ptr<const PresetLabelPool> labels,
+                                         LogCallback log)
+    : storageFilePath(std::move(storageFilePath)),
+      cacheFilePath(PresetBinaryCache::CachePathFor(this->storageFilePath)),
+      journalFilePath(PresetJournal::PathFor(this->storageFilePath)),
+      shardDirectory(PresetShards::DirectoryFor(this->storageFilePath)),
+      labels(std::move(labels)),
+      log(std::move(log))
+{
+    worker = std::thread(&PresetStorageWriter::Run, this);
+}
+
+PresetStorageWriter::~PresetStorageWriter()
+{
+    {
+        std::lock_guard lock(stateMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+
+    Flush();
+}
+
+void PresetStorageWriter::SetDebounceWindow(std::chrono::milliseconds window)
+{
+    {
+        std::lock_guard lock(stateMutex);
+        debounceWindow = std::max(window, std::chrono::milliseconds::zero());
+    }
+    wakeUp.notify_all();
+}
+
+std::uint64_t PresetStorageWriter::Schedule(PresetSnapshotPtr snapshot)
+{
+    std::uint64_t sequence = 0;
+    {
+        std::lock_guard lock(stateMutex);
+        // The deadline is anchored to the first request of a burst so a steady stream of edits
+        // still reaches disk at least once per window.
+        if (!pendingWrite)
+        {
+            pendingDeadline = std::chrono::steady_clock::now() + debounceWindow;
+        }
+        // Records still waiting are already part of the snapshot.
+        sequence = ++scheduledSequence;
+        pendingWrite = PendingWrite{PendingWrite::Kind::Full, std::move(snapshot), {}, std::nullopt, {}, sequence};
+    }
+    wakeUp.notify_all();
+    return sequence;
+}
+
+void PresetStorageWriter::ScheduleShards(std::vector<PresetShards::Shard> shards)
+{
+    {
+        std::lock_guard lock(stateMutex);
+        if (!pendingWrite)
+        {
+            pendingDeadline = std::chrono::steady_clock::now() + debounceWindow;
+        }
+
+        if (pendingWrite && pendingWrite->kind == PendingWrite::Kind::Shards)
+        {
+            auto &pending = pendingWrite->shards;
+            for (auto &shard : shards)
+            {
+                const auto it = std::find_if(pending.begin(), pending.end(), [&shard](const PresetShards::Shard &existing)
+                                             {
+                                                 return existing.index == shard.index;
+                                             });
+                if (it != pending.end())
+                {
+                    *it = std::move(shard);
+                }
+                else
+                {
+                    pending.push_back(std::move(shard));
+                }
+            }
+            // Like a full write, the shards already contain every journal record still waiting.
+            pendingWrite->journal.clear();
+        }
+        else
+        {
+            pendingWrite = PendingWrite{PendingWrite::Kind::Shards, {}, std::move(shards), std::nullopt, {}};
+        }
+    }
+    wakeUp.notify_all();
+}
+
+void PresetStorageWriter::ScheduleJournal(std::string records)
+{
+    {
+        std::lock_guard lock(stateMutex);
+        if (pendingWrite)
+        {
+            pendingWrite->journal += records;
+        }
+        else
+        {
+            pendingDeadline = std::chrono::steady_clock::now() + debounceWindow;
+            pendingWrite = PendingWrite{PendingWrite::Kind::JournalOnly, {}, {}, std::nullopt, std::move(records)};
+        }
+    }
+    wakeUp.notify_all();
+}
+
+bool PresetStorageWriter::ScheduleCacheRefresh(PresetSnapshotPtr snapshot, const PresetBinaryCache::SourceStamp &source)
+{
+    {
+        std::lock_guard lock(stateMutex);
+        if (pendingWrite && (pendingWrite->kind == PendingWrite::Kind::Full || pendingWrite->kind == PendingWrite::Kind::Shards))
+        {
+            return false;
+        }
+        if (!pendingWrite)
+        {
+            pendingDeadline = std::chrono::steady_clock::now() + debounceWindow;
+        }
+        auto journal = pendingWrite ? std::move(pendingWrite->journal) : std::string{};
+        pendingWrite = PendingWrite{PendingWrite::Kind::CacheOnly, std::move(snapshot), {}, source, std::move(journal)};
+    }
+    wakeUp.notify_all();
+    return true;
+}
+
+std::optional<PresetBinaryCache::SourceStamp> PresetStorageWriter::GetLastWrittenStamp() const
+{
+    std::lock_guard lock(stampMutex);
+    return lastWrittenStamp;
+}
+
+std::uint64_t PresetStorageWriter::GetWrittenSequence() const noexcept
+{
+    return writtenSequence.load(std::memory_order_acquire);
+}
+
+void PresetStorageWriter::RecordWrittenStamp(const std::optional<PresetBinaryCache::SourceStamp> &stamp)
+{
+    std::lock_guard lock(stampMutex);
+    lastWrittenStamp = stamp;
+}
+
+bool PresetStorageWriter::Flush()
+{
+    std::lock_guard writeLock(writeMutex);
+    const auto write = TakePendingWrite();
+    if (!write)
+    {
+        return true;
+    }
+
+    return Write(*write);
+}
+
+void PresetStorageWriter::Run()
+{
+    std::unique_lock lock(stateMutex);
+    while (true)
+    {
+        wakeUp.wait(lock, [this]
+                    {
+                        return stopping || pendingWrite.has_value();
+                    });
+        if (stopping)
+        {
+            break;
+        }
+
+        // Let the rest of the burst arrive; the destructor flushes whatever is left on shutdown.
+        if (wakeUp.wait_until(lock, pendingDeadline, [this]
+                              {
+                                  return stopping;
+                              }))
+        {
+            break;
+        }
+
+        lock.unlock();
+        {
+            std::lock_guard writeLock(writeMutex);
+            if (const auto write = TakePendingWrite())
+            {
+                Write(*write);
+            }
+        }
+        lock.lock();
+    }
+}
+
+std::optional<PresetStorageWriter::PendingWrite> PresetStorageWriter::TakePendingWrite()
+{
+    std::lock_guard lock(stateMutex);
+    std::optional<PendingWrite> write;
+    write.swap(pendingWrite);
+    return write;
+}
+
+bool PresetStorageWriter::Write(const PendingWrite &write)
+{
+    EXP_PRESETS_PROFILE_SCOPE(StorageWrite);
+    bool written = true;
+    switch (write.kind)
+    {
+    case PendingWrite::Kind::CacheOnly:
+        WriteCacheFile(*write.snapshot, *write.cacheOnlySource);
+        break;
+    case PendingWrite::Kind::JournalOnly:
+        break;
+    case PendingWrite::Kind::Shards:
+        written = WriteShardFiles(write.shards);
+        break;
+    case PendingWrite::Kind::Full:
+    default:
+        written = WriteStorageFile(*write.snapshot);
+        if (written)
+        {
+            // Writes are serialised by writeMutex and each takes the newest snapshot, so this only grows.
+            writtenSequence.store(write.sequence, std::memory_order_release);
+        }
+        break;
+    }
+
+    if (!write.journal.empty())
+    {
+        written = AppendToJournal(write.journal) && written;
+    }
+    return written;
+}
+
+bool PresetStorageWriter::WriteStorageFile(const PresetSnapshot &snapshot)
+{
+    std::ostringstream buffer;
+    PresetSerialization::WritePresets(buffer, snapshot, *labels);
+    const auto contents = buffer.str();
+
+    std::error_code error;
+    const auto directory = storageFilePath.parent_path();
+    if (!directory.empty())
+    {
+        std::filesystem::create_directories(directory, error);
+    }
+    if (!ReplaceFile(storageFilePath, contents, "storage file"))
+    {
+        return false;
+    }
+
+    // The cfg now holds every journaled edit, and takes over from the shards if they were in use.
+    std::filesystem::remove(journalFilePath, error);
+    if (std::filesystem::remove(PresetShards::MarkerPath(shardDirectory), error))
+    {
+        std::filesystem::remove_all(shardDirectory, error);
+    }
+
+    auto source = PresetBinaryCache::StatSource(storageFilePath);
+    RecordWrittenStamp(source);
+    if (source)
+    {
+        source->contentHash = PresetBinaryCache::HashContents(contents);
+        WriteCacheFile(snapshot, *source);
+    }
+
+    return true;
+}
+
+bool PresetStorageWriter::WriteShardFiles(const std::vector<PresetShards::Shard> &shards)
+{
+    std::error_code error;
+    std::filesystem::create_directories(shardDirectory, error);
+
+    bool written = true;
+    std::ostringstream buffer;
+    for (const auto &shard : shards)
+    {
+        const auto path = PresetShards::ShardPath(shardDirectory, shard.index);
+        if (shard.presets.empty())
+        {
+            std::filesystem::remove(path, error);
+            continue;
+        }
+
+        buffer.str({});
+        PresetSerialization::WritePresets(buffer, shard.presets, *labels);
+        written = ReplaceFile(path, buffer.str(), "storage shard") && written;
+    }
+    if (!written)
+    {
+        // Keep the journal; it still holds the edits the failed shards were meant to contain.
+        return false;
+    }
+
+    const auto markerPath = PresetShards::MarkerPath(shardDirectory);
+    if (!std::filesystem::exists(markerPath, error))
+    {
+        if (!ReplaceFile(markerPath, "Presets are split over the shard_NN.cfg files in this folder.\n", "shard layout marker"))
+        {
+            return false;
+        }
+        // The shards are authoritative from here on.
+        std::filesystem::remove(storageFilePath, error);
+        std::filesystem::remove(cacheFilePath, error);
+    }
+    std::filesystem::remove(journalFilePath, error);
+    return true;
+}
+
+bool PresetStorageWriter::ReplaceFile(const std::filesystem::path &path, std::string_view contents, std::string_view description)
+{
+    auto temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            log("ExpandedPresets: Failed to open " + std::string(description) + " for writing: " + temporaryPath.string());
+            return false;
+        }
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!file.flush())
+        {
+            log("ExpandedPresets: Failed to write " + std::string(description) + ": " + temporaryPath.string());
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        log("ExpandedPresets: Failed to replace " + std::string(description) + " " + path.string() + ": " + error.message());
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool PresetStorageWriter::AppendToJournal(const std::string &records)
+{
+    // One write call, so an interrupted append at worst leaves a single partial last record.
+    std::ofstream file(journalFilePath, std::ios::binary | std::ios::app);
+    if (!file)
+    {
+        log("ExpandedPresets: Failed to open journal for appending: " + journalFilePath.string());
+        return false;
+    }
+    file.write(records.data(), static_cast<std::streamsize>(records.size()));
+    if (!file.flush())
+    {
+        log("ExpandedPresets: Failed to append to journal: " + journalFilePath.string());
+        return false;
+    }
+    return true;
+}
+
+void PresetStorageWriter::WriteCacheFile(const PresetSnapshot &snapshot, const PresetBinaryCache::SourceStamp &source) const
+{
+    if (!PresetBinaryCache::Write(cacheFilePath, snapshot, *labels, source))
+    {
+        // The cfg is already safe on disk; without a cache the next startup just parses text.
+        std::error_code error;
+        std::filesystem::remove(cacheFilePath, error);
+        log("ExpandedPresets: Failed to write preset cache: " + cacheFilePath.string());
+    }
+}
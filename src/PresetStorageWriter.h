@@ -0,0 +1,133 @@
+#pragma once
+
+#include "PresetBinaryCache.h"
+#include "PresetLabelPool.h"
+#include "PresetShards.h"
+#include "PresetSnapshot.h"
+#include "PresetTypes.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+// Write-behind persistence for expanded_presets.cfg. Save requests hand over a PresetSnapshot of the
+// collection and return immediately; a background thread coalesces every request that arrives
+// within the debounce window and writes only the newest snapshot. Files are written to a
+// temporary sibling and renamed over the target so a crash never leaves a truncated cfg behind.
+// Single edits are appended to expanded_presets.journal instead (see PresetJournal), which each
+// full write folds in and deletes.
+// Every cfg write is followed by a matching expanded_presets.bin snapshot (see PresetBinaryCache).
+// In the sharded layout (see PresetShards) only the changed shard files are rewritten instead.
+class PresetStorageWriter
+{
+public:
+    using LogCallback = std::function<void(const std::string &)>;
+
+    static constexpr std::chrono::milliseconds defaultDebounceWindow{500};
+
+    // Labels in scheduled snapshots are resolved through `labels` on the writer thread.
+    PresetStorageWriter(std::filesystem::path storageFilePath,
+                        std::shared_ptr<const PresetLabelPool> labels,
+                        LogCallback log);
+    ~PresetStorageWriter();
+
+    PresetStorageWriter(const PresetStorageWriter &) = delete;
+    PresetStorageWriter &operator=(const PresetStorageWriter &) = delete;
+
+    void SetDebounceWindow(std::chrono::milliseconds window);
+
+    // Queues a snapshot for writing, replacing any snapshot that has not been written yet. The
+    // snapshot must include every journaled edit, since the write deletes the journal. Returns the
+    // sequence number GetWrittenSequence() reaches once this snapshot (or a newer one) is on disk.
+    std::uint64_t Schedule(PresetSnapshotPtr snapshot);
+
+    // Queues shard files for rewriting, merged with shards still waiting to be written. An empty
+    // shard deletes its file. The first shard write after using the single-file layout must
+    // include every shard, since it switches the layout over and deletes the cfg.
+    void ScheduleShards(std::vector<PresetShards::Shard> shards);
+
+    // Queues encoded journal records (see PresetJournal) for appending. Records scheduled after a
+    // pending full write are appended once that write has replaced the journal.
+    void ScheduleJournal(std::string records);
+
+    // Queues only a binary cache refresh for a cfg that was just parsed from text and is described
+    // by `source`. Ignored, returning false, while a cfg write is pending, since that writes a
+    // fresh cache anyway.
+    bool ScheduleCacheRefresh(PresetSnapshotPtr snapshot, const PresetBinaryCache::SourceStamp &source);
+
+    // Size and modification time of the cfg right after this writer last wrote it, so file
+    // watchers can tell our own writes from external edits. Safe to call from any thread.
+    [[nodiscard]] std::optional<PresetBinaryCache::SourceStamp> GetLastWrittenStamp() const;
+
+    // Sequence number of the newest scheduled snapshot that has been written to the cfg, 0 before
+    // the first. Safe to call from any thread.
+    [[nodiscard]] std::uint64_t GetWrittenSequence() const noexcept;
+
+    // Writes the pending snapshot (if any) on the calling thread and waits for an in-flight
+    // background write to finish first. Returns false if the write failed.
+    bool Flush();
+
+private:
+    struct PendingWrite
+    {
+        enum class Kind
+        {
+            Full,
+            // The cfg on disk already matches `snapshot` and only the cache needs writing.
+            CacheOnly,
+            JournalOnly,
+            Shards,
+        };
+
+        Kind kind{Kind::Full};
+        PresetSnapshotPtr snapshot;
+        std::vector<PresetShards::Shard> shards;
+        std::optional<PresetBinaryCache::SourceStamp> cacheOnlySource;
+        // Appended to the journal after the write above, if any.
+        std::string journal;
+        // Set for full writes; see Schedule().
+        std::uint64_t sequence{0};
+    };
+
+    std::filesystem::path storageFilePath;
+    std::filesystem::path cacheFilePath;
+    std::filesystem::path journalFilePath;
+    std::filesystem::path shardDirectory;
+    std::shared_ptr<const PresetLabelPool> labels;
+    LogCallback log;
+
+    // Serialises file access between the background thread and Flush(). Always taken before
+    // stateMutex so an older snapshot can never be written over a newer one.
+    std::mutex writeMutex;
+    std::mutex stateMutex;
+    std::condition_variable wakeUp;
+    std::optional<PendingWrite> pendingWrite;
+    std::chrono::steady_clock::time_point pendingDeadline{};
+    std::chrono::milliseconds debounceWindow{defaultDebounceWindow};
+    bool stopping{false};
+    std::uint64_t scheduledSequence{0};
+    std::atomic<std::uint64_t> writtenSequence{0};
+    std::thread worker;
+
+    mutable std::mutex stampMutex;
+    std::optional<PresetBinaryCache::SourceStamp> lastWrittenStamp;
+
+    void Run();
+    std::optional<PendingWrite> TakePendingWrite();
+    bool Write(const PendingWrite &write);
+    bool WriteStorageFile(const PresetSnapshot &snapshot);
+    bool WriteShardFiles(const std::vector<PresetShards::Shard> &shards);
+    // Writes `contents` to a temporary sibling of `path` and renames it over `path`.
+    bool ReplaceFile(const std::filesystem::path &path, std::string_view contents, std::string_view description);
+    bool AppendToJournal(const std::string &records);
+    void RecordWrittenStamp(const std::optional<PresetBinaryCache::SourceStamp> &stamp);
+    void WriteCacheFile(const PresetSnapshot &snapshot, const PresetBinaryCache::SourceStamp &source) const;
+};
@@ -0,0 +1,99 @@
+#include "PresetStringArena.h"
+
+#include <new>
+
+namespace
+{
+class PlainHeapResource final : public std::pmr::memory_resource
+{
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        {
+            return ::operator new(bytes);
+        }
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+
+    void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override
+    {
+        if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        {
+            ::operator delete(pointer, bytes);
+            return;
+        }
+        ::operator delete(pointer, bytes, std::align_val_t(alignment));
+    }
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+} // namespace
+
+PresetStringArena::PresetStringArena()
+    : blocks(initialBlockBytes, &upstream)
+{
+}
+
+std::pmr::memory_resource *PresetStringArena::Heap() noexcept
+{
+    static PlainHeapResource heap;
+    return &heap;
+}
+
+PresetStringArena::Stats PresetStringArena::GetStats() const noexcept
+{
+    return Stats{allocations, bytesUsed, upstream.blocks, upstream.bytes};
+}
+
+std::ptrdiff_t PresetStringArena::Stats::EstimatedBytesSaved() const noexcept
+{
+    const auto avoided = static_cast<std::ptrdiff_t>(allocations * heapOverheadPerAllocation);
+    const auto unused = static_cast<std::ptrdiff_t>(bytesReserved) - static_cast<std::ptrdiff_t>(bytesUsed);
+    return avoided - unused;
+}
+
+void PresetStringArena::Release() noexcept
+{
+    blocks.release();
+    allocations = 0;
+    bytesUsed = 0;
+}
+
+void *PresetStringArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    ++allocations;
+    bytesUsed += bytes;
+    return blocks.allocate(bytes, alignment);
+}
+
+void PresetStringArena::do_deallocate(void *, std::size_t, std::size_t)
+{
+    // Monotonic: memory only comes back with Release().
+}
+
+bool PresetStringArena::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
+
+void *PresetStringArena::BlockCounter::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    ++blocks;
+    this->bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void PresetStringArena::BlockCounter::do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment)
+{
+    --blocks;
+    this->bytes -= bytes;
+    std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+}
+
+bool PresetStringArena::BlockCounter::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
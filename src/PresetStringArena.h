@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+// Monotonic memory for the names and loadout codes held by PresetManager. Loads and imports
+// place their strings in a few large blocks instead of making one heap allocation per string.
+// Nothing is handed back until Release(), which the manager calls when it drops the whole
+// collection, so strings replaced by edits stay allocated until the next reload.
+class PresetStringArena final : public std::pmr::memory_resource
+{
+public:
+    struct Stats
+    {
+        // Strings placed in the arena, each of which would otherwise have been a heap allocation.
+        std::size_t allocations{0};
+        std::size_t bytesUsed{0};
+        std::size_t blocks{0};
+        std::size_t bytesReserved{0};
+
+        // Heap overhead avoided minus the unused tail of the blocks; negative while the arena is
+        // mostly empty.
+        [[nodiscard]] std::ptrdiff_t EstimatedBytesSaved() const noexcept;
+    };
+
+    PresetStringArena();
+
+    PresetStringArena(const PresetStringArena &) = delete;
+    PresetStringArena &operator=(const PresetStringArena &) = delete;
+
+    // Counted since the last Release().
+    [[nodiscard]] Stats GetStats() const noexcept;
+    // Frees every block at once. Nothing allocated from the arena may be touched afterwards.
+    void Release() noexcept;
+
+    // Stateless, thread-safe heap resource for copies that leave the arena, such as the storage
+    // writer's snapshots. Unlike std::pmr::new_delete_resource() in libstdc++, which always takes
+    // the slower aligned operator new, it uses the plain one for ordinary alignments.
+    [[nodiscard]] static std::pmr::memory_resource *Heap() noexcept;
+
+    // Rough per-allocation header and rounding cost of the general-purpose heap, used to estimate
+    // what the arena saves.
+    static constexpr std::size_t heapOverheadPerAllocation = 16;
+
+private:
+    // Counts the blocks the monotonic resource takes from the heap.
+    class BlockCounter final : public std::pmr::memory_resource
+    {
+    public:
+        std::size_t blocks{0};
+        std::size_t bytes{0};
+
+    private:
+        void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+        void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override;
+        [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+    };
+
+    static constexpr std::size_t initialBlockBytes = 64 * 1024;
+
+    BlockCounter upstream;
+    std::pmr::monotonic_buffer_resource blocks;
+    std::size_t allocations{0};
+    std::size_t bytesUsed{0};
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override;
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
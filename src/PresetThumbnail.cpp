@@ -0,0 +1,119 @@
+#include "PresetThumbnail.h"
+
+#include "PresetHotColumns.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace
+{
+using Rgb = std::array<float, 3>;
+
+Rgb Unpack(std::uint32_t packed) noexcept
+{
+    return {static_cast<float>(packed & 0xFFu), static_cast<float>(packed >> 8 & 0xFFu), static_cast<float>(packed >> 16 & 0xFFu)};
+}
+
+// Signed distance from (x, y) to a rounded rectangle; negative inside.
+float RoundedRectDistance(float x, float y, float minX, float minY, float maxX, float maxY, float radius) noexcept
+{
+    const float halfWidth = (maxX - minX) * 0.5f;
+    const float halfHeight = (maxY - minY) * 0.5f;
+    radius = std::min({radius, halfWidth, halfHeight});
+    const float qx = std::abs(x - (minX + halfWidth)) - halfWidth + radius;
+    const float qy = std::abs(y - (minY + halfHeight)) - halfHeight + radius;
+    const float outside = std::hypot(std::max(qx, 0.0f), std::max(qy, 0.0f));
+    return outside + std::min(std::max(qx, qy), 0.0f) - radius;
+}
+
+float CircleDistance(float x, float y, float centerX, float centerY, float radius) noexcept
+{
+    return std::hypot(x - centerX, y - centerY) - radius;
+}
+
+// One pixel of antialiasing around each edge.
+float Coverage(float distance) noexcept
+{
+    return std::clamp(0.5f - distance, 0.0f, 1.0f);
+}
+
+void Blend(Rgb &destination, const Rgb &source, float alpha) noexcept
+{
+    for (std::size_t i = 0; i < destination.size(); ++i)
+    {
+        destination[i] += (source[i] - destination[i]) * alpha;
+    }
+}
+} // namespace
+
+namespace PresetThumbnail
+{
+void Rasterize(Key key, std::uint32_t *pixels, std::size_t stride) noexcept
+{
+    const Rgb primary = Unpack(static_cast<std::uint32_t>(key));
+    const Rgb accent = Unpack(static_cast<std::uint32_t>(key >> 24));
+    const auto flags = static_cast<std::uint8_t>(key >> 48);
+    const Rgb background{0.07f * 255.0f, 0.08f * 255.0f, 0.09f * 255.0f};
+    const Rgb wheel{0.12f * 255.0f, 0.12f * 255.0f, 0.12f * 255.0f};
+    const Rgb highlight{255.0f, 255.0f, 255.0f};
+
+    // The preview panel's layout, scaled from its 160 px height.
+    constexpr float w = static_cast<float>(width);
+    constexpr float h = static_cast<float>(height);
+    constexpr float scale = h / 160.0f;
+    constexpr float padding = 18.0f * scale;
+    constexpr float bodyMinX = padding;
+    constexpr float bodyMinY = padding;
+    constexpr float bodyMaxX = w - padding;
+    constexpr float bodyMaxY = h - padding;
+    constexpr float bodyHeight = bodyMaxY - bodyMinY;
+    constexpr float stripeMinY = bodyMinY + bodyHeight * 0.45f;
+    constexpr float stripeMaxY = bodyMaxY - bodyHeight * 0.25f;
+    constexpr float wheelRadius = 30.0f * scale;
+    constexpr float wheelY = bodyMaxY - 25.0f * scale;
+    constexpr float leftWheelX = bodyMinX + 60.0f * scale;
+    constexpr float rightWheelX = bodyMaxX - 60.0f * scale;
+
+    // Gloss gets a soft highlight along the roof, pearlescent a wider, accent-tinted one and
+    // matte none, so finishes can be told apart at a glance.
+    const bool matte = (flags & PresetHotColumns::Matte) != 0;
+    const bool pearlescent = (flags & PresetHotColumns::Pearlescent) != 0;
+    const float sheen = matte ? 0.0f : pearlescent ? 0.28f : 0.18f;
+    Rgb sheenColor = highlight;
+    if (pearlescent)
+    {
+        Blend(sheenColor, accent, 0.35f);
+    }
+
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        auto *row = pixels + y * stride;
+        const float py = static_cast<float>(y) + 0.5f;
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            const float px = static_cast<float>(x) + 0.5f;
+            const float alpha = Coverage(RoundedRectDistance(px, py, 0.0f, 0.0f, w, h, 12.0f * scale));
+
+            const float body = Coverage(RoundedRectDistance(px, py, bodyMinX, bodyMinY, bodyMaxX, bodyMaxY, 22.0f * scale));
+            Rgb pixel = background;
+            Blend(pixel, primary, body);
+            if (body > 0.0f && sheen > 0.0f)
+            {
+                const float fade = std::clamp(1.0f - (py - bodyMinY) / (bodyHeight * (pearlescent ? 0.5f : 0.35f)), 0.0f, 1.0f);
+                Blend(pixel, sheenColor, sheen * fade * body);
+            }
+            Blend(pixel, accent, Coverage(RoundedRectDistance(px, py, bodyMinX, stripeMinY, bodyMaxX, stripeMaxY, 18.0f * scale)));
+            Blend(pixel, wheel, Coverage(CircleDistance(px, py, leftWheelX, wheelY, wheelRadius)));
+            Blend(pixel, wheel, Coverage(CircleDistance(px, py, rightWheelX, wheelY, wheelRadius)));
+
+            const auto channel = [](float value)
+            {
+                return static_cast<std::uint32_t>(std::lround(std::clamp(value, 0.0f, 255.0f)));
+            };
+            row[x] = channel(pixel[0]) | channel(pixel[1]) << 8 | channel(pixel[2]) << 16 |
+                     channel(alpha * 255.0f) << 24;
+        }
+    }
+}
+} // namespace PresetThumbnail
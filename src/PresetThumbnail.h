@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Software rendering of the preview panel's car silhouette at thumbnail size, for the gallery.
+// A thumbnail only depends on the two paint colours and the finish flags, so those are packed
+// losslessly into the key: equal keys always mean identical pixels.
+namespace PresetThumbnail
+{
+inline constexpr std::size_t width = 64;
+inline constexpr std::size_t height = 32;
+
+using Key = std::uint64_t;
+
+// Colours are packed RGB8 with red in the low byte, as in PresetHotColumns; `flags` takes the
+// PresetHotColumns finish flags.
+[[nodiscard]] constexpr Key MakeKey(std::uint32_t primaryRgb, std::uint32_t accentRgb, std::uint8_t flags) noexcept
+{
+    return static_cast<Key>(primaryRgb & 0xFFFFFFu) | static_cast<Key>(accentRgb & 0xFFFFFFu) << 24 |
+           static_cast<Key>(flags) << 48;
+}
+
+// Writes the thumbnail for `key` into a `width` x `height` block of RGBA pixels (red in the low
+// byte) starting at `pixels`, whose rows are `stride` pixels apart.
+void Rasterize(Key key, std::uint32_t *pixels, std::size_t stride) noexcept;
+} // namespace PresetThumbnail
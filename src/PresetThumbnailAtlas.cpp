@@ -0,0 +1,334 @@
+#include "PresetThumbnailAtlas.h"
+
+#include "MappedFile.h"
+#include "PngEncoder.h"
+
+#include "bakkesmod/wrappers/ImageWrapper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+namespace
+{
+constexpr std::uint32_t indexMagic = 0x41545045; // "EPTA"
+constexpr std::uint32_t indexVersion = 1;
+// Requests from one frame of scrolling arrive together; waiting briefly turns them into one
+// write per page instead of one per thumbnail.
+constexpr std::chrono::milliseconds batchDelay{50};
+
+bool WriteFileAtomically(const std::filesystem::path &path, std::string_view contents)
+{
+    auto temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(contents.data(), static_cast<std::streamsize>(contents.size())).flush())
+        {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+PresetThumbnailAtlas::PresetThumbnailAtlas(std::filesystem::path directory, LogCallback log)
+    : directory(std::move(directory)),
+      log(std::move(log))
+{
+    LoadIndex();
+    worker = std::thread(&PresetThumbnailAtlas::Run, this);
+}
+
+PresetThumbnailAtlas::~PresetThumbnailAtlas()
+{
+    {
+        std::lock_guard lock(jobMutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+void PresetThumbnailAtlas::BeginFrame()
+{
+    ++frame;
+    for (std::size_t page = 0; page < pages.size(); ++page)
+    {
+        const auto written = writtenGenerations[page].load(std::memory_order_acquire);
+        if (written > pages[page].loadedGeneration)
+        {
+            // A fresh wrapper re-reads the file; the old texture stays valid for whoever still
+            // holds it this frame.
+            pages[page].image = std::make_shared<ImageWrapper>(PagePath(page), false, true);
+            pages[page].loadedGeneration = written;
+        }
+    }
+}
+
+std::optional<PresetThumbnailAtlas::Region> PresetThumbnailAtlas::Acquire(PresetThumbnail::Key key)
+{
+    const auto it = cellByKey.find(key);
+    if (it == cellByKey.end())
+    {
+        const auto index = AllocateCell();
+        if (!index)
+        {
+            return std::nullopt;
+        }
+
+        auto &cell = cells[*index];
+        if (cell.key != emptyCell)
+        {
+            cellByKey.erase(cell.key);
+        }
+        const auto page = *index / cellsPerPage;
+        if (page >= pages.size())
+        {
+            pages.resize(page + 1);
+        }
+        cell.key = key;
+        cell.lastUsedFrame = frame;
+        cell.generation = ++pages[page].nextGeneration;
+        cellByKey.emplace(key, *index);
+        {
+            std::lock_guard lock(jobMutex);
+            jobs.push_back({*index, key, cell.generation});
+        }
+        jobAvailable.notify_one();
+        return std::nullopt;
+    }
+
+    const auto index = it->second;
+    auto &cell = cells[index];
+    cell.lastUsedFrame = frame;
+    auto &page = pages[index / cellsPerPage];
+    if (!page.image || page.loadedGeneration < cell.generation)
+    {
+        return std::nullopt;
+    }
+
+    void *texture = nullptr;
+    try
+    {
+        texture = page.image->GetImGuiTex();
+    }
+    catch (...)
+    {
+        // Treat a failed load like one still in progress; the preset keeps its placeholder.
+    }
+    if (!texture)
+    {
+        return std::nullopt;
+    }
+
+    const auto local = index % cellsPerPage;
+    const auto x = static_cast<float>(local % cellsPerRow * PresetThumbnail::width);
+    const auto y = static_cast<float>(local / cellsPerRow * PresetThumbnail::height);
+    constexpr auto size = static_cast<float>(pageSize);
+    return Region{texture, x / size, y / size, (x + PresetThumbnail::width) / size, (y + PresetThumbnail::height) / size};
+}
+
+std::filesystem::path PresetThumbnailAtlas::PagePath(std::size_t page) const
+{
+    return directory / ("atlas_" + std::to_string(page) + ".png");
+}
+
+std::filesystem::path PresetThumbnailAtlas::IndexPath() const
+{
+    return directory / "atlas.index";
+}
+
+void PresetThumbnailAtlas::LoadIndex()
+{
+    const MappedFile file(IndexPath());
+    if (!file.IsOpen())
+    {
+        return;
+    }
+
+    const auto contents = file.View();
+    constexpr std::size_t headerSize = 3 * sizeof(std::uint32_t);
+    std::array<std::uint32_t, 3> header{};
+    if (contents.size() < headerSize)
+    {
+        return;
+    }
+    std::memcpy(header.data(), contents.data(), headerSize);
+    const auto pageCount = static_cast<std::size_t>(header[2]);
+    if (header[0] != indexMagic || header[1] != indexVersion || pageCount > maxPages ||
+        contents.size() != headerSize + pageCount * cellsPerPage * sizeof(PresetThumbnail::Key))
+    {
+        return;
+    }
+    for (std::size_t page = 0; page < pageCount; ++page)
+    {
+        std::error_code error;
+        if (!std::filesystem::exists(PagePath(page), error))
+        {
+            return;
+        }
+    }
+
+    workerKeys.resize(pageCount * cellsPerPage);
+    std::memcpy(workerKeys.data(), contents.data() + headerSize, workerKeys.size() * sizeof(PresetThumbnail::Key));
+
+    // Generation 1 is whatever the pages on disk already hold.
+    cells.resize(workerKeys.size());
+    pages.resize(pageCount);
+    for (std::size_t page = 0; page < pageCount; ++page)
+    {
+        pages[page].nextGeneration = 1;
+        writtenGenerations[page].store(1, std::memory_order_relaxed);
+    }
+    for (std::size_t index = 0; index < workerKeys.size(); ++index)
+    {
+        const auto key = workerKeys[index];
+        if (key != emptyCell && cellByKey.emplace(key, index).second)
+        {
+            cells[index] = Cell{key, 0, 1};
+        }
+    }
+}
+
+std::optional<std::size_t> PresetThumbnailAtlas::AllocateCell()
+{
+    if (cells.size() < maxPages * cellsPerPage)
+    {
+        cells.emplace_back();
+        return cells.size() - 1;
+    }
+
+    // Reuse the cell drawn longest ago, but never one drawn this frame.
+    std::optional<std::size_t> oldest;
+    for (std::size_t index = 0; index < cells.size(); ++index)
+    {
+        if (cells[index].lastUsedFrame < frame && (!oldest || cells[index].lastUsedFrame < cells[*oldest].lastUsedFrame))
+        {
+            oldest = index;
+        }
+    }
+    return oldest;
+}
+
+void PresetThumbnailAtlas::Run()
+{
+    std::unique_lock lock(jobMutex);
+    while (true)
+    {
+        jobAvailable.wait(lock, [this]
+                          {
+                              return stopping || !jobs.empty();
+                          });
+        if (stopping || jobAvailable.wait_for(lock, batchDelay, [this]
+                                              {
+                                                  return stopping;
+                                              }))
+        {
+            return;
+        }
+
+        auto batch = std::move(jobs);
+        jobs.clear();
+        lock.unlock();
+        ProcessJobs(batch);
+        lock.lock();
+    }
+}
+
+void PresetThumbnailAtlas::ProcessJobs(const std::vector<Job> &batch)
+{
+    std::array<std::uint32_t, maxPages> dirtyGenerations{};
+    for (const auto &job : batch)
+    {
+        const auto page = job.cell / cellsPerPage;
+        if (workerKeys.size() < (page + 1) * cellsPerPage)
+        {
+            workerKeys.resize((page + 1) * cellsPerPage, emptyCell);
+        }
+        if (workerPixels.size() <= page)
+        {
+            workerPixels.resize(page + 1);
+        }
+
+        auto &pixels = workerPixels[page];
+        if (pixels.empty())
+        {
+            // First change to a page this session: redraw what the file on disk holds so the
+            // rewrite keeps it.
+            pixels.assign(pageSize * pageSize, 0);
+            for (std::size_t local = 0; local < cellsPerPage; ++local)
+            {
+                const auto key = workerKeys[page * cellsPerPage + local];
+                if (key != emptyCell)
+                {
+                    PresetThumbnail::Rasterize(key, &pixels[local / cellsPerRow * PresetThumbnail::height * pageSize + local % cellsPerRow * PresetThumbnail::width], pageSize);
+                }
+            }
+        }
+
+        const auto local = job.cell % cellsPerPage;
+        PresetThumbnail::Rasterize(job.key, &pixels[local / cellsPerRow * PresetThumbnail::height * pageSize + local % cellsPerRow * PresetThumbnail::width], pageSize);
+        workerKeys[job.cell] = job.key;
+        dirtyGenerations[page] = std::max(dirtyGenerations[page], job.generation);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    bool allWritten = true;
+    for (std::size_t page = 0; page < maxPages; ++page)
+    {
+        if (dirtyGenerations[page] == 0)
+        {
+            continue;
+        }
+        if (WritePage(page))
+        {
+            writtenGenerations[page].store(dirtyGenerations[page], std::memory_order_release);
+        }
+        else
+        {
+            allWritten = false;
+        }
+    }
+
+    // The index must never describe pixels that are not on disk; without it the next session
+    // simply starts with an empty atlas.
+    if (!allWritten || !WriteIndex())
+    {
+        std::filesystem::remove(IndexPath(), error);
+    }
+}
+
+bool PresetThumbnailAtlas::WritePage(std::size_t page)
+{
+    const auto png = PngEncoder::EncodeRgba(workerPixels[page].data(), pageSize, pageSize);
+    if (!WriteFileAtomically(PagePath(page), png))
+    {
+        log("ExpandedPresets: Failed to write thumbnail atlas " + PagePath(page).string());
+        return false;
+    }
+    return true;
+}
+
+bool PresetThumbnailAtlas::WriteIndex()
+{
+    const std::array<std::uint32_t, 3> header{indexMagic, indexVersion, static_cast<std::uint32_t>(workerKeys.size() / cellsPerPage)};
+    std::string contents(reinterpret_cast<const char *>(header.data()), sizeof(header));
+    contents.append(reinterpret_cast<const char *>(workerKeys.data()), workerKeys.size() * sizeof(PresetThumbnail::Key));
+    return WriteFileAtomically(IndexPath(), contents);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "PresetThumbnail.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class ImageWrapper;
+
+// Gallery thumbnails packed into a few atlas textures. Thumbnails are rasterized on a worker
+// thread, written as PNG atlas pages plus a key index under `directory`, and loaded through
+// ImageWrapper; the pages on disk double as the cache for the next session. Only thumbnails the
+// gallery asks for are generated, and when every cell is taken the least recently drawn one is
+// reused.
+//
+// Everything except the worker runs on the render thread: call BeginFrame() once per frame, then
+// Acquire() for each visible preset.
+class PresetThumbnailAtlas
+{
+public:
+    using LogCallback = std::function<void(const std::string &)>;
+
+    static constexpr std::size_t pageSize = 512;
+    static constexpr std::size_t cellsPerRow = pageSize / PresetThumbnail::width;
+    static constexpr std::size_t cellsPerPage = cellsPerRow * (pageSize / PresetThumbnail::height);
+    static constexpr std::size_t maxPages = 8;
+
+    struct Region
+    {
+        void *texture{nullptr};
+        float u0{0.0f};
+        float v0{0.0f};
+        float u1{0.0f};
+        float v1{0.0f};
+    };
+
+    PresetThumbnailAtlas(std::filesystem::path directory, LogCallback log);
+    ~PresetThumbnailAtlas();
+
+    PresetThumbnailAtlas(const PresetThumbnailAtlas &) = delete;
+    PresetThumbnailAtlas &operator=(const PresetThumbnailAtlas &) = delete;
+
+    // Picks up pages the worker finished since the last frame.
+    void BeginFrame();
+
+    // Where the thumbnail for `key` is in the atlas, or nullopt while it is being generated (the
+    // request is queued on the first call).
+    [[nodiscard]] std::optional<Region> Acquire(PresetThumbnail::Key key);
+
+private:
+    static constexpr PresetThumbnail::Key emptyCell = ~PresetThumbnail::Key{0};
+
+    struct Cell
+    {
+        PresetThumbnail::Key key{emptyCell};
+        std::uint64_t lastUsedFrame{0};
+        // Page generation that first contains this thumbnail.
+        std::uint32_t generation{0};
+    };
+
+    struct Page
+    {
+        std::shared_ptr<ImageWrapper> image;
+        std::uint32_t loadedGeneration{0};
+        std::uint32_t nextGeneration{0};
+    };
+
+    struct Job
+    {
+        std::size_t cell;
+        PresetThumbnail::Key key;
+        std::uint32_t generation;
+    };
+
+    std::filesystem::path directory;
+    LogCallback log;
+
+    // Render-thread state.
+    std::vector<Cell> cells;
+    std::vector<Page> pages;
+    std::unordered_map<PresetThumbnail::Key, std::size_t> cellByKey;
+    std::uint64_t frame{1};
+
+    // Worker state. `workerKeys` mirrors what the pages on disk hold; page pixels are rebuilt from
+    // it the first time a loaded page is modified.
+    std::vector<PresetThumbnail::Key> workerKeys;
+    std::vector<std::vector<std::uint32_t>> workerPixels;
+    std::array<std::atomic<std::uint32_t>, maxPages> writtenGenerations{};
+
+    std::mutex jobMutex;
+    std::condition_variable jobAvailable;
+    std::vector<Job> jobs;
+    bool stopping{false};
+    std::thread worker;
+
+    [[nodiscard]] std::filesystem::path PagePath(std::size_t page) const;
+    [[nodiscard]] std::filesystem::path IndexPath() const;
+    void LoadIndex();
+    [[nodiscard]] std::optional<std::size_t> AllocateCell();
+
+    void Run();
+    void ProcessJobs(const std::vector<Job> &batch);
+    bool WritePage(std::size_t page);
+    bool WriteIndex();
+};
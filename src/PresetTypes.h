@@ -1,6 +1,11 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct PresetPaintColor
@@ -15,23 +20,85 @@ struct PresetPaintColor
     }
 };
 
+// Name and loadout code storage. PresetManager allocates the strings of its collection from its
+// PresetStringArena; copies made anywhere else use the default heap like any std::string.
+using PresetString = std::pmr::string;
+
+// Hash for name-keyed unordered containers (used with std::equal_to<>) so lookups by
+// std::string_view or PresetString do not build a temporary std::string.
+struct PresetNameHash
+{
+    using is_transparent = void;
+
+    // Deliberately not noexcept: libstdc++ only caches hash codes in the nodes for hashers that
+    // may throw, and without the cache every bucket walk re-hashes the names it passes.
+    [[nodiscard]] std::size_t operator()(std::string_view name) const
+    {
+        return std::hash<std::string_view>{}(name);
+    }
+};
+
+// Handle to one preset in PresetManager, unique for the session and unaffected by the slot moves
+// that removals cause (see PresetManager::GetPresetId). Not persisted.
+using PresetId = std::uint64_t;
+
+inline constexpr PresetId invalidPresetId = 0;
+
+// Handle to a car, decal or wheels label interned in the PresetLabelPool owned by PresetManager.
+using PresetLabelId = std::uint32_t;
+
+inline constexpr std::string_view defaultCarLabelText{"Octane"};
+inline constexpr std::string_view defaultDecalLabelText{"None"};
+inline constexpr std::string_view defaultWheelsLabelText{"OEM"};
+
+// Ids the pool reserves for the default labels above, in that order.
+inline constexpr PresetLabelId defaultCarLabelId = 0;
+inline constexpr PresetLabelId defaultDecalLabelId = 1;
+inline constexpr PresetLabelId defaultWheelsLabelId = 2;
+
 struct PresetCustomization
 {
     PresetPaintColor primaryColor{0.18f, 0.18f, 0.18f};
     PresetPaintColor accentColor{0.9f, 0.35f, 0.15f};
-    std::string carLabel{"Octane"};
-    std::string decalLabel{"None"};
-    std::string wheelsLabel{"OEM"};
+    PresetLabelId carLabel{defaultCarLabelId};
+    PresetLabelId decalLabel{defaultDecalLabelId};
+    PresetLabelId wheelsLabel{defaultWheelsLabelId};
     bool paintFinishMatte{false};
     bool paintFinishPearlescent{false};
+
+    [[nodiscard]] bool operator==(const PresetCustomization &other) const noexcept = default;
 };
 
 struct CustomPreset
 {
-    std::string name;
-    std::string loadoutCode;
+    PresetString name;
+    PresetString loadoutCode;
     PresetCustomization customization{};
+
+    [[nodiscard]] bool operator==(const CustomPreset &other) const noexcept = default;
 };
 
 using CustomPresetCollection = std::vector<CustomPreset>;
 
+// Self-contained copy of a preset with its labels spelled out, for the editor's text fields and
+// anything else that edits presets outside PresetManager. PresetManager::AddOrUpdatePreset
+// interns the labels when the preset is committed.
+struct EditablePresetCustomization
+{
+    PresetPaintColor primaryColor{0.18f, 0.18f, 0.18f};
+    PresetPaintColor accentColor{0.9f, 0.35f, 0.15f};
+    std::string carLabel{defaultCarLabelText};
+    std::string decalLabel{defaultDecalLabelText};
+    std::string wheelsLabel{defaultWheelsLabelText};
+    bool paintFinishMatte{false};
+    bool paintFinishPearlescent{false};
+
+    [[nodiscard]] bool operator==(const EditablePresetCustomization &other) const = default;
+};
+
+struct EditablePreset
+{
+    std::string name;
+    std::string loadoutCode;
+    EditablePresetCustomization customization{};
+};
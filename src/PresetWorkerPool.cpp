@@ -0,0 +1,154 @@
+#include "PresetWorkerPool.h"
+
+#include <algorithm>
+
+namespace
+{
+// Lets Submit recognise its own workers.
+thread_local const PresetWorkerPool *currentPool = nullptr;
+thread_local std::size_t currentWorker = 0;
+} // namespace
+
+PresetWorkerPool::~PresetWorkerPool()
+{
+    Stop();
+}
+
+void PresetWorkerPool::Start(std::size_t threadCount)
+{
+    if (!workers.empty())
+    {
+        return;
+    }
+
+    stopping = false;
+    threadCount = std::max<std::size_t>(threadCount, 1);
+    workers.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    // Every deque exists before the first worker can try to steal from it.
+    for (std::size_t i = 0; i < threadCount; ++i)
+    {
+        workers[i]->thread = std::thread(&PresetWorkerPool::Run, this, i);
+    }
+}
+
+void PresetWorkerPool::Stop()
+{
+    if (workers.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lock(wakeMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto &worker : workers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+    workers.clear();
+}
+
+bool PresetWorkerPool::IsRunning() const noexcept
+{
+    return !workers.empty();
+}
+
+std::size_t PresetWorkerPool::GetThreadCount() const noexcept
+{
+    return workers.size();
+}
+
+void PresetWorkerPool::Submit(Task task)
+{
+    if (workers.empty())
+    {
+        task();
+        return;
+    }
+
+    const bool fromWorker = currentPool == this;
+    const auto index = fromWorker ? currentWorker : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    {
+        std::lock_guard lock(wakeMutex);
+        queuedTasks.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        auto &worker = *workers[index];
+        std::lock_guard lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    wakeUp.notify_one();
+}
+
+std::size_t PresetWorkerPool::DefaultThreadCount() noexcept
+{
+    const auto hardwareThreads = static_cast<std::size_t>(std::thread::hardware_concurrency());
+    // Leave one core to the game thread.
+    return std::clamp<std::size_t>(hardwareThreads > 1 ? hardwareThreads - 1 : 1, 1, maxThreads);
+}
+
+void PresetWorkerPool::Run(std::size_t index)
+{
+    currentPool = this;
+    currentWorker = index;
+
+    Task task;
+    while (true)
+    {
+        if (TakeTask(index, task))
+        {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock lock(wakeMutex);
+        wakeUp.wait(lock, [this]
+                    {
+                        return stopping || queuedTasks.load(std::memory_order_relaxed) != 0;
+                    });
+        // Queued tasks still run after Stop(); the pool only exits once it is drained.
+        if (stopping && queuedTasks.load(std::memory_order_relaxed) == 0)
+        {
+            return;
+        }
+    }
+}
+
+bool PresetWorkerPool::TakeTask(std::size_t index, Task &task)
+{
+    {
+        auto &own = *workers[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    for (std::size_t offset = 1; offset < workers.size(); ++offset)
+    {
+        auto &victim = *workers[(index + offset) % workers.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
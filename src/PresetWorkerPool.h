@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small work-stealing pool for the short, CPU-bound jobs of the plugin: catalog imports, reloads
+// of an externally edited cfg and the parallel shard load. Each worker has its own deque;
+// tasks submitted from a worker go to the back of that worker's deque and are taken LIFO, tasks
+// from other threads are spread round-robin, and an idle worker steals from the front of the
+// others. Threads that block on timers or OS notifications (the storage writer, the file
+// watcher, the thumbnail atlas) keep their own, since they would pin a worker.
+//
+// Threading rules for tasks: a task only touches what it captured by value, state that is
+// immutable while it runs (mapped files, the importer's chunk views) or state it owns outright
+// (an importer's chunk). Anything owned by the game thread, PresetManager and its label pool
+// included, is reached through PresetManagerHost::post once the task is done. Tasks must not
+// throw and must not wait on other tasks of the pool.
+class PresetWorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+    PresetWorkerPool() = default;
+    // Stops the pool if Stop() was not called.
+    ~PresetWorkerPool();
+
+    PresetWorkerPool(const PresetWorkerPool &) = delete;
+    PresetWorkerPool &operator=(const PresetWorkerPool &) = delete;
+
+    // Starts `threadCount` workers (at least one). Does nothing while the pool is running.
+    void Start(std::size_t threadCount = DefaultThreadCount());
+    // Runs every task still queued, then joins the workers.
+    void Stop();
+    [[nodiscard]] bool IsRunning() const noexcept;
+    [[nodiscard]] std::size_t GetThreadCount() const noexcept;
+
+    // Queues `task`. On a pool that is not running the task runs on the calling thread before
+    // Submit returns, so callers never lose work during shutdown.
+    void Submit(Task task);
+
+    // One thread per core except the one the game thread needs, at most maxThreads.
+    [[nodiscard]] static std::size_t DefaultThreadCount() noexcept;
+
+    static constexpr std::size_t maxThreads = 8;
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<std::size_t> nextWorker{0};
+
+    // Tasks sitting in any deque. Raised under wakeMutex before the task is queued, so a worker
+    // about to sleep either sees it or is woken.
+    std::atomic<std::size_t> queuedTasks{0};
+    std::mutex wakeMutex;
+    std::condition_variable wakeUp;
+    bool stopping{false};
+
+    void Run(std::size_t index);
+    [[nodiscard]] bool TakeTask(std::size_t index, Task &task);
+};
@@ -0,0 +1,519 @@
+// Offline processing of preset catalogs with the same core the plugin uses, so a large
+// bakkesplugins_cars.cfg can be checked and cleaned up before the game ever loads it. Build with
+// -DEXP_PRESETS_BUILD_TOOLS=ON (no BakkesMod SDK needed) and run
+//
+//   ExpandedPresetsTool validate <input>...
+//   ExpandedPresetsTool merge <input>... -o <output> [--dedupe] [--no-cache] [--threads N]
+//   ExpandedPresetsTool dedupe <input>... -o <output> [--no-cache] [--threads N]
+//
+// Inputs are merged in order, so a later preset replaces an earlier one with the same name. The
+// format follows the extension: .pack is a preset pack (see PresetPack), .bin the binary
+// snapshot of the cfg beside it (see PresetBinaryCache), anything else the expanded_presets.cfg
+// line format. Consecutive text inputs are parsed as one import on every core. A .cfg output is
+// written normalized, with a matching .bin next to it unless --no-cache is given; a .bin output
+// writes that same pair. `convert` is accepted as another name for `merge`.
+#include "PresetBinaryCache.h"
+#include "PresetManager.h"
+#include "PresetPack.h"
+#include "PresetSerialization.h"
+#include "PresetWorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// Names of presets with undecodable loadout codes printed by validate before it only counts them.
+constexpr std::size_t maxListedInvalidCodes = 10;
+
+// Stands in for the game thread: tasks posted by the manager run on the main thread while it waits.
+class TaskQueue
+{
+public:
+    void Post(PresetManagerHost::Task task)
+    {
+        {
+            std::lock_guard lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wakeUp.notify_one();
+    }
+
+    // Runs posted tasks until `finished` returns true.
+    void RunUntil(const std::function<bool()> &finished)
+    {
+        while (!finished())
+        {
+            std::vector<PresetManagerHost::Task> ready;
+            {
+                std::unique_lock lock(mutex);
+                wakeUp.wait(lock, [this]
+                            {
+                                return !tasks.empty();
+                            });
+                ready.swap(tasks);
+            }
+            for (auto &task : ready)
+            {
+                task();
+            }
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::vector<PresetManagerHost::Task> tasks;
+};
+
+enum class Command
+{
+    Validate,
+    Merge,
+    Dedupe,
+};
+
+struct Options
+{
+    Command command{Command::Validate};
+    std::vector<std::filesystem::path> inputs;
+    std::filesystem::path output;
+    bool dedupe{false};
+    bool writeCache{true};
+    std::size_t threads{0};
+};
+
+struct Totals
+{
+    std::size_t read{0};
+    std::size_t replaced{0};
+    std::size_t rejectedLines{0};
+    bool failed{false};
+};
+
+void PrintUsage(const char *program)
+{
+    std::fprintf(stderr,
+                 "usage: %s validate <input>...\n"
+                 "       %s merge <input>... -o <output> [--dedupe] [--no-cache] [--threads N]\n"
+                 "       %s convert <input>... -o <output> [--dedupe] [--no-cache] [--threads N]\n"
+                 "       %s dedupe <input>... -o <output> [--no-cache] [--threads N]\n",
+                 program, program, program, program);
+}
+
+std::optional<Options> ParseOptions(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        return std::nullopt;
+    }
+
+    Options options;
+    const std::string_view command{argv[1]};
+    if (command == "validate")
+    {
+        options.command = Command::Validate;
+    }
+    else if (command == "merge" || command == "convert")
+    {
+        options.command = Command::Merge;
+    }
+    else if (command == "dedupe")
+    {
+        options.command = Command::Dedupe;
+        options.dedupe = true;
+    }
+    else
+    {
+        return std::nullopt;
+    }
+
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string_view argument{argv[i]};
+        if (argument == "-o" && i + 1 < argc)
+        {
+            options.output = argv[++i];
+        }
+        else if (argument == "--dedupe")
+        {
+            options.dedupe = true;
+        }
+        else if (argument == "--no-cache")
+        {
+            options.writeCache = false;
+        }
+        else if (argument == "--threads" && i + 1 < argc)
+        {
+            options.threads = static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10));
+            if (options.threads == 0)
+            {
+                return std::nullopt;
+            }
+        }
+        else if (argument.starts_with("-"))
+        {
+            return std::nullopt;
+        }
+        else
+        {
+            options.inputs.emplace_back(argument);
+        }
+    }
+
+    const bool needsOutput = options.command != Command::Validate;
+    if (options.inputs.empty() || needsOutput == options.output.empty())
+    {
+        return std::nullopt;
+    }
+    return options;
+}
+
+bool HasExtension(const std::filesystem::path &path, std::string_view extension)
+{
+    return path.extension() == extension;
+}
+
+// Parses `paths` as one catalog import on the worker pool and merges it on this thread.
+void ImportText(PresetManager &manager, TaskQueue &queue, std::vector<std::filesystem::path> &paths, Totals &totals)
+{
+    if (paths.empty())
+    {
+        return;
+    }
+
+    std::optional<PresetManager::CatalogImportSummary> result;
+    const bool started = manager.StartCatalogImport(paths, [&result](const PresetManager::CatalogImportSummary &summary)
+                                                    {
+                                                        result = summary;
+                                                    });
+    paths.clear();
+    if (!started)
+    {
+        totals.failed = true;
+        return;
+    }
+    queue.RunUntil([&result]
+                   {
+                       return result.has_value();
+                   });
+
+    totals.read += result->added + result->updated;
+    totals.replaced += result->updated;
+    totals.rejectedLines += result->rejectedLines;
+    std::printf("Parsed %zu presets in %lld ms (merged in %lld ms), rejected %zu lines\n", result->added + result->updated,
+                static_cast<long long>(result->parseTime.count()), static_cast<long long>(result->mergeTime.count()),
+                result->rejectedLines);
+}
+
+void ImportPack(PresetManager &manager, const std::filesystem::path &path, Totals &totals)
+{
+    const auto summary = manager.ImportPack(path);
+    if (!summary)
+    {
+        totals.failed = true;
+        return;
+    }
+
+    totals.read += summary->added + summary->updated;
+    totals.replaced += summary->updated;
+    std::printf("Read %zu presets from %s in %lld ms\n", summary->added + summary->updated, path.string().c_str(),
+                static_cast<long long>(summary->time.count()));
+    if (!summary->complete)
+    {
+        std::fprintf(stderr, "ExpandedPresets: %s is damaged; only the presets before the damage were read.\n",
+                     path.string().c_str());
+        totals.failed = true;
+    }
+}
+
+// Reads a binary snapshot while it still matches its cfg. Returns false when it does not, so the
+// caller can parse the cfg instead.
+bool ImportCache(PresetManager &manager, const std::filesystem::path &cachePath, Totals &totals)
+{
+    auto storagePath = cachePath;
+    storagePath.replace_extension(".cfg");
+    const auto source = PresetBinaryCache::StatSource(storagePath);
+    if (!source)
+    {
+        return false;
+    }
+
+    PresetLabelPool labels;
+    std::pmr::monotonic_buffer_resource strings;
+    const auto cached = PresetBinaryCache::Load(cachePath, *source,
+                                                [&storagePath]
+                                                {
+                                                    const MappedFile file(storagePath);
+                                                    return PresetBinaryCache::HashContents(file.View());
+                                                },
+                                                labels, &strings);
+    if (!cached)
+    {
+        return false;
+    }
+
+    for (auto preset : cached->presets)
+    {
+        // The snapshot's label ids belong to `labels`; re-intern them into the manager's pool.
+        auto &customization = preset.customization;
+        customization.carLabel = manager.InternLabel(labels.Resolve(customization.carLabel), defaultCarLabelId);
+        customization.decalLabel = manager.InternLabel(labels.Resolve(customization.decalLabel), defaultDecalLabelId);
+        customization.wheelsLabel = manager.InternLabel(labels.Resolve(customization.wheelsLabel), defaultWheelsLabelId);
+
+        const auto previousCount = manager.GetPresetCount();
+        manager.AddOrUpdatePreset(std::move(preset));
+        totals.replaced += manager.GetPresetCount() == previousCount;
+    }
+    totals.read += cached->presets.size();
+    std::printf("Read %zu presets from %s\n", cached->presets.size(), cachePath.string().c_str());
+    return true;
+}
+
+void ImportInputs(PresetManager &manager, TaskQueue &queue, const std::vector<std::filesystem::path> &inputs, Totals &totals)
+{
+    std::vector<std::filesystem::path> textRun;
+    for (const auto &input : inputs)
+    {
+        if (HasExtension(input, ".pack"))
+        {
+            ImportText(manager, queue, textRun, totals);
+            ImportPack(manager, input, totals);
+        }
+        else if (HasExtension(input, ".bin"))
+        {
+            ImportText(manager, queue, textRun, totals);
+            if (!ImportCache(manager, input, totals))
+            {
+                auto storagePath = input;
+                storagePath.replace_extension(".cfg");
+                std::fprintf(stderr, "ExpandedPresets: %s does not match %s; parsing the cfg instead.\n",
+                             input.string().c_str(), storagePath.string().c_str());
+                textRun.push_back(std::move(storagePath));
+            }
+        }
+        else
+        {
+            textRun.push_back(input);
+        }
+    }
+    ImportText(manager, queue, textRun, totals);
+}
+
+// Writes the cfg through a temporary file and, when asked, the snapshot that lets the plugin
+// load it without parsing.
+bool WriteStorage(const std::filesystem::path &storagePath, const PresetSnapshot &snapshot, const PresetLabelPool &labels,
+                  bool writeCache)
+{
+    std::ostringstream buffer;
+    PresetSerialization::WritePresets(buffer, snapshot, labels);
+    const auto contents = buffer.str();
+
+    std::error_code error;
+    if (storagePath.has_parent_path())
+    {
+        std::filesystem::create_directories(storagePath.parent_path(), error);
+    }
+    auto temporaryPath = storagePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!file)
+        {
+            std::fprintf(stderr, "ExpandedPresets: Could not write %s\n", temporaryPath.string().c_str());
+            return false;
+        }
+    }
+    std::filesystem::rename(temporaryPath, storagePath, error);
+    if (error)
+    {
+        std::fprintf(stderr, "ExpandedPresets: Could not replace %s: %s\n", storagePath.string().c_str(), error.message().c_str());
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+
+    const auto cachePath = PresetBinaryCache::CachePathFor(storagePath);
+    if (!writeCache)
+    {
+        // A snapshot left over from an earlier run would no longer match; the plugin ignores it,
+        // but there is no reason to ship it.
+        std::filesystem::remove(cachePath, error);
+        std::printf("Wrote %zu presets to %s\n", snapshot.Size(), storagePath.string().c_str());
+        return true;
+    }
+
+    auto source = PresetBinaryCache::StatSource(storagePath);
+    if (!source)
+    {
+        std::fprintf(stderr, "ExpandedPresets: Could not read back %s\n", storagePath.string().c_str());
+        return false;
+    }
+    source->contentHash = PresetBinaryCache::HashContents(contents);
+    if (!PresetBinaryCache::Write(cachePath, snapshot, labels, *source))
+    {
+        std::fprintf(stderr, "ExpandedPresets: Could not write %s\n", cachePath.string().c_str());
+        return false;
+    }
+    std::printf("Wrote %zu presets to %s and %s\n", snapshot.Size(), storagePath.string().c_str(), cachePath.string().c_str());
+    return true;
+}
+
+bool WritePack(PresetManager &manager, TaskQueue &queue, const std::filesystem::path &packPath)
+{
+    bool done = false;
+    std::optional<PresetPack::WriteSummary> written;
+    if (!manager.StartPackExport(packPath, [&done, &written](const std::optional<PresetPack::WriteSummary> &summary)
+                                 {
+                                     written = summary;
+                                     done = true;
+                                 }))
+    {
+        return false;
+    }
+    queue.RunUntil([&done]
+                   {
+                       return done;
+                   });
+
+    if (!written)
+    {
+        std::fprintf(stderr, "ExpandedPresets: Could not write %s\n", packPath.string().c_str());
+        return false;
+    }
+    std::printf("Wrote %zu presets to %s (%llu of %llu bytes)\n", written->presetCount, packPath.string().c_str(),
+                static_cast<unsigned long long>(written->packedBytes), static_cast<unsigned long long>(written->rawBytes));
+    return true;
+}
+
+bool WriteOutput(PresetManager &manager, TaskQueue &queue, const Options &options)
+{
+    if (HasExtension(options.output, ".pack"))
+    {
+        return WritePack(manager, queue, options.output);
+    }
+
+    auto storagePath = options.output;
+    if (HasExtension(storagePath, ".bin"))
+    {
+        storagePath.replace_extension(".cfg");
+    }
+    const auto snapshot = manager.GetSnapshot();
+    return WriteStorage(storagePath, *snapshot, manager.GetLabelPool(), options.writeCache || HasExtension(options.output, ".bin"));
+}
+
+// Library-wide checks after the inputs are merged. Returns the number of presets whose loadout
+// code does not decode.
+std::size_t ReportInvalidCodes(const PresetManager &manager, bool listNames)
+{
+    std::size_t invalid = 0;
+    const auto &presets = manager.GetPresets();
+    for (std::size_t index = 0; index < presets.size(); ++index)
+    {
+        if (manager.GetDecodedLoadout(index).valid)
+        {
+            continue;
+        }
+        if (listNames && invalid < maxListedInvalidCodes)
+        {
+            std::printf("  invalid loadout code: %s\n", std::string(presets[index].name).c_str());
+        }
+        ++invalid;
+    }
+    if (listNames && invalid > maxListedInvalidCodes)
+    {
+        std::printf("  ... and %zu more\n", invalid - maxListedInvalidCodes);
+    }
+    return invalid;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const auto options = ParseOptions(argc, argv);
+    if (!options)
+    {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // No game thread to leave a core to, so the pool gets all of them unless told otherwise.
+    PresetWorkerPool workers;
+    workers.Start(options->threads != 0 ? options->threads : std::max(1u, std::thread::hardware_concurrency()));
+
+    // The manager keeps its own files in a data folder; give it a scratch one, nothing is saved there.
+    std::random_device seed;
+    const auto scratchFolder = std::filesystem::temp_directory_path() / ("ExpandedPresetsTool-" + std::to_string(seed()));
+
+    TaskQueue queue;
+    PresetManagerHost host;
+    host.dataFolder = scratchFolder;
+    host.log = [](const std::string &message)
+    {
+        std::fprintf(stderr, "%s\n", message.c_str());
+    };
+    host.post = [&queue](PresetManagerHost::Task task)
+    {
+        queue.Post(std::move(task));
+    };
+    host.workers = &workers;
+
+    int exitCode = 0;
+    {
+        PresetManager manager(host);
+
+        Totals totals;
+        ImportInputs(manager, queue, options->inputs, totals);
+
+        const bool validating = options->command == Command::Validate;
+        const auto invalidCodes = ReportInvalidCodes(manager, validating);
+        std::printf("%zu presets read, %zu replaced by a later preset with the same name, %zu lines rejected, "
+                    "%zu invalid loadout codes\n",
+                    totals.read, totals.replaced, totals.rejectedLines, invalidCodes);
+        if (validating || options->dedupe)
+        {
+            // Validation collapses them too: nothing is written, and it gives the same count.
+            const auto duplicates = manager.CollapseDuplicates();
+            std::printf("%zu presets repeat the loadout of an earlier one%s\n", duplicates, validating ? "" : " and were removed");
+        }
+
+        if (totals.failed)
+        {
+            exitCode = 1;
+        }
+        else if (options->command == Command::Validate)
+        {
+            exitCode = totals.rejectedLines != 0 || invalidCodes != 0 ? 1 : 0;
+        }
+        else
+        {
+            exitCode = WriteOutput(manager, queue, *options) ? 0 : 1;
+        }
+    }
+
+    workers.Stop();
+    std::error_code error;
+    std::filesystem::remove_all(scratchFolder, error);
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::printf("Done in %lld ms\n", static_cast<long long>(elapsed.count()));
+    return exitCode;
+}